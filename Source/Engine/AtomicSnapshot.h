@@ -0,0 +1,109 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * AtomicSnapshot — Lock-free hand-off of immutable objects to real-time readers.
+ *
+ * A writer thread builds a new object and publishes it with a single atomic
+ * pointer swap. Each reader (the audio thread, an I/O thread...) owns one
+ * hazard slot: acquire() returns the live object and keeps it alive until the
+ * same reader acquires again. Superseded objects are deleted by the writer
+ * side in collectGarbage(), never on a reader thread.
+ */
+template <typename ObjectType, int NumReaders = 1>
+class AtomicSnapshot
+{
+public:
+    AtomicSnapshot() = default;
+
+    ~AtomicSnapshot()
+    {
+        delete live.load();
+
+        for (auto* r : retired)
+            delete r;
+    }
+
+    /** Publish a new object (non-real-time threads only). */
+    void publish (std::unique_ptr<ObjectType> next)
+    {
+        const juce::ScopedLock sl (writerLock);
+
+        if (auto* old = live.exchange (next.release()))
+            retired.push_back (old);
+
+        collectGarbageLocked();
+    }
+
+    /** Get the live object for a reader. Lock-free and wait-free in practice.
+        The pointer stays valid until this reader calls acquire() or release(). */
+    const ObjectType* acquire (int readerIndex = 0) noexcept
+    {
+        auto& hazard = hazards[readerIndex];
+        const ObjectType* current = live.load();
+
+        for (;;)
+        {
+            hazard.store (current);
+            auto* check = live.load();
+
+            if (check == current)
+                return current;
+
+            current = check;
+        }
+    }
+
+    /** Drop this reader's hold on whatever it acquired last. */
+    void release (int readerIndex = 0) noexcept
+    {
+        hazards[readerIndex].store (nullptr);
+    }
+
+    /** Writer-side view of the live object. Only valid on the publishing thread(s). */
+    const ObjectType* peek() const noexcept { return live.load(); }
+
+    /** Delete retired objects that no reader is holding any more. */
+    void collectGarbage()
+    {
+        const juce::ScopedLock sl (writerLock);
+        collectGarbageLocked();
+    }
+
+private:
+    void collectGarbageLocked()
+    {
+        for (size_t i = 0; i < retired.size();)
+        {
+            if (isHeld (retired[i]))
+            {
+                ++i;
+                continue;
+            }
+
+            delete retired[i];
+            retired[i] = retired.back();
+            retired.pop_back();
+        }
+    }
+
+    bool isHeld (const ObjectType* object) const noexcept
+    {
+        for (auto& h : hazards)
+            if (h.load() == object)
+                return true;
+
+        return false;
+    }
+
+    std::atomic<ObjectType*> live { nullptr };
+    std::atomic<const ObjectType*> hazards[NumReaders] {};
+
+    juce::CriticalSection writerLock;
+    std::vector<ObjectType*> retired;
+
+    JUCE_DECLARE_NON_COPYABLE (AtomicSnapshot)
+};
@@ -0,0 +1,602 @@
+#include "DataSeries.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    constexpr int kIdleMilliseconds = 20;
+    constexpr double kGrowthCheckMilliseconds = 500.0;
+    constexpr double kIdleReaderMilliseconds = 1000.0;
+    constexpr double kWindowSeconds = 8.0;                     // Real time a window should last
+    constexpr juce::int64 kIndexBytesPerSlice = 4 << 20;
+    constexpr juce::int64 kBinaryRowBytes = 16;
+    constexpr juce::int64 kBinaryRowsPerSlice = kIndexBytesPerSlice / kBinaryRowBytes;
+    constexpr int kMaxRowChars = 255;
+
+    const char* trim (char* text)
+    {
+        while (*text == ' ' || *text == '"')
+            ++text;
+
+        auto length = std::strlen (text);
+        while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '"' || text[length - 1] == '\r'))
+            text[--length] = 0;
+
+        return text;
+    }
+
+    // A number filling the whole field
+    bool parseNumber (const char* text, double& result)
+    {
+        char* end = nullptr;
+        result = std::strtod (text, &end);
+        return end != text && *end == 0 && std::isfinite (result);
+    }
+
+    double readLittleEndianDouble (const char* data) noexcept
+    {
+        auto bits = juce::ByteOrder::littleEndianInt64 (data);
+        double value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+}
+
+DataSeries::DataSeries()
+{
+    for (auto& t : requestedTime)
+        t.store (0.0);
+
+    for (auto& c : requestCount)
+        c.store (0);
+
+    indexThread.addTimeSliceClient (this);
+    indexThread.startThread (juce::Thread::Priority::low);
+}
+
+DataSeries::~DataSeries()
+{
+    indexThread.removeTimeSliceClient (this);
+    indexThread.stopThread (2000);
+}
+
+void DataSeries::loadAsync (const juce::File& file)
+{
+    const juce::ScopedLock sl (pendingLock);
+    pendingFile = file;
+    requestedFile = file;
+    loadPending = true;
+}
+
+juce::File DataSeries::getFile() const
+{
+    const juce::ScopedLock sl (pendingLock);
+    return requestedFile;
+}
+
+//==============================================================================
+// Audio threads
+
+float DataSeries::getValue (const EvolutionClock& clock, int reader) noexcept
+{
+    const auto* w = window.acquire (reader);
+    if (w == nullptr || w->times.empty())
+        return 0.0f;
+
+    double time = clock.getUnixTime();
+
+    if (getTimeline() == Timeline::Replay)
+    {
+        double span = w->lastTime - w->firstTime;
+        double elapsed = clock.getTimeSeconds();
+        time = w->firstTime + (span > 0.0 ? elapsed - span * std::floor (elapsed / span) : 0.0);
+    }
+
+    // Tell the indexer where this reader is (a single writer per slot)
+    requestedTime[static_cast<size_t> (reader)].store (time, std::memory_order_relaxed);
+    auto& count = requestCount[static_cast<size_t> (reader)];
+    count.store (count.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    // Linear interpolation; outside the window the nearest end holds
+    const auto& times = w->times;
+    auto upper = std::upper_bound (times.begin(), times.end(), time);
+
+    if (upper == times.begin())
+        return w->values.front();
+
+    if (upper == times.end())
+        return w->values.back();
+
+    auto i = static_cast<size_t> (upper - times.begin());
+    double t0 = times[i - 1], t1 = times[i];
+    float v0 = w->values[i - 1], v1 = w->values[i];
+
+    return t1 > t0 ? v0 + (v1 - v0) * static_cast<float> ((time - t0) / (t1 - t0)) : v1;
+}
+
+//==============================================================================
+// Indexing thread
+
+int DataSeries::useTimeSlice()
+{
+    juce::File fileToOpen;
+    bool shouldOpen = false;
+
+    {
+        const juce::ScopedLock sl (pendingLock);
+        std::swap (shouldOpen, loadPending);
+        fileToOpen = pendingFile;
+    }
+
+    if (shouldOpen)
+        open (fileToOpen);
+
+    if (source.file == juce::File())
+    {
+        window.collectGarbage();
+        return kIdleMilliseconds;
+    }
+
+    // Index what is mapped, then look for appended rows now and then
+    double now = juce::Time::getMillisecondCounterHiRes();
+    bool busy = false;
+
+    if (! source.caughtUp || now - lastGrowthCheck >= kGrowthCheckMilliseconds)
+    {
+        if (source.caughtUp)
+        {
+            lastGrowthCheck = now;
+
+            // Not grown since the last check: the writer has finished the
+            // row it left without a newline
+            if (! remap() && ! source.binary && ! source.tailComplete && source.indexedBytes < source.mappedBytes)
+            {
+                source.tailComplete = true;
+                source.caughtUp = false;
+            }
+        }
+
+        if (! source.caughtUp)
+            busy = indexMore();
+    }
+
+    const auto* current = window.peek();
+    updateReaders (current);
+
+    // Readers drive new windows at once; growth at most every growth check
+    bool readersMoved = needsNewWindow (current);
+    bool grew = needsWindow && now - lastPublish >= kGrowthCheckMilliseconds;
+
+    if (source.numRows > 0 && (current == nullptr || readersMoved || grew))
+    {
+        window.publish (buildWindow());
+        needsWindow = false;
+        lastPublish = now;
+    }
+
+    window.collectGarbage();
+    return busy ? 1 : kIdleMilliseconds;
+}
+
+void DataSeries::open (const juce::File& file)
+{
+    source = Source();
+    source.file = file;
+    source.binary = ! file.hasFileExtension ("csv;tsv;txt");
+
+    readers.fill (ReaderState());
+    speed = 1.0;
+    lastGrowthCheck = 0.0;
+    needsWindow = false;
+
+    window.publish (nullptr);
+}
+
+bool DataSeries::remap()
+{
+    auto size = source.file.getSize();
+
+    if (size == source.mappedBytes)
+        return false;
+
+    // Truncated or replaced: start again
+    if (size < source.mappedBytes)
+    {
+        auto file = source.file;
+        open (file);
+    }
+
+    source.map.reset();
+    source.mappedBytes = 0;
+    source.tailComplete = false;
+
+    if (size <= 0)
+        return false;
+
+    auto map = std::make_unique<juce::MemoryMappedFile> (source.file, juce::MemoryMappedFile::readOnly);
+    if (map->getData() == nullptr)
+        return false;
+
+    source.mappedBytes = static_cast<juce::int64> (map->getSize());
+    source.map = std::move (map);
+    source.caughtUp = false;
+    return true;
+}
+
+bool DataSeries::indexMore()
+{
+    auto rowsBefore = source.numRows;
+    auto minBefore = source.minimum, maxBefore = source.maximum;
+
+    auto add = [this] (const Row& row, juce::int64 offset)
+    {
+        if (! source.binary && source.numRows % kIndexStride == 0)
+            source.index.push_back ({ row.time, row.value, offset });
+
+        if (source.numRows == 0)
+        {
+            source.firstTime = row.time;
+            source.minimum = source.maximum = row.value;
+        }
+
+        source.lastTime = row.time;
+        source.lastValue = row.value;
+        source.minimum = juce::jmin (source.minimum, row.value);
+        source.maximum = juce::jmax (source.maximum, row.value);
+        ++source.numRows;
+    };
+
+    if (source.binary)
+    {
+        auto complete = source.mappedBytes / kBinaryRowBytes;
+        auto end = juce::jmin (complete, source.numRows + kBinaryRowsPerSlice);
+
+        while (source.numRows < end)
+        {
+            auto row = readBinaryRow (source.numRows);
+            if (std::isfinite (row.time) && std::isfinite (row.value))
+                add (row, source.numRows * kBinaryRowBytes);
+            else
+                add ({ source.lastTime, source.lastValue }, source.numRows * kBinaryRowBytes);   // Keep row numbers aligned
+        }
+
+        source.indexedBytes = source.numRows * kBinaryRowBytes;
+        source.caughtUp = source.numRows == complete;
+    }
+    else
+    {
+        const auto* data = static_cast<const char*> (source.map->getData());
+        auto end = juce::jmin (source.mappedBytes, source.indexedBytes + kIndexBytesPerSlice);
+
+        while (source.indexedBytes < end)
+        {
+            juce::int64 next = source.indexedBytes;
+            Row row;
+            bool parsed = parseCsvRow (source.indexedBytes, next, row);
+
+            // A partial last row waits for the rest of it. One without a
+            // newline is taken once the file stops growing, but only if it
+            // parses: a row cut short before its value keeps waiting.
+            if (next == source.indexedBytes || (! parsed && data[next - 1] != '\n'))
+                break;
+
+            if (parsed && (source.numRows == 0 || row.time >= source.lastTime))
+                add (row, source.indexedBytes);
+
+            source.indexedBytes = next;
+        }
+
+        // Stopped at a partial row, or indexed all that is mapped
+        source.caughtUp = source.indexedBytes < end || end == source.mappedBytes;
+    }
+
+    // New rows matter to a window that reaches the end, a new range to all of them
+    const auto* current = window.peek();
+
+    if (source.numRows != rowsBefore && (current == nullptr || current->reachesEnd))
+        needsWindow = true;
+
+    if (rowsBefore > 0 && (source.minimum != minBefore || source.maximum != maxBefore))
+        needsWindow = true;
+
+    return ! source.caughtUp;
+}
+
+void DataSeries::updateReaders (const Window* current)
+{
+    double now = juce::Time::getMillisecondCounterHiRes();
+    double measured = -1.0;
+
+    auto inWindow = [current] (double t)
+    {
+        return current != nullptr && ! current->times.empty()
+            && t >= current->times.front() && t <= current->times.back();
+    };
+
+    for (size_t r = 0; r < readers.size(); ++r)
+    {
+        auto& state = readers[r];
+        auto count = requestCount[r].load (std::memory_order_acquire);
+
+        if (count == state.lastCount)
+        {
+            if (now - state.lastSeen > kIdleReaderMilliseconds)
+                state.active = false;
+
+            continue;
+        }
+
+        double t = requestedTime[r].load (std::memory_order_relaxed);
+
+        // Speed from steady movement through the window; jumps (a new start
+        // time, a replay looping) don't count
+        if (state.active && now > state.lastSeen && inWindow (t) && inWindow (state.lastTime))
+            measured = juce::jmax (measured, std::abs (t - state.lastTime) * 1000.0 / (now - state.lastSeen));
+
+        state.lastCount = count;
+        state.lastTime = t;
+        state.lastSeen = now;
+        state.active = true;
+    }
+
+    if (measured >= 0.0)
+        speed += 0.25 * (measured - speed);
+}
+
+juce::int64 DataSeries::chooseStep() const
+{
+    if (source.numRows < 2 || source.lastTime <= source.firstTime)
+        return 1;
+
+    // Rows to skip so the part of a window ahead of the reader lasts kWindowSeconds
+    double spacing = (source.lastTime - source.firstTime) / static_cast<double> (source.numRows - 1);
+    double rowsNeeded = juce::jmax (1.0, speed) * kWindowSeconds / spacing;
+    auto step = static_cast<juce::int64> (std::ceil (rowsNeeded / (kWindowRows / 2)));
+    step = juce::jmax ((juce::int64) 1, step);
+
+    // Wide CSV strides read the index entries directly
+    if (! source.binary && step > kIndexStride)
+        step = (step + kIndexStride - 1) / kIndexStride * kIndexStride;
+
+    return step;
+}
+
+bool DataSeries::needsNewWindow (const Window* current) const
+{
+    if (current == nullptr || current->times.empty())
+        return source.numRows > 0;
+
+    // Keep every reader inside the middle of the window, unless the window
+    // already holds that end of the series
+    auto n = current->times.size();
+    double low = current->reachesStart ? -std::numeric_limits<double>::infinity() : current->times[n / 8];
+    double high = current->reachesEnd ? std::numeric_limits<double>::infinity() : current->times[n - 1 - n / 8];
+
+    for (const auto& state : readers)
+        if (state.active && (state.lastTime < low || state.lastTime > high))
+            return true;
+
+    // The time warp moved a long way: take a new stride
+    auto step = chooseStep();
+    return step > 2 * current->step || 2 * step < current->step;
+}
+
+std::unique_ptr<DataSeries::Window> DataSeries::buildWindow() const
+{
+    // Start a quarter of a window before the earliest reader
+    double from = std::numeric_limits<double>::infinity();
+
+    for (const auto& state : readers)
+        if (state.active)
+            from = juce::jmin (from, state.lastTime);
+
+    if (std::isinf (from))
+        from = getTimeline() == Timeline::Replay ? source.firstTime
+                                                 : static_cast<double> (juce::Time::currentTimeMillis()) / 1000.0;
+
+    auto step = chooseStep();
+    auto first = juce::jmax ((juce::int64) 0, findRow (from) - step * (kWindowRows / 4));
+
+    if (! source.binary && step >= kIndexStride)
+        first = first / kIndexStride * kIndexStride;
+
+    auto w = std::make_unique<Window>();
+    w->firstTime = source.firstTime;
+    w->lastTime = source.lastTime;
+    w->step = step;
+    w->firstRow = first;
+    w->times.reserve (kWindowRows + 1);
+    w->values.reserve (kWindowRows + 1);
+
+    double scale = source.maximum > source.minimum ? 2.0 / (source.maximum - source.minimum) : 0.0;
+    juce::int64 lastRow = first;
+
+    auto add = [&] (double time, double value, juce::int64 row)
+    {
+        w->times.push_back (time);
+        w->values.push_back (static_cast<float> ((value - source.minimum) * scale - (scale > 0.0 ? 1.0 : 0.0)));
+        lastRow = row;
+    };
+
+    if (source.binary)
+    {
+        for (auto row = first; row < source.numRows && (int) w->times.size() < kWindowRows; row += step)
+        {
+            auto r = readBinaryRow (row);
+            if (std::isfinite (r.time) && std::isfinite (r.value))
+                add (r.time, r.value, row);
+        }
+    }
+    else if (step >= kIndexStride)
+    {
+        auto entryStep = static_cast<size_t> (step / kIndexStride);
+
+        for (auto e = static_cast<size_t> (first / kIndexStride); e < source.index.size() && (int) w->times.size() < kWindowRows; e += entryStep)
+            add (source.index[e].time, source.index[e].value, static_cast<juce::int64> (e) * kIndexStride);
+    }
+    else
+    {
+        // Walk the rows from the index entry before the first one
+        auto e = static_cast<size_t> (first / kIndexStride);
+        auto offset = source.index[e].offset;
+        auto row = static_cast<juce::int64> (e) * kIndexStride;
+        double previous = -std::numeric_limits<double>::infinity();
+
+        while (offset < source.indexedBytes && row < source.numRows && (int) w->times.size() < kWindowRows)
+        {
+            juce::int64 next = offset;
+            Row r;
+            bool parsed = parseCsvRow (offset, next, r);
+
+            if (next == offset)
+                break;
+
+            // The same rows the indexer took
+            if (parsed && r.time >= previous)
+            {
+                if (row >= first && (row - first) % step == 0)
+                    add (r.time, r.value, row);
+
+                previous = r.time;
+                ++row;
+            }
+
+            offset = next;
+        }
+    }
+
+    // The window ends exactly on the last row, whatever the stride
+    w->reachesStart = first == 0;
+    w->reachesEnd = lastRow + step >= source.numRows;
+
+    if (w->reachesEnd && lastRow < source.numRows - 1)
+        add (source.lastTime, source.lastValue, source.numRows - 1);
+
+    w->lastRow = lastRow;
+    return w;
+}
+
+juce::int64 DataSeries::findRow (double time) const
+{
+    // The last row at or before the time (the first row if none)
+    if (source.binary)
+    {
+        juce::int64 low = 0, high = source.numRows;
+
+        while (low < high)
+        {
+            auto mid = low + (high - low) / 2;
+            if (readBinaryRow (mid).time <= time)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        return juce::jmax ((juce::int64) 0, low - 1);
+    }
+
+    if (source.index.empty())
+        return 0;
+
+    auto entry = std::upper_bound (source.index.begin(), source.index.end(), time,
+                                   [] (double t, const IndexEntry& e) { return t < e.time; });
+
+    if (entry == source.index.begin())
+        return 0;
+
+    --entry;
+    auto row = static_cast<juce::int64> (entry - source.index.begin()) * kIndexStride;
+    auto offset = entry->offset;
+    double previous = entry->time;
+
+    // At most kIndexStride rows on from the entry
+    for (auto found = row; offset < source.indexedBytes && found < source.numRows;)
+    {
+        juce::int64 next = offset;
+        Row r;
+        bool parsed = parseCsvRow (offset, next, r);
+
+        if (next == offset)
+            break;
+
+        if (parsed && r.time >= previous)
+        {
+            if (r.time > time)
+                break;
+
+            row = found++;
+            previous = r.time;
+        }
+
+        offset = next;
+    }
+
+    return row;
+}
+
+DataSeries::Row DataSeries::readBinaryRow (juce::int64 row) const noexcept
+{
+    const auto* data = static_cast<const char*> (source.map->getData()) + row * kBinaryRowBytes;
+    return { readLittleEndianDouble (data), readLittleEndianDouble (data + 8) };
+}
+
+bool DataSeries::parseCsvRow (juce::int64 offset, juce::int64& next, Row& row) const
+{
+    const auto* data = static_cast<const char*> (source.map->getData());
+    const auto* start = data + offset;
+    const auto* newline = static_cast<const char*> (std::memchr (start, '\n', static_cast<size_t> (source.mappedBytes - offset)));
+
+    if (newline == nullptr)
+    {
+        if (! source.tailComplete || offset >= source.mappedBytes)
+            return false;
+
+        newline = data + source.mappedBytes;
+    }
+
+    next = juce::jmin (source.mappedBytes, static_cast<juce::int64> (newline - data) + 1);
+
+    char line[kMaxRowChars + 1];
+    auto length = juce::jmin (static_cast<size_t> (newline - start), static_cast<size_t> (kMaxRowChars));
+    std::memcpy (line, start, length);
+    line[length] = 0;
+
+    char* separator = std::strpbrk (line, ",;\t");
+    if (separator == nullptr)
+        return false;
+
+    *separator = 0;
+    char* valueField = separator + 1;
+
+    if (char* end = std::strpbrk (valueField, ",;\t"))
+        *end = 0;
+
+    const char* timeText = trim (line);
+    const char* valueText = trim (valueField);
+
+    if (! parseNumber (valueText, row.value))
+        return false;
+
+    if (parseNumber (timeText, row.time))
+    {
+        if (row.time > 1.0e11)
+            row.time /= 1000.0;
+
+        return true;
+    }
+
+    // ISO 8601, with a space allowed between the date and the time
+    juce::String iso (timeText);
+    if (iso.length() > 10 && iso[10] == ' ')
+        iso = iso.substring (0, 10) + "T" + iso.substring (11);
+
+    auto milliseconds = juce::Time::fromISO8601 (iso).toMilliseconds();
+    if (milliseconds == 0)
+        return false;
+
+    row.time = static_cast<double> (milliseconds) / 1000.0;
+    return true;
+}
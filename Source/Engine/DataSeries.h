@@ -0,0 +1,145 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include "AtomicSnapshot.h"
+#include "EvolutionClock.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * DataSeries — A recorded time series (tides, weather, visitor counts) as a modulation source.
+ *
+ * The file is memory-mapped and never read whole. A background thread
+ * indexes it by timestamp: binary files are their own index, CSV files get
+ * a sparse index holding every kIndexStride-th row. The file size is polled,
+ * and rows appended to a log that is still being written are indexed as
+ * they arrive. A last CSV row without a newline counts once the size has
+ * held for a growth check.
+ *
+ * The audio threads never touch the file. Each reader reports the time it
+ * is at; the indexer publishes a window of rows around it, taken at a
+ * stride so the window lasts several seconds at the current time warp, and
+ * the readers interpolate inside it. Values are scaled to -1..1 over the
+ * range of the whole series.
+ *
+ * Formats:
+ *  - CSV (.csv, .tsv, .txt): a timestamp and a value per row, separated by a
+ *    comma, semicolon or tab. Timestamps are Unix seconds (milliseconds if
+ *    above 1e11) or ISO 8601. Rows that don't parse, such as a header, are
+ *    skipped.
+ *  - Anything else: little-endian records of two float64s, Unix seconds
+ *    then value.
+ * Rows are expected in time order; a CSV row older than the one before it
+ * is skipped.
+ */
+class DataSeries : private juce::TimeSliceClient
+{
+public:
+    static constexpr int kNumReaders = 2;              // The processor's and the lookahead's ModMatrix
+    static constexpr int kWindowRows = 4096;
+    static constexpr int kIndexStride = 256;           // CSV rows per index entry
+
+    enum class Timeline
+    {
+        Live,     // The clock's Unix time: follows a log as it is written, holding its ends
+        Replay    // From the first row, one series second per evolution second since midnight, looping
+    };
+
+    DataSeries();
+    ~DataSeries() override;
+
+    /** Open a file on the indexing thread (message thread). An empty File closes it. */
+    void loadAsync (const juce::File& file);
+
+    /** The file of the last request (message thread). */
+    juce::File getFile() const;
+
+    void setTimeline (Timeline newTimeline) noexcept   { timeline.store (static_cast<int> (newTimeline)); }
+    Timeline getTimeline() const noexcept              { return static_cast<Timeline> (timeline.load()); }
+
+    /** The series at the clock's time, -1..1, or 0 while nothing is loaded.
+        Real-time safe; each thread reads through its own reader slot. */
+    float getValue (const EvolutionClock& clock, int reader) noexcept;
+
+private:
+    struct Window
+    {
+        std::vector<double> times;
+        std::vector<float> values;
+        double firstTime = 0.0, lastTime = 0.0;   // Of the whole series
+        juce::int64 firstRow = 0, lastRow = 0;
+        juce::int64 step = 1;
+        bool reachesStart = true, reachesEnd = true;
+    };
+
+    struct IndexEntry
+    {
+        double time = 0.0;
+        double value = 0.0;
+        juce::int64 offset = 0;    // Byte offset of the row
+    };
+
+    struct Row
+    {
+        double time = 0.0;
+        double value = 0.0;
+    };
+
+    // Indexing thread only
+    struct Source
+    {
+        juce::File file;
+        bool binary = false;
+        std::unique_ptr<juce::MemoryMappedFile> map;
+        juce::int64 mappedBytes = 0;
+        juce::int64 indexedBytes = 0;    // Up to the end of the last complete row
+        juce::int64 numRows = 0;
+        bool caughtUp = true;
+        bool tailComplete = false;       // A last row without a newline counts
+        double firstTime = 0.0, lastTime = 0.0, lastValue = 0.0;
+        double minimum = 0.0, maximum = 0.0;
+        std::vector<IndexEntry> index;   // CSV only
+    };
+
+    struct ReaderState
+    {
+        juce::uint32 lastCount = 0;
+        double lastTime = 0.0;
+        double lastSeen = 0.0;           // Millisecond counter
+        bool active = false;
+    };
+
+    AtomicSnapshot<Window, kNumReaders> window;
+    std::array<std::atomic<double>, kNumReaders> requestedTime;
+    std::array<std::atomic<juce::uint32>, kNumReaders> requestCount;
+    std::atomic<int> timeline { static_cast<int> (Timeline::Live) };
+
+    juce::CriticalSection pendingLock;
+    juce::File pendingFile, requestedFile;
+    bool loadPending = false;
+
+    Source source;
+    std::array<ReaderState, kNumReaders> readers;
+    double speed = 1.0;                  // Series seconds per real second, as seen by the readers
+    double lastGrowthCheck = 0.0;
+    double lastPublish = 0.0;
+    bool needsWindow = false;
+
+    juce::TimeSliceThread indexThread { "CaptainDrift data indexer" };
+
+    int useTimeSlice() override;
+    void open (const juce::File& file);
+    bool indexMore();
+    bool remap();
+    void updateReaders (const Window* current);
+    juce::int64 chooseStep() const;
+    bool needsNewWindow (const Window* current) const;
+    std::unique_ptr<Window> buildWindow() const;
+
+    juce::int64 findRow (double time) const;
+    Row readBinaryRow (juce::int64 row) const noexcept;
+    bool parseCsvRow (juce::int64 offset, juce::int64& next, Row& row) const;
+
+    JUCE_DECLARE_NON_COPYABLE (DataSeries)
+};
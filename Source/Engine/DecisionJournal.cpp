@@ -0,0 +1,481 @@
+#include "DecisionJournal.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr int kWriteIntervalMilliseconds = 100;
+    constexpr int kLengthBytes = 2;                  // Each group in the ring is prefixed with its length
+    const char kMagic[4] = { 'K', 'D', 'J', '1' };
+}
+
+DecisionJournal::DecisionJournal()
+{
+    ring.resize (static_cast<size_t> (kRingBytes));
+
+    writerThread.addTimeSliceClient (this);
+    writerThread.startThread (juce::Thread::Priority::low);
+}
+
+DecisionJournal::~DecisionJournal()
+{
+    writerThread.removeTimeSliceClient (this);
+    writerThread.stopThread (2000);
+
+    // Whatever the audio thread left behind
+    drain();
+}
+
+void DecisionJournal::setFile (const juce::File& file)
+{
+    const juce::ScopedLock sl (pendingLock);
+    pendingFile = file;
+    requestedFile = file;
+    filePending = true;
+}
+
+juce::File DecisionJournal::getFile() const
+{
+    const juce::ScopedLock sl (pendingLock);
+    return requestedFile;
+}
+
+//==============================================================================
+// Audio thread
+
+bool DecisionJournal::wantsSegment() const noexcept
+{
+    // After an overflow, wait for the writer to make room
+    auto file = fileGeneration.load (std::memory_order_acquire);
+    return file != 0 && segmentGeneration != file && fifo.getFreeSpace() >= kRingBytes / 2;
+}
+
+bool DecisionJournal::isInSegment() const noexcept
+{
+    return segmentGeneration != 0 && segmentGeneration == fileGeneration.load (std::memory_order_acquire);
+}
+
+void DecisionJournal::startSegment (double newSampleRate, int newMaxBlockSize, std::uint64_t newSeed,
+                                    const EvolutionClock& clock) noexcept
+{
+    segmentGeneration = fileGeneration.load (std::memory_order_acquire);
+    sampleRate = newSampleRate;
+    maxBlockSize = newMaxBlockSize;
+    seed = newSeed;
+    startPending = true;
+
+    // Everything is recorded afresh in the first block
+    blockIndex = 0;
+    lastGroupBlock = 0;
+    lastBlockSize = -1;
+    hostValid = false;
+    keysValid = false;
+    routingValid = false;
+    lastRestartCount = clock.getRestartCount();
+    transport = {};
+    heldFields = 0;
+}
+
+void DecisionJournal::writeHeld (const ParameterSnapshot& params) noexcept
+{
+    using P = ParameterSnapshot;
+
+    if (! startPending)
+        return;
+
+    heldFields = params.getOverridden();
+
+    for (int i = 0; i < P::NumParameters; ++i)
+        heldValues[static_cast<size_t> (i)] = params.getBase (static_cast<P::Index> (i));
+}
+
+void DecisionJournal::writeBlock (int numSamples, const ParameterSnapshot& params, const PresetMorph::Started& morph,
+                                  const OscControl& remote, const ModMatrix& modulation, juce::uint32 followedKey,
+                                  juce::uint32 detectedKey, juce::AudioPlayHead* playHead) noexcept
+{
+    using P = ParameterSnapshot;
+
+    if (! isInSegment())
+        return;
+
+    group.clear();
+
+    if (startPending)
+    {
+        beginGroup();
+        group.writeByte (Start);
+        group.writeDouble (sampleRate);
+        group.writeVarint (static_cast<juce::uint64> (maxBlockSize));
+        group.writeUint64 (seed);
+        startPending = false;
+
+        if (heldFields != 0)
+        {
+            group.writeByte (Held);
+            writeFields (heldFields, heldValues.data());
+        }
+    }
+
+    if (numSamples != lastBlockSize)
+    {
+        beginGroup();
+        group.writeByte (BlockSize);
+        group.writeVarint (static_cast<juce::uint64> (numSamples));
+        lastBlockSize = numSamples;
+    }
+
+    // Host values, including those that only settled a committed morph
+    P::Mask fields = 0;
+
+    for (int i = 0; i < P::NumParameters; ++i)
+        if (! hostValid || params.getHost (static_cast<P::Index> (i)) != lastHost[static_cast<size_t> (i)])
+            fields |= P::bit (static_cast<P::Index> (i));
+
+    hostValid = true;
+
+    if (fields != 0)
+    {
+        for (int i = 0; i < P::NumParameters; ++i)
+            lastHost[static_cast<size_t> (i)] = params.getHost (static_cast<P::Index> (i));
+
+        beginGroup();
+        group.writeByte (Parameters);
+        writeFields (fields, lastHost.data());
+    }
+
+    if (morph.target != nullptr)
+    {
+        P::Mask morphFields = morph.release ? 0 : morph.target->fields;
+
+        beginGroup();
+        group.writeByte (Morph);
+        group.writeByte (morph.release ? 1 : 0);
+        group.writeDouble (morph.seconds);
+        writeFields (morphFields, morph.target->values.data());
+    }
+
+    if (remote.getApplied() != 0)
+    {
+        std::array<float, P::NumParameters> values {};
+
+        for (int i = 0; i < P::NumParameters; ++i)
+            values[static_cast<size_t> (i)] = remote.getAppliedValue (static_cast<P::Index> (i));
+
+        beginGroup();
+        group.writeByte (Remote);
+        writeFields (remote.getApplied(), values.data());
+    }
+
+    const auto* routing = modulation.getRouting();
+
+    if (! routingValid || routing != lastRouting)
+    {
+        int numRoutes = routing != nullptr ? routing->numRoutes : 0;
+
+        beginGroup();
+        group.writeByte (Routes);
+        group.writeByte (static_cast<juce::uint8> (numRoutes));
+
+        for (int i = 0; i < numRoutes; ++i)
+        {
+            const auto& r = routing->routes[static_cast<size_t> (i)];
+            group.writeByte (static_cast<juce::uint8> (r.source));
+            group.writeByte (static_cast<juce::uint8> (r.target));
+            group.writeFloat (r.depth);
+        }
+
+        lastRouting = routing;
+        routingValid = true;
+    }
+
+    if (! keysValid || followedKey != lastFollowedKey || detectedKey != lastDetectedKey)
+    {
+        beginGroup();
+        group.writeByte (Keys);
+        group.writeUint32 (followedKey);
+        group.writeUint32 (detectedKey);
+
+        lastFollowedKey = followedKey;
+        lastDetectedKey = detectedKey;
+        keysValid = true;
+    }
+
+    const auto& clock = modulation.getClock();
+
+    if (clock.getRestartCount() != lastRestartCount)
+    {
+        beginGroup();
+        group.writeByte (Clock);
+        group.writeDouble (clock.getWallClock());
+        lastRestartCount = clock.getRestartCount();
+    }
+
+    writeTransport (playHead, numSamples);
+
+    // Nothing changed for a long time: an empty group still marks the time
+    if (group.isEmpty() && blockIndex - lastGroupBlock >= kHeartbeatBlocks)
+        beginGroup();
+
+    if (! group.isEmpty())
+    {
+        group.writeByte (End);
+        pushGroup();
+        lastGroupBlock = blockIndex;
+    }
+
+    ++blockIndex;
+}
+
+void DecisionJournal::writeTransport (juce::AudioPlayHead* playHead, int numSamples) noexcept
+{
+    TransportState now;
+    now.flags = 0;
+
+    if (playHead != nullptr)
+    {
+        if (auto position = playHead->getPosition())
+        {
+            if (auto ppq = position->getPpqPosition())
+            {
+                now.flags |= HasPosition;
+                now.ppq = *ppq;
+            }
+
+            if (auto bpm = position->getBpm())
+            {
+                now.flags |= HasTempo;
+                now.bpm = *bpm;
+            }
+
+            if (position->getIsPlaying())
+                now.flags |= IsPlaying;
+        }
+    }
+
+    // The stored position is the prediction for this block
+    bool moved = now.flags != transport.flags || now.bpm != transport.bpm
+              || ((now.flags & HasPosition) != 0 && std::abs (now.ppq - transport.ppq) > kPositionTolerance);
+
+    if (moved)
+    {
+        beginGroup();
+        group.writeByte (Transport);
+        group.writeByte (now.flags);
+        group.writeDouble (now.ppq);
+        group.writeDouble (now.bpm);
+        transport = now;
+    }
+
+    transport.ppq = advancePosition (transport.ppq, transport.bpm, (transport.flags & IsPlaying) != 0,
+                                     numSamples, sampleRate);
+}
+
+void DecisionJournal::beginGroup() noexcept
+{
+    if (group.isEmpty())
+        group.writeVarint (static_cast<juce::uint64> (blockIndex - lastGroupBlock));
+}
+
+void DecisionJournal::writeFields (ParameterSnapshot::Mask fields, const float* values) noexcept
+{
+    using P = ParameterSnapshot;
+
+    group.writeUint32 (fields);
+
+    for (int i = 0; i < P::NumParameters; ++i)
+        if (fields & P::bit (static_cast<P::Index> (i)))
+            group.writeFloat (values[i]);
+}
+
+void DecisionJournal::pushGroup() noexcept
+{
+    int size = group.getSize();
+    int total = kLengthBytes + size;
+
+    // Full: the segment ends here, and the processor starts another
+    if (fifo.getFreeSpace() < total)
+    {
+        segmentGeneration = 0;
+        return;
+    }
+
+    juce::uint8 length[kLengthBytes] = { static_cast<juce::uint8> (size & 0xff), static_cast<juce::uint8> (size >> 8) };
+
+    // The length and the body are published together, so the writer never
+    // sees one without the other
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (total, start1, size1, start2, size2);
+
+    auto copyIn = [&] (int offset, const juce::uint8* data, int numBytes)
+    {
+        int first = juce::jlimit (0, numBytes, size1 - offset);
+
+        if (first > 0)
+            std::memcpy (ring.data() + start1 + offset, data, static_cast<size_t> (first));
+
+        if (first < numBytes)
+            std::memcpy (ring.data() + start2 + juce::jmax (0, offset - size1), data + first,
+                         static_cast<size_t> (numBytes - first));
+    };
+
+    copyIn (0, length, kLengthBytes);
+    copyIn (kLengthBytes, group.getData(), size);
+    fifo.finishedWrite (size1 + size2);
+}
+
+//==============================================================================
+// Group encoding
+
+void DecisionJournal::Group::writeByte (juce::uint8 value) noexcept
+{
+    if (size < kMaxGroupBytes)
+        bytes[static_cast<size_t> (size++)] = value;
+}
+
+void DecisionJournal::Group::writeVarint (juce::uint64 value) noexcept
+{
+    while (value >= 0x80)
+    {
+        writeByte (static_cast<juce::uint8> (value | 0x80));
+        value >>= 7;
+    }
+
+    writeByte (static_cast<juce::uint8> (value));
+}
+
+void DecisionJournal::Group::writeUint32 (juce::uint32 value) noexcept
+{
+    for (int i = 0; i < 4; ++i)
+        writeByte (static_cast<juce::uint8> (value >> (8 * i)));
+}
+
+void DecisionJournal::Group::writeUint64 (juce::uint64 value) noexcept
+{
+    for (int i = 0; i < 8; ++i)
+        writeByte (static_cast<juce::uint8> (value >> (8 * i)));
+}
+
+void DecisionJournal::Group::writeFloat (float value) noexcept
+{
+    juce::uint32 bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    writeUint32 (bits);
+}
+
+void DecisionJournal::Group::writeDouble (double value) noexcept
+{
+    juce::uint64 bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    writeUint64 (bits);
+}
+
+//==============================================================================
+// Writer thread
+
+int DecisionJournal::useTimeSlice()
+{
+    juce::File fileToOpen;
+    bool shouldOpen = false;
+
+    {
+        const juce::ScopedLock sl (pendingLock);
+        std::swap (shouldOpen, filePending);
+        fileToOpen = pendingFile;
+    }
+
+    if (shouldOpen)
+        open (fileToOpen);
+
+    drain();
+    return kWriteIntervalMilliseconds;
+}
+
+void DecisionJournal::open (const juce::File& file)
+{
+    // The old file's groups go to the old file
+    drain();
+    stream.reset();
+    fileGeneration.store (0, std::memory_order_release);
+
+    if (file == juce::File())
+        return;
+
+    // Append only to a journal, never to some other file
+    bool fresh = ! file.existsAsFile() || file.getSize() == 0;
+
+    if (! fresh)
+    {
+        juce::FileInputStream in (file);
+        char magic[sizeof (kMagic)] = {};
+
+        if (! in.openedOk() || in.read (magic, sizeof (magic)) != static_cast<int> (sizeof (magic))
+            || std::memcmp (magic, kMagic, sizeof (kMagic)) != 0)
+            return;
+    }
+
+    auto next = std::make_unique<juce::FileOutputStream> (file);
+    if (next->failedToOpen())
+        return;
+
+    if (fresh)
+        next->write (kMagic, sizeof (kMagic));
+
+    stream = std::move (next);
+
+    // Groups still in flight belong to the last segment; wait for a Start
+    awaitingStart = true;
+
+    if (++openedGenerations == 0)
+        ++openedGenerations;
+
+    fileGeneration.store (openedGenerations, std::memory_order_release);
+}
+
+void DecisionJournal::drain()
+{
+    int ready = fifo.getNumReady();
+    if (ready == 0)
+        return;
+
+    // After whatever was left of the last drain
+    auto kept = drained.size();
+    drained.resize (kept + static_cast<size_t> (ready));
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (ready, start1, size1, start2, size2);
+
+    std::memcpy (drained.data() + kept, ring.data() + start1, static_cast<size_t> (size1));
+    if (size2 > 0)
+        std::memcpy (drained.data() + kept + static_cast<size_t> (size1), ring.data() + start2, static_cast<size_t> (size2));
+
+    fifo.finishedRead (size1 + size2);
+
+    // Whole groups only; a partial one waits for the next drain
+    size_t pos = 0;
+
+    while (pos + kLengthBytes <= drained.size())
+    {
+        auto size = static_cast<size_t> (drained[pos] | (drained[pos + 1] << 8));
+        if (pos + kLengthBytes + size > drained.size())
+            break;
+
+        const auto* data = drained.data() + pos + kLengthBytes;
+        pos += kLengthBytes + size;
+
+        if (awaitingStart)
+        {
+            if (size < 2 || data[0] != 0 || data[1] != Start)
+                continue;
+
+            awaitingStart = false;
+        }
+
+        if (stream != nullptr)
+            stream->write (data, size);
+    }
+
+    drained.erase (drained.begin(), drained.begin() + static_cast<std::ptrdiff_t> (pos));
+
+    if (stream != nullptr)
+        stream->flush();
+}
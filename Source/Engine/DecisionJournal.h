@@ -0,0 +1,201 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "ModMatrix.h"
+#include "OscControl.h"
+#include "ParameterSnapshot.h"
+#include "PresetMorph.h"
+#include <array>
+#include <atomic>
+#include <memory>
+
+/**
+ * DecisionJournal — Records what the generator was given, so any moment can be regenerated.
+ *
+ * The output is a function of the seed and of what each block was handed:
+ * the host parameter values, the preset morphs taken up, the values sent
+ * over OSC, the modulation routes, the followed and detected keys, the host
+ * transport, the wall clock read when the evolution clock restarts, and the
+ * block length. The journal stores only those inputs, and only when they
+ * change, so a day of an installation left alone takes a few kilobytes.
+ * JournalReplay rebuilds the notes and audio from them.
+ *
+ * A segment starts from a clean slate, the same state prepareToPlay leaves:
+ * the processor restarts the generation when one begins. The audio thread
+ * encodes each block's changes into a group and pushes it into a lock-free
+ * ring; a background thread appends the ring to the file. If the ring ever
+ * fills, the segment ends there and a new one starts.
+ *
+ * Not journaled: the lookahead's pacing (replay generates directly, as with
+ * Lookout off), a DataSeries, the sample layer, and the melody and tuning
+ * files (replay uses the ones loaded when it runs).
+ *
+ * File format: the bytes "KDJ1", then groups. A group is a varint count of
+ * blocks since the previous group of the segment, records, and a zero byte.
+ * Each record is a type byte and a payload (little-endian):
+ *  - Start:      float64 sample rate, varint prepared block size, uint64 seed.
+ *                Block 0 of a segment.
+ *  - BlockSize:  varint samples.
+ *  - Parameters: uint32 field mask, a float32 host value per field.
+ *  - Transport:  uint8 flags (position, playing, tempo), float64 beat, float64 bpm.
+ *  - Keys:       uint32 followed key, uint32 detected key.
+ *  - Clock:      float64 Unix seconds read by the clock restart in this block.
+ *  - Morph:      uint8 release, float64 seconds, uint32 field mask, a float32 per field.
+ *  - Routes:     uint8 count, then uint8 source, uint8 target, float32 depth each.
+ *  - Remote:     uint32 field mask, a float32 per field: the OSC values applied.
+ *  - Held:       uint32 field mask, a float32 per field: the OSC overrides still
+ *                held after block 0's host values. Block 0 of a segment.
+ * Records apply to the block before it is processed. Between Transport
+ * records the position follows advancePosition().
+ */
+class DecisionJournal : private juce::TimeSliceClient
+{
+public:
+    static constexpr int kRingBytes = 1 << 16;
+    static constexpr int kMaxGroupBytes = 1024;
+    static constexpr int kHeartbeatBlocks = 4096;   // An empty group at least this often marks the segment's length
+    static constexpr double kPositionTolerance = 1.0e-9;   // Beats the host may drift from the prediction
+
+    enum RecordType : juce::uint8
+    {
+        End = 0,
+        Start,
+        BlockSize,
+        Parameters,
+        Transport,
+        Keys,
+        Clock,
+        Morph,
+        Routes,
+        Remote,
+        Held
+    };
+
+    enum TransportFlags : juce::uint8
+    {
+        HasPosition = 1,
+        IsPlaying = 2,
+        HasTempo = 4
+    };
+
+    DecisionJournal();
+    ~DecisionJournal() override;
+
+    //==============================================================================
+    // Message thread
+
+    /** Append to a journal file (created if needed). An empty File stops. */
+    void setFile (const juce::File& file);
+
+    /** The file of the last request. */
+    juce::File getFile() const;
+
+    //==============================================================================
+    // Audio thread
+
+    /** Recording, the current segment (if any) has ended, and the ring has
+        room for a new one. */
+    bool wantsSegment() const noexcept;
+
+    bool isInSegment() const noexcept;
+
+    /** Begin a segment with the next block (after the generation restarted). */
+    void startSegment (double sampleRate, int maxBlockSize, std::uint64_t seed, const EvolutionClock& clock) noexcept;
+
+    /** Note the overrides a new segment's first update() left held (from
+        OSC; segments start between morphs). A no-op after block 0. */
+    void writeHeld (const ParameterSnapshot& params) noexcept;
+
+    /** End the segment (e.g. on prepare, or while rendering offline). */
+    void endSegment() noexcept { segmentGeneration = 0; }
+
+    /** Journal one processed block. */
+    void writeBlock (int numSamples, const ParameterSnapshot& params, const PresetMorph::Started& morph,
+                     const OscControl& remote, const ModMatrix& modulation, juce::uint32 followedKey,
+                     juce::uint32 detectedKey, juce::AudioPlayHead* playHead) noexcept;
+
+    /** The beat position a block after this one, as both the journal and the
+        replay predict it. */
+    static double advancePosition (double ppq, double bpm, bool playing, int numSamples, double sampleRate) noexcept
+    {
+        return playing && bpm > 0.0 ? ppq + numSamples * bpm / (60.0 * sampleRate) : ppq;
+    }
+
+private:
+    // Audio thread: the group being encoded
+    class Group
+    {
+    public:
+        void clear() noexcept                      { size = 0; }
+        bool isEmpty() const noexcept              { return size == 0; }
+        int getSize() const noexcept               { return size; }
+        const juce::uint8* getData() const noexcept { return bytes.data(); }
+
+        void writeByte (juce::uint8 value) noexcept;
+        void writeVarint (juce::uint64 value) noexcept;
+        void writeUint32 (juce::uint32 value) noexcept;
+        void writeUint64 (juce::uint64 value) noexcept;
+        void writeFloat (float value) noexcept;
+        void writeDouble (double value) noexcept;
+
+    private:
+        std::array<juce::uint8, kMaxGroupBytes> bytes {};
+        int size = 0;
+    };
+
+    struct TransportState
+    {
+        juce::uint8 flags = 0xff;        // Never a real combination: the first block records it
+        double ppq = 0.0;
+        double bpm = 0.0;
+    };
+
+    // Ring of length-prefixed groups (audio thread writes, writer thread reads)
+    std::vector<juce::uint8> ring;
+    juce::AbstractFifo fifo { kRingBytes };
+
+    // Audio thread
+    Group group;
+    juce::uint32 segmentGeneration = 0;  // File generation the segment is written to, 0 = none
+    double sampleRate = 44100.0;
+    int maxBlockSize = 0;
+    std::uint64_t seed = 0;
+    bool startPending = false;
+    ParameterSnapshot::Mask heldFields = 0;
+    std::array<float, ParameterSnapshot::NumParameters> heldValues {};
+    juce::int64 blockIndex = 0, lastGroupBlock = 0;
+    int lastBlockSize = -1;
+    std::array<float, ParameterSnapshot::NumParameters> lastHost {};
+    bool hostValid = false;
+    juce::uint32 lastFollowedKey = 0, lastDetectedKey = 0;
+    bool keysValid = false;
+    const ModMatrix::Routing* lastRouting = nullptr;
+    bool routingValid = false;
+    unsigned int lastRestartCount = 0;
+    TransportState transport;
+
+    // Set by the writer thread once a file is open; 0 while not recording
+    std::atomic<juce::uint32> fileGeneration { 0 };
+
+    juce::CriticalSection pendingLock;
+    juce::File pendingFile, requestedFile;
+    bool filePending = false;
+
+    // Writer thread
+    std::unique_ptr<juce::FileOutputStream> stream;
+    juce::uint32 openedGenerations = 0;
+    bool awaitingStart = false;
+    std::vector<juce::uint8> drained;
+
+    juce::TimeSliceThread writerThread { "CaptainDrift journal writer" };
+
+    void beginGroup() noexcept;
+    void writeFields (ParameterSnapshot::Mask fields, const float* values) noexcept;
+    void writeTransport (juce::AudioPlayHead* playHead, int numSamples) noexcept;
+    void pushGroup() noexcept;
+
+    int useTimeSlice() override;
+    void open (const juce::File& file);
+    void drain();
+
+    JUCE_DECLARE_NON_COPYABLE (DecisionJournal)
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <vector>
+
+/**
+ * DriftEvent — Internal note event passed from the generator to the synths.
+ *
+ * Plain data, no MIDI encoding: the pitch offset stays a float in cents
+ * instead of a 14-bit pitch-wheel value. MIDI bytes are only produced by
+ * MidiEventWriter when the MIDI output is actually wanted.
+ */
+struct DriftEvent
+{
+    // Generative voices are numbered 0 .. kMaxVoices - 1
+    static constexpr int kMaxVoices = 512;
+
+    enum Type : juce::uint8
+    {
+        NoteOn = 0,
+        NoteOff,
+        Bend
+    };
+
+    Type type = NoteOn;
+    juce::uint8 note = 0;
+    juce::uint8 velocity = 0;
+    juce::int16 voice = 0;       // Generative voice index
+    int samplePosition = 0;      // Offset within the current block
+    float cents = 0.0f;          // Bend only: detune from the note in cents
+};
+
+/**
+ * DriftEventList — One voice's events for the current block.
+ *
+ * A fixed-capacity window onto storage owned by GenerativeEngine and
+ * sized in prepare(). Never allocates; events beyond the capacity are
+ * dropped, except that the last slot only takes a note-off. A voice
+ * sounds one note at a time, so its note always ends.
+ * A voice appends in time order, so every list is sorted.
+ */
+class DriftEventList
+{
+public:
+    void setStorage (DriftEvent* data, int capacityToUse) noexcept
+    {
+        storage = data;
+        capacity = capacityToUse;
+        numEvents = 0;
+    }
+
+    void clear() noexcept { numEvents = 0; }
+
+    bool add (const DriftEvent& e) noexcept
+    {
+        int limit = e.type == DriftEvent::NoteOff ? capacity : capacity - 1;
+
+        if (numEvents >= limit)
+        {
+            jassert (e.type != DriftEvent::NoteOff);
+            return false;
+        }
+
+        storage[numEvents++] = e;
+        return true;
+    }
+
+    int size() const noexcept { return numEvents; }
+    bool isEmpty() const noexcept { return numEvents == 0; }
+
+    const DriftEvent& operator[] (int index) const noexcept { return storage[index]; }
+
+    const DriftEvent* begin() const noexcept { return storage; }
+    const DriftEvent* end() const noexcept   { return storage + numEvents; }
+
+private:
+    DriftEvent* storage = nullptr;
+    int capacity = 0;
+    int numEvents = 0;
+};
+
+/**
+ * DriftEventQueue — Fixed-capacity list of DriftEvents for one block.
+ *
+ * Storage is allocated in prepare(), off the audio thread; add() never
+ * allocates. Events beyond the capacity are dropped, but a reserve of one
+ * slot per voice only takes note-offs, so sounding notes always end.
+ * GenerativeEngine fills it in time order by merging the voices' lists.
+ */
+class DriftEventQueue
+{
+public:
+    // Slots only note-offs may take
+    static constexpr int kNoteOffReserve = DriftEvent::kMaxVoices;
+
+    /** Allocate room for this many events, plus the note-off reserve. */
+    void prepare (int capacityToUse)
+    {
+        events.assign (static_cast<size_t> (juce::jmax (0, capacityToUse) + kNoteOffReserve), DriftEvent());
+        numEvents = 0;
+    }
+
+    void clear() noexcept { numEvents = 0; }
+
+    bool add (const DriftEvent& e) noexcept
+    {
+        int limit = static_cast<int> (events.size()) - (e.type == DriftEvent::NoteOff ? 0 : kNoteOffReserve);
+
+        if (numEvents >= limit)
+        {
+            jassert (e.type != DriftEvent::NoteOff);
+            return false;
+        }
+
+        events[static_cast<size_t> (numEvents++)] = e;
+        return true;
+    }
+
+    int size() const noexcept { return numEvents; }
+    bool isEmpty() const noexcept { return numEvents == 0; }
+
+    const DriftEvent* begin() const noexcept { return events.data(); }
+    const DriftEvent* end() const noexcept   { return events.data() + numEvents; }
+
+private:
+    std::vector<DriftEvent> events;
+    int numEvents = 0;
+};
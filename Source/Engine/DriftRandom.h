@@ -0,0 +1,104 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <cstdint>
+
+/**
+ * DriftRandom — Small counter-based random generator.
+ *
+ * The n-th output is a pure function of (key, n): the SplitMix64 finalizer
+ * applied to key + n · golden ratio. The state is two 64-bit words, so
+ * any point of the stream can be reached in O(1) by setting the counter,
+ * and two voices with different keys never share a sequence.
+ *
+ * Integers use Lemire's multiply-and-reject method (no modulo bias);
+ * floats take the top 24 bits, so every value in [0, 1) is equally likely.
+ */
+class DriftRandom
+{
+public:
+    DriftRandom() = default;
+    explicit DriftRandom (std::uint64_t seed) noexcept { setSeed (seed); }
+
+    /** Select the stream and rewind to its start. */
+    void setSeed (std::uint64_t seed) noexcept
+    {
+        key = mix (seed + kGolden);
+        counter = 0;
+    }
+
+    /** Position in the stream (number of 64-bit outputs drawn so far). */
+    std::uint64_t getPosition() const noexcept { return counter; }
+    void setPosition (std::uint64_t position) noexcept { counter = position; }
+
+    /** Skip n outputs in constant time. */
+    void jumpAhead (std::uint64_t n) noexcept { counter += n; }
+
+    /** The output at any position of the stream, without moving. */
+    std::uint64_t at (std::uint64_t position) const noexcept
+    {
+        return mix (key + position * kGolden);
+    }
+
+    std::uint64_t nextUint64() noexcept { return at (counter++); }
+    std::uint32_t nextUint32() noexcept { return static_cast<std::uint32_t> (nextUint64() >> 32); }
+
+    /** Uniform float in [0, 1). */
+    float nextFloat() noexcept
+    {
+        return static_cast<float> (nextUint32() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    /** Uniform float in [low, high). */
+    float nextFloat (float low, float high) noexcept
+    {
+        return low + (high - low) * nextFloat();
+    }
+
+    /** Uniform integer in [0, range), unbiased. Returns 0 for an empty range. */
+    std::uint32_t nextBelow (std::uint32_t range) noexcept
+    {
+        if (range == 0)
+            return 0;
+
+        std::uint64_t m = static_cast<std::uint64_t> (nextUint32()) * range;
+        auto low = static_cast<std::uint32_t> (m);
+
+        if (low < range)
+        {
+            // Reject the few values that would make the low results more likely
+            std::uint32_t threshold = (0u - range) % range;
+
+            while (low < threshold)
+            {
+                m = static_cast<std::uint64_t> (nextUint32()) * range;
+                low = static_cast<std::uint32_t> (m);
+            }
+        }
+
+        return static_cast<std::uint32_t> (m >> 32);
+    }
+
+    /** Uniform integer in [low, high], both inclusive. */
+    int nextInt (int low, int high) noexcept
+    {
+        if (high <= low)
+            return low;
+
+        auto range = static_cast<std::uint32_t> (static_cast<std::int64_t> (high) - low + 1);
+        return static_cast<int> (static_cast<std::int64_t> (low) + nextBelow (range));
+    }
+
+private:
+    static constexpr std::uint64_t kGolden = 0x9E3779B97F4A7C15ull;
+
+    // SplitMix64 finalizer
+    static constexpr std::uint64_t mix (std::uint64_t z) noexcept
+    {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t key = 0;
+    std::uint64_t counter = 0;
+};
@@ -1,203 +1,382 @@
 #include "DriftVoice.h"
 #include <cmath>
+#include <limits>
+
+namespace
+{
+    const DriftVoiceSettings defaultSettings;
+}
 
 DriftVoice::DriftVoice()
+    : settings (&defaultSettings)
 {
 }
 
-void DriftVoice::init (int voiceIndex, int midiChannel)
+void DriftVoice::init (int voiceIndex, std::uint64_t seed)
 {
     voiceIdx = voiceIndex;
-    channel = midiChannel;
     pitchBend.setVoiceIndex (voiceIndex);
+    phaseAcc.setVoiceIndex (voiceIndex);
 
     // Seed RNG with voice index for deterministic but unique behavior
-    rng.seed (static_cast<unsigned> (42 + voiceIndex * 997));
+    rng.setSeed (seed + static_cast<std::uint64_t> (voiceIndex) * 997);
 }
 
 void DriftVoice::reset()
 {
+    if (currentNote >= 0 && settings->harmony != nullptr)
+        settings->harmony->removeNote (currentNote);
+
     currentNote = -1;
     currentVelocity = 0;
     noteOffCountdown = 0;
     lastScaleDegreeOffset = 0;
+    noteIndex = 0;
+    walkValid = false;
     phaseAcc.reset();
     pitchBend.reset();
 }
 
-void DriftVoice::setScaleQuantizer (const ScaleQuantizer* quantizer)
+void DriftVoice::setSettings (const DriftVoiceSettings* newSettings)
 {
-    scaleQ = quantizer;
+    settings = (newSettings != nullptr) ? newSettings : &defaultSettings;
 }
 
-void DriftVoice::setNoteDensity (float notesPerBar)
+void DriftVoice::applySettings()
 {
-    // Convert notes-per-bar to beats-per-note (assuming 4/4 time)
-    double beatsPerNote = 4.0 / static_cast<double> (notesPerBar);
-    phaseAcc.setBasePeriod (beatsPerNote);
+    phaseAcc.setBasePeriod (settings->beatsPerNote);
+    phaseAcc.setDrift (settings->phaseDrift);
+    pitchBend.setMaxCents (settings->microtonalCents);
 }
 
-void DriftVoice::setLegatoFactor (float legato)
+void DriftVoice::processBlock (DriftEventList& events, double beatsPerSample,
+                                int numSamples, double secondsPerSample)
 {
-    legatoFactor = juce::jlimit (0.1f, 1.0f, legato);
+    applySettings();
+    process (events, 0, numSamples, beatsPerSample, secondsPerSample);
 }
 
-void DriftVoice::setVelocityRange (float range)
+void DriftVoice::process (DriftEventList& events, int startSample, int endSample,
+                          double beatsPerSample, double secondsPerSample)
 {
-    velocityRange = juce::jlimit (0.0f, 1.0f, range);
-}
+    // Jump from event to event instead of stepping every sample.
+    // "n samples until X" counts the sample on which X happens, matching
+    // a per-sample loop that advances first and then tests.
+    int position = startSample;
 
-void DriftVoice::setOctaveRange (int minOctave, int maxOctave)
-{
-    octaveMin = juce::jlimit (2, 6, minOctave);
-    octaveMax = juce::jlimit (3, 7, maxOctave);
+    while (position < endSample)
+    {
+        int remaining = endSample - position;
 
-    if (octaveMax <= octaveMin)
-        octaveMax = octaveMin + 1;
-}
+        int toTrigger = phaseAcc.samplesUntilTrigger (beatsPerSample);
+        int toNoteOff = (currentNote >= 0) ? samplesUntil (noteOffCountdown, beatsPerSample) : kNever;
+        int toBend    = (currentNote >= 0) ? juce::jmax (1, bendCountdown) : kNever;
 
-void DriftVoice::setPhaseDrift (float driftAmount)
-{
-    phaseAcc.setDrift (driftAmount, voiceIdx);
+        int step = juce::jmin (remaining, toTrigger, juce::jmin (toNoteOff, toBend));
+
+        // Advance all clocks in one go
+        pitchBend.advance (secondsPerSample * step);
+        phaseAcc.advanceBy (beatsPerSample * step);
+        if (currentNote >= 0)
+        {
+            noteOffCountdown -= beatsPerSample * step;
+            bendCountdown -= step;
+        }
+
+        int sample = position + step - 1;
+        position += step;
+
+        // Same order as a per-sample pass: note-off, trigger, detune check
+        if (step == toNoteOff)
+            releaseCurrentNote (events, sample);
+
+        if (step == toTrigger)
+        {
+            phaseAcc.wrap();
+
+            // Release any held note first
+            if (currentNote >= 0)
+                releaseCurrentNote (events, sample);
+
+            triggerNewNote (events, sample);
+        }
+        else if (currentNote >= 0 && step == toBend)
+        {
+            checkBend (events, sample);
+        }
+    }
 }
 
-void DriftVoice::setMicrotonalDepth (float cents)
+int DriftVoice::samplesUntilNoteChange (double beatsPerSample) const
 {
-    pitchBend.setMaxCents (cents);
+    int toTrigger = phaseAcc.samplesUntilTrigger (beatsPerSample);
+    int toNoteOff = (currentNote >= 0) ? samplesUntil (noteOffCountdown, beatsPerSample) : kNever;
+    return juce::jmin (toTrigger, toNoteOff);
 }
 
-void DriftVoice::setRandomness (float chaos)
+int DriftVoice::samplesUntil (double beats, double beatsPerSample)
 {
-    randomness = juce::jlimit (0.0f, 1.0f, chaos);
+    if (beatsPerSample <= 0.0)
+        return kNever;
+
+    double samples = std::ceil (beats / beatsPerSample);
+    if (samples < 1.0)
+        return 1;
+
+    return samples < static_cast<double> (kNever) ? static_cast<int> (samples) : kNever;
 }
 
-void DriftVoice::processBlock (juce::MidiBuffer& midiBuffer, double beatsPerSample,
-                                int numSamples, double secondsPerSample)
+void DriftVoice::seekTo (DriftEventList& events, int samplePosition,
+                         double beatPosition, double timeSeconds)
 {
-    for (int sample = 0; sample < numSamples; ++sample)
-    {
-        // Advance microtonal LFO
-        pitchBend.advance (secondsPerSample);
+    releaseCurrentNote (events, samplePosition);
+    applySettings();
 
-        // Count down note-off timer
-        if (currentNote >= 0)
-        {
-            noteOffCountdown -= beatsPerSample;
+    pitchBend.setTime (timeSeconds);
+    noteIndex = phaseAcc.seek (beatPosition);
+    walkValid = false;
 
-            if (noteOffCountdown <= 0.0)
-            {
-                releaseCurrentNote (midiBuffer, sample);
-            }
-        }
+    // Chase the note that would still be sounding here
+    double length = phaseAcc.getEffectivePeriod() * static_cast<double> (settings->legato);
+    double elapsed = phaseAcc.getPhaseBeats();
 
-        // Advance phase accumulator and check for trigger
-        if (phaseAcc.advance (beatsPerSample))
-        {
-            // Release any held note first
-            if (currentNote >= 0)
-                releaseCurrentNote (midiBuffer, sample);
+    if (noteIndex > 0 && elapsed < length)
+        startNote (events, samplePosition, length - elapsed);
+}
 
-            triggerNewNote (midiBuffer, sample);
-        }
+void DriftVoice::triggerNewNote (DriftEventList& events, int samplePosition)
+{
+    ++noteIndex;
 
-        // Send pitch bend updates periodically (every ~64 samples to save bandwidth)
-        if (currentNote >= 0 && (sample % 64 == 0))
-        {
-            int bendValue = pitchBend.getPitchBendValue();
-            auto bendMsg = juce::MidiMessage::pitchWheel (channel, bendValue);
-            midiBuffer.addEvent (bendMsg, sample);
-        }
-    }
+    // Note duration = legato factor * effective period
+    startNote (events, samplePosition,
+               phaseAcc.getEffectivePeriod() * static_cast<double> (settings->legato));
 }
 
-void DriftVoice::triggerNewNote (juce::MidiBuffer& midiBuffer, int samplePosition)
+void DriftVoice::startNote (DriftEventList& events, int samplePosition, double lengthBeats)
 {
-    int note = generateNextNote();
+    int degree = generateNextDegree();
     int velocity = generateVelocity();
 
+    // No scale or no degrees in range: middle C
+    int note = degree >= 0 ? settings->scale->getNoteAtDegree (degree) : 60;
     if (note < 0 || note > 127)
         return;
 
     currentNote = note;
     currentVelocity = velocity;
+    tuningCents = degree >= 0 ? settings->scale->getCentsAtDegree (degree) : 0.0f;
 
-    // Note duration = legato factor * effective period
-    noteOffCountdown = phaseAcc.getEffectivePeriod() * static_cast<double> (legatoFactor);
+    if (settings->harmony != nullptr)
+        settings->harmony->addNote (note);
+    noteOffCountdown = lengthBeats;
 
     // Send pitch bend before note-on
-    int bendValue = pitchBend.getPitchBendValue();
-    midiBuffer.addEvent (juce::MidiMessage::pitchWheel (channel, bendValue), samplePosition);
+    addBend (events, samplePosition);
 
     // Send note-on
-    midiBuffer.addEvent (juce::MidiMessage::noteOn (channel, note, (juce::uint8) velocity), samplePosition);
+    DriftEvent e;
+    e.type = DriftEvent::NoteOn;
+    e.voice = static_cast<juce::int16> (voiceIdx);
+    e.note = static_cast<juce::uint8> (note);
+    e.velocity = static_cast<juce::uint8> (velocity);
+    e.samplePosition = samplePosition;
+    events.add (e);
 }
 
-void DriftVoice::releaseCurrentNote (juce::MidiBuffer& midiBuffer, int samplePosition)
+void DriftVoice::releaseCurrentNote (DriftEventList& events, int samplePosition)
 {
     if (currentNote >= 0)
     {
-        midiBuffer.addEvent (juce::MidiMessage::noteOff (channel, currentNote, (juce::uint8) 0), samplePosition);
+        DriftEvent e;
+        e.type = DriftEvent::NoteOff;
+        e.voice = static_cast<juce::int16> (voiceIdx);
+        e.note = static_cast<juce::uint8> (currentNote);
+        e.samplePosition = samplePosition;
+        events.add (e);
+
+        if (settings->harmony != nullptr)
+            settings->harmony->removeNote (currentNote);
+
         currentNote = -1;
         currentVelocity = 0;
     }
 }
 
-int DriftVoice::generateNextNote()
+void DriftVoice::checkBend (DriftEventList& events, int samplePosition)
 {
+    // Only send the detune when it has moved far enough to matter
+    float cents = pitchBend.getCurrentCents();
+
+    if (std::abs (cents - lastBendCents) >= settings->bendStepCents)
+        addBend (events, samplePosition);
+    else
+        bendCountdown = settings->bendIntervalSamples;
+}
+
+void DriftVoice::addBend (DriftEventList& events, int samplePosition)
+{
+    lastBendCents = pitchBend.getCurrentCents();
+    bendCountdown = settings->bendIntervalSamples;
+
+    DriftEvent e;
+    e.type = DriftEvent::Bend;
+    e.voice = static_cast<juce::int16> (voiceIdx);
+    e.note = static_cast<juce::uint8> (juce::jmax (0, currentNote));
+    e.samplePosition = samplePosition;
+    e.cents = lastBendCents + tuningCents;
+    events.add (e);
+}
+
+int DriftVoice::generateNextDegree()
+{
+    const auto* scaleQ = settings->scale;
     if (scaleQ == nullptr)
-        return 60;  // Middle C fallback
+        return -1;
+
+    int lowNote = settings->octaveMin * 12;    // MIDI note at bottom of range
+    int highNote = (settings->octaveMax + 1) * 12 - 1;  // MIDI note at top of range
+
+    auto range = scaleQ->getDegreeRange (lowNote, highNote);
+    if (range.numNotes == 0)
+        return -1;
+
+    if (walkValid && noteIndex % kPhraseLength != 0)
+    {
+        lastScaleDegreeOffset = walkStep (lastScaleDegreeOffset, noteIndex, range);
+    }
+    else
+    {
+        // Phrase start, or the previous position is unknown after a seek:
+        // replay the walk from the phrase anchor
+        long long phraseStart = noteIndex - noteIndex % kPhraseLength;
+        int offset = walkAnchor (phraseStart, range.numNotes);
+
+        for (long long i = phraseStart + 1; i <= noteIndex; ++i)
+            offset = walkStep (offset, i, range);
 
-    int lowNote = octaveMin * 12;    // MIDI note at bottom of range
-    int highNote = (octaveMax + 1) * 12 - 1;  // MIDI note at top of range
+        lastScaleDegreeOffset = offset;
+        walkValid = true;
+    }
+
+    int centerIndex = range.numNotes / 2;
+    int degree = range.firstDegree + centerIndex + lastScaleDegreeOffset;
+
+    if (settings->harmony != nullptr && settings->harmonyTolerance >= 0)
+        return harmonize (degree, range);
 
-    auto scaleNotes = scaleQ->getNotesInRange (lowNote, highNote);
-    if (scaleNotes.empty())
-        return 60;
+    return degree;
+}
+
+int DriftVoice::harmonize (int degree, const ScaleQuantizer::DegreeRange& range)
+{
+    // Try the walk's degree, then the degrees either side of it (which side
+    // first is a coin toss per note); keep the first that fits the chord,
+    // or else the one that clashes least
+    static constexpr int kOffsets[] = { 0, 1, -1, 2, -2 };
 
-    // Constrained random walk: move ±1–3 scale degrees from current position
-    int maxStep = 1 + static_cast<int> (randomness * 3.0f);
+    seekRandom (noteIndex, 3);
+    int direction = (rng.nextUint32() & 1) != 0 ? 1 : -1;
 
-    std::uniform_int_distribution<int> stepDist (-maxStep, maxStep);
-    int step = stepDist (rng);
+    int best = degree;
+    int bestDissonance = std::numeric_limits<int>::max();
 
-    // Bias toward small steps (more melodic)
-    if (std::abs (step) > 1)
+    for (int offset : kOffsets)
     {
-        std::uniform_real_distribution<float> biasDist (0.0f, 1.0f);
-        if (biasDist (rng) > randomness)
-            step = (step > 0) ? 1 : -1;
+        int candidate = degree + offset * direction;
+        if (candidate < range.firstDegree || candidate >= range.firstDegree + range.numNotes)
+            continue;
+
+        int note = settings->scale->getNoteAtDegree (candidate);
+        int dissonance = settings->harmony->getDissonance (note);
+
+        if (dissonance <= settings->harmonyTolerance)
+            return candidate;
+
+        if (dissonance < bestDissonance)
+        {
+            best = candidate;
+            bestDissonance = dissonance;
+        }
     }
 
-    lastScaleDegreeOffset += step;
+    return best;
+}
 
-    // Find the target note
-    int centerIndex = static_cast<int> (scaleNotes.size()) / 2;
-    int targetIndex = centerIndex + lastScaleDegreeOffset;
+int DriftVoice::walkAnchor (long long index, int numNotes)
+{
+    // Phrases start somewhere around the middle of the range
+    seekRandom (index, 0);
+    int spread = numNotes / 4;
+    return rng.nextInt (-spread, spread);
+}
+
+int DriftVoice::walkStep (int offset, long long index, const ScaleQuantizer::DegreeRange& range)
+{
+    int numNotes = range.numNotes;
+    int step = 0;
+
+    if (settings->melody != nullptr)
+    {
+        // Transition matrix: one draw from the row of the current degree
+        int degree = range.firstDegree + numNotes / 2 + offset;
+
+        // A tuning can have more degree classes than the matrix has rows
+        int degreeClass = settings->scale->getDegreeClass (degree) % MarkovMelody::kMaxClasses;
+
+        seekRandom (index, 0);
+        step = MarkovMelody::drawStep (*settings->melody, degreeClass, rng.nextUint64());
+    }
+    else
+    {
+        // Constrained random walk: move ±1–3 scale degrees from current position
+        float randomness = settings->randomness;
+        int maxStep = 1 + static_cast<int> (randomness * 3.0f);
+
+        seekRandom (index, 0);
+        step = rng.nextInt (-maxStep, maxStep);
+
+        // Bias toward small steps (more melodic)
+        if (std::abs (step) > 1)
+        {
+            seekRandom (index, 1);
+            if (rng.nextFloat() > randomness)
+                step = (step > 0) ? 1 : -1;
+        }
+    }
+
+    offset += step;
+
+    // Find the target index within the range
+    int centerIndex = numNotes / 2;
+    int targetIndex = centerIndex + offset;
 
     // Wrap around if out of range (bounce off edges)
     if (targetIndex < 0)
-    {
         targetIndex = -targetIndex;
-        lastScaleDegreeOffset = targetIndex - centerIndex;
-    }
-    if (targetIndex >= static_cast<int> (scaleNotes.size()))
+
+    if (targetIndex >= numNotes)
     {
-        targetIndex = static_cast<int> (scaleNotes.size()) - 1 - (targetIndex - static_cast<int> (scaleNotes.size()) + 1);
+        targetIndex = numNotes - 1 - (targetIndex - numNotes + 1);
         if (targetIndex < 0) targetIndex = 0;
-        lastScaleDegreeOffset = targetIndex - centerIndex;
     }
 
-    return scaleNotes[targetIndex];
+    return targetIndex - centerIndex;
+}
+
+void DriftVoice::seekRandom (long long index, int slot)
+{
+    rng.setPosition (static_cast<std::uint64_t> (index) * kDrawsPerNote + static_cast<std::uint64_t> (slot));
 }
 
 int DriftVoice::generateVelocity()
 {
     // Base velocity 60–100, modulated by velocityRange parameter
     float baseVelocity = 80.0f;
-    float spread = 30.0f * velocityRange;
+    float spread = 30.0f * settings->velocityRange;
 
-    std::uniform_real_distribution<float> dist (-spread, spread);
-    float vel = baseVelocity + dist (rng);
+    seekRandom (noteIndex, 2);
+    float vel = baseVelocity + rng.nextFloat (-spread, spread);
 
     return juce::jlimit (30, 120, static_cast<int> (vel));
 }
@@ -1,45 +1,99 @@
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
+#include "DriftEvent.h"
 #include "ScaleQuantizer.h"
 #include "PhaseAccumulator.h"
 #include "MicrotonalPitchBend.h"
-#include <random>
+#include "DriftRandom.h"
+#include "HarmonyState.h"
+#include "MarkovMelody.h"
+
+/**
+ * DriftVoiceSettings — Parameters shared by every generative voice.
+ * Written by GenerativeEngine once per block.
+ */
+struct DriftVoiceSettings
+{
+    const ScaleQuantizer* scale = nullptr;
+    const MarkovMelody::Table* melody = nullptr;   // Transition matrix; nullptr = random walk
+    double beatsPerNote = 1.0;
+    float legato = 0.7f;             // 0.1–1
+    float velocityRange = 0.5f;      // 0–1
+    int octaveMin = 3;
+    int octaveMax = 5;
+    float phaseDrift = 0.0f;         // 0–1
+    float microtonalCents = 15.0f;
+    float randomness = 0.2f;         // 0–1
+    int bendIntervalSamples = 256;   // How often a held note's detune is checked
+    float bendStepCents = 0.5f;      // Change needed before a new bend is sent
+    HarmonyState* harmony = nullptr; // Chord of the whole swarm; voices register their notes
+    int harmonyTolerance = -1;       // Dissonance a new note may add; -1 = no constraint
+};
 
 /**
  * DriftVoice — A single generative voice.
  *
- * Performs a constrained random walk within a musical scale,
- * generating MIDI note-on/off events and pitch bend messages.
- * Each voice occupies its own MIDI channel (1–8) for independent
- * microtonal pitch bend.
+ * Walks through a musical scale, generating note-on/off and pitch bend
+ * events for the synths. Each step is either a constrained random step
+ * or, when the settings carry a MarkovMelody table, a draw from the
+ * transition row of the current degree. With a harmony tolerance set,
+ * a note that clashes with the rest of the swarm is moved to the nearest
+ * scale degree that fits; the walk itself carries on unchanged, so seeks
+ * still land on the same line.
+ * Each voice carries its own microtonal detune, on top of the cents a
+ * loaded tuning puts between a degree and its MIDI note; MidiEventWriter assigns
+ * MIDI channels to sounding voices when the events go out as MIDI.
+ *
+ * Every note is numbered, and its random draws come from a fixed slot of
+ * the voice's counter-based stream. The walk restarts from a random anchor
+ * every kPhraseLength notes. Together these make the voice at any beat
+ * position a function of (seed, parameters, position): seekTo() rebuilds
+ * it by replaying at most one phrase.
+ *
+ * The parameters live in a DriftVoiceSettings shared by the whole swarm,
+ * so a voice only holds its own timing, pitch and random-stream state.
  */
 class DriftVoice
 {
 public:
     DriftVoice();
 
-    /** Initialize the voice with its index (0–7) and MIDI channel (1–8). */
-    void init (int voiceIndex, int midiChannel);
+    /** Initialize the voice with its index and the engine seed. */
+    void init (int voiceIndex, std::uint64_t seed);
 
     /** Reset to initial state. */
     void reset();
 
-    /** Set parameters for this voice. */
-    void setScaleQuantizer (const ScaleQuantizer* quantizer);
-    void setNoteDensity (float notesPerBar);
-    void setLegatoFactor (float legato);
-    void setVelocityRange (float range);
-    void setOctaveRange (int minOctave, int maxOctave);
-    void setPhaseDrift (float driftAmount);
-    void setMicrotonalDepth (float cents);
-    void setRandomness (float chaos);
-
-    /** Process a block of time. Adds MIDI events to the buffer.
+    /** Point the voice at the swarm's shared parameters. */
+    void setSettings (const DriftVoiceSettings* newSettings);
+
+    /** Process a block of time. Appends events to the voice's list.
         beatsPerSample: how many beats each sample represents.
         numSamples: number of samples in the block. */
-    void processBlock (juce::MidiBuffer& midiBuffer, double beatsPerSample,
+    void processBlock (DriftEventList& events, double beatsPerSample,
                        int numSamples, double secondsPerSample);
 
+    /** Process part of a block, from startSample up to (not including)
+        endSample. Consecutive calls over a block match one processBlock(). */
+    void process (DriftEventList& events, int startSample, int endSample,
+                  double beatsPerSample, double secondsPerSample);
+
+    /** Samples until the voice next starts or ends a note, counting the
+        sample on which it does; kNever if it never will. */
+    int samplesUntilNoteChange (double beatsPerSample) const;
+
+    /** Take up the shared settings (processBlock() and seekTo() do this). */
+    void applySettings();
+
+    /** Jump to an absolute position. Releases the held note and, if the
+        note sounding at that position is still within its length, starts it
+        again at samplePosition. */
+    void seekTo (DriftEventList& events, int samplePosition,
+                 double beatPosition, double timeSeconds);
+
+    /** Release the held note, if any, at the given sample position. */
+    void releaseCurrentNote (DriftEventList& events, int samplePosition);
+
     /** Check if this voice is currently holding a note. */
     bool isNoteActive() const { return currentNote >= 0; }
 
@@ -47,34 +101,44 @@ public:
     int getCurrentNote() const { return currentNote; }
     int getCurrentVelocity() const { return currentVelocity; }
 
+    static constexpr int kNever = 1 << 30;
+
 private:
     int voiceIdx = 0;
-    int channel = 1;
 
     // State
     int currentNote = -1;        // Currently held MIDI note (-1 = none)
     int currentVelocity = 0;
     double noteOffCountdown = 0; // Beats until note-off
+    int bendCountdown = 0;       // Samples until the next detune check
+    float lastBendCents = 0.0f;  // Detune last sent for the held note
+    float tuningCents = 0.0f;    // Offset of the held note's tuned pitch from its MIDI note
     int lastScaleDegreeOffset = 0;
+    long long noteIndex = 0;     // Notes triggered since beat 0
+    bool walkValid = false;      // lastScaleDegreeOffset belongs to noteIndex
 
     // Components
     PhaseAccumulator phaseAcc;
     MicrotonalPitchBend pitchBend;
-    const ScaleQuantizer* scaleQ = nullptr;
+    const DriftVoiceSettings* settings = nullptr;
 
-    // Parameters
-    float legatoFactor = 0.7f;
-    float velocityRange = 0.5f;
-    int octaveMin = 3;
-    int octaveMax = 5;
-    float randomness = 0.2f;
+    // RNG (16 bytes, counter-based)
+    DriftRandom rng;
 
-    // RNG
-    std::mt19937 rng;
+    // Notes per walk phrase, and random stream slots reserved per note
+    static constexpr int kPhraseLength = 32;
+    static constexpr int kDrawsPerNote = 4;
 
     // Internal methods
-    void triggerNewNote (juce::MidiBuffer& midiBuffer, int samplePosition);
-    void releaseCurrentNote (juce::MidiBuffer& midiBuffer, int samplePosition);
-    int generateNextNote();
+    static int samplesUntil (double beats, double beatsPerSample);
+    void triggerNewNote (DriftEventList& events, int samplePosition);
+    void startNote (DriftEventList& events, int samplePosition, double lengthBeats);
+    void addBend (DriftEventList& events, int samplePosition);
+    void checkBend (DriftEventList& events, int samplePosition);
+    int generateNextDegree();
+    int harmonize (int degree, const ScaleQuantizer::DegreeRange& range);
     int generateVelocity();
+    int walkAnchor (long long index, int numNotes);
+    int walkStep (int offset, long long index, const ScaleQuantizer::DegreeRange& range);
+    void seekRandom (long long index, int slot);
 };
@@ -0,0 +1,179 @@
+#include "EnsembleChorus.h"
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+EnsembleChorus::EnsembleChorus()
+{
+    resetPhasors();
+}
+
+void EnsembleChorus::prepare (double newSampleRate, int /*blockSize*/)
+{
+    sampleRate = newSampleRate;
+
+    auto msToSamples = static_cast<float> (sampleRate / 1000.0);
+    baseDelay = kBaseDelayMs * msToSamples;
+    slowDepth = kSlowDepthMs * msToSamples;
+    fastDepth = kFastDepthMs * msToSamples;
+
+    // Per-sample rotation of the LFO phasors
+    double slowStep = 2.0 * M_PI * kSlowRateHz / sampleRate;
+    double fastStep = 2.0 * M_PI * kFastRateHz / sampleRate;
+    slowRotCos = static_cast<float> (std::cos (slowStep));
+    slowRotSin = static_cast<float> (std::sin (slowStep));
+    fastRotCos = static_cast<float> (std::cos (fastStep));
+    fastRotSin = static_cast<float> (std::sin (fastStep));
+
+    reset();
+}
+
+void EnsembleChorus::reset()
+{
+    delayLine.fill (0.0f);
+    writePos = 0;
+    resetPhasors();
+}
+
+void EnsembleChorus::setMix (float newMix)
+{
+    mix = juce::jlimit (0.0f, 1.0f, newMix);
+}
+
+void EnsembleChorus::resetPhasors()
+{
+    // Taps are spread evenly around the circle; the right side sits halfway between the left taps
+    alignas (32) float c[kTapsPerSide], s[kTapsPerSide], fc[kTapsPerSide], fs[kTapsPerSide];
+
+    for (int side = 0; side < 2; ++side)
+    {
+        for (int lane = 0; lane < kTapsPerSide; ++lane)
+        {
+            double phase = 2.0 * M_PI * (lane + 0.5 * side) / kTapsPerSide;
+            c[lane]  = static_cast<float> (std::cos (phase));
+            s[lane]  = static_cast<float> (std::sin (phase));
+            fc[lane] = static_cast<float> (std::cos (phase * 2.0 + 0.3));
+            fs[lane] = static_cast<float> (std::sin (phase * 2.0 + 0.3));
+        }
+
+        slowCos[side] = Vec::fromRawArray (c);
+        slowSin[side] = Vec::fromRawArray (s);
+        fastCos[side] = Vec::fromRawArray (fc);
+        fastSin[side] = Vec::fromRawArray (fs);
+    }
+}
+
+void EnsembleChorus::process (juce::AudioBuffer<float>& buffer)
+{
+    auto numSamples = buffer.getNumSamples();
+    auto numChannels = buffer.getNumChannels();
+
+    if (numChannels == 0)
+        return;
+
+    float inputScale = numChannels > 1 ? 0.5f : 1.0f;
+
+    // Bypassed: keep the delay line current, so raising the mix never
+    // replays what was playing before the bypass
+    if (mix <= 0.0f)
+    {
+        const float* inLeft  = buffer.getReadPointer (0);
+        const float* inRight = buffer.getReadPointer (numChannels > 1 ? 1 : 0);
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            delayLine[static_cast<size_t> (writePos)] = (numChannels > 1) ? (inLeft[sample] + inRight[sample]) * inputScale : inLeft[sample];
+            writePos = (writePos + 1) & kDelayMask;
+        }
+
+        return;
+    }
+
+    float* left  = buffer.getWritePointer (0);
+    float* right = buffer.getWritePointer (numChannels > 1 ? 1 : 0);
+    float dryGain = 1.0f - mix;
+
+    for (int sample = 0; sample < numSamples; ++sample)
+    {
+        float in = (numChannels > 1) ? (left[sample] + right[sample]) * inputScale : left[sample];
+
+        delayLine[static_cast<size_t> (writePos)] = in;
+
+        float wetL = renderSide (0);
+        float wetR = renderSide (1);
+
+        if (numChannels > 1)
+        {
+            left[sample]  = in * dryGain + wetL * mix;
+            right[sample] = in * dryGain + wetR * mix;
+        }
+        else
+        {
+            left[sample] = in * dryGain + 0.5f * (wetL + wetR) * mix;
+        }
+
+        writePos = (writePos + 1) & kDelayMask;
+    }
+
+    // Re-normalise the phasors once per block so rounding never lets them grow or decay
+    for (int side = 0; side < 2; ++side)
+    {
+        auto slowMag = slowCos[side] * slowCos[side] + slowSin[side] * slowSin[side];
+        auto fastMag = fastCos[side] * fastCos[side] + fastSin[side] * fastSin[side];
+        auto slowFix = Vec::expand (1.5f) - slowMag * 0.5f;
+        auto fastFix = Vec::expand (1.5f) - fastMag * 0.5f;
+
+        slowCos[side] *= slowFix;
+        slowSin[side] *= slowFix;
+        fastCos[side] *= fastFix;
+        fastSin[side] *= fastFix;
+    }
+}
+
+float EnsembleChorus::renderSide (int side)
+{
+    // Advance the LFOs: one complex rotation per lane
+    auto sc = slowCos[side], ss = slowSin[side];
+    slowCos[side] = sc * slowRotCos - ss * slowRotSin;
+    slowSin[side] = ss * slowRotCos + sc * slowRotSin;
+
+    auto fc = fastCos[side], fs = fastSin[side];
+    fastCos[side] = fc * fastRotCos - fs * fastRotSin;
+    fastSin[side] = fs * fastRotCos + fc * fastRotSin;
+
+    auto delay = Vec::expand (baseDelay) + slowSin[side] * slowDepth + fastSin[side] * fastDepth;
+
+    alignas (32) float delays[kTapsPerSide];
+    alignas (32) float x0[kTapsPerSide], x1[kTapsPerSide], x2[kTapsPerSide], x3[kTapsPerSide];
+    alignas (32) float frac[kTapsPerSide];
+    delay.copyToRawArray (delays);
+
+    // Gather the four neighbours of every tap (the only scalar part)
+    for (int lane = 0; lane < kTapsPerSide; ++lane)
+    {
+        auto whole = static_cast<int> (delays[lane]);
+        frac[lane] = delays[lane] - static_cast<float> (whole);
+
+        int pos = writePos - whole;
+        x0[lane] = delayLine[static_cast<size_t> ((pos + 1) & kDelayMask)];
+        x1[lane] = delayLine[static_cast<size_t> (pos & kDelayMask)];
+        x2[lane] = delayLine[static_cast<size_t> ((pos - 1) & kDelayMask)];
+        x3[lane] = delayLine[static_cast<size_t> ((pos - 2) & kDelayMask)];
+    }
+
+    // Cubic (Catmull-Rom) interpolation across all lanes at once
+    auto p0 = Vec::fromRawArray (x0);
+    auto p1 = Vec::fromRawArray (x1);
+    auto p2 = Vec::fromRawArray (x2);
+    auto p3 = Vec::fromRawArray (x3);
+    auto t  = Vec::fromRawArray (frac);
+
+    auto c1 = (p2 - p0) * 0.5f;
+    auto c2 = p0 - p1 * 2.5f + p2 * 2.0f - p3 * 0.5f;
+    auto c3 = (p3 - p0) * 0.5f + (p1 - p2) * 1.5f;
+    auto y  = ((c3 * t + c2) * t + c1) * t + p1;
+
+    return y.sum() / static_cast<float> (kTapsPerSide);
+}
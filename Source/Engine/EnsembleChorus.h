@@ -0,0 +1,58 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+
+/**
+ * EnsembleChorus — String-machine style ensemble after the pad voice sum.
+ *
+ * One mono delay line is read by several modulated taps per side, like the
+ * classic bucket-brigade ensembles: each tap follows a slow and a fast LFO
+ * with its own phase offset. All taps of one side live in the lanes of a
+ * single SIMD register, so the LFOs (rotating phasors, no sin calls), the
+ * delay times and the cubic interpolation are computed in parallel.
+ */
+class EnsembleChorus
+{
+public:
+    EnsembleChorus();
+
+    void prepare (double sampleRate, int blockSize);
+    void reset();
+
+    /** Wet/dry mix (0 = bypass, 1 = fully wet). */
+    void setMix (float mix);
+
+    /** Process the buffer in place. The input is summed to mono; the output is stereo. */
+    void process (juce::AudioBuffer<float>& buffer);
+
+private:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int kTapsPerSide = static_cast<int> (Vec::SIMDNumElements);
+    static constexpr int kDelaySize = 8192;    // Enough for the longest tap at 384 kHz
+    static constexpr int kDelayMask = kDelaySize - 1;
+
+    // Classic ensemble timings
+    static constexpr float kBaseDelayMs = 9.0f;
+    static constexpr float kSlowDepthMs = 3.0f;
+    static constexpr float kFastDepthMs = 0.35f;
+    static constexpr float kSlowRateHz  = 0.63f;
+    static constexpr float kFastRateHz  = 5.7f;
+
+    double sampleRate = 44100.0;
+    float mix = 0.0f;
+
+    std::array<float, kDelaySize> delayLine {};
+    int writePos = 0;
+
+    // Per-tap LFO phasors (cos, sin), one register per side
+    Vec slowCos[2], slowSin[2], fastCos[2], fastSin[2];
+    float slowRotCos = 1.0f, slowRotSin = 0.0f;
+    float fastRotCos = 1.0f, fastRotSin = 0.0f;
+
+    float baseDelay = 0.0f, slowDepth = 0.0f, fastDepth = 0.0f;   // In samples
+
+    void resetPhasors();
+    float renderSide (int side);
+};
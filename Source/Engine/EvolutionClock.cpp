@@ -0,0 +1,55 @@
+#include "EvolutionClock.h"
+#include "EvolutionCurve.h"
+#include <algorithm>
+#include <cmath>
+
+void EvolutionClock::prepare (double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    updateIncrement();
+
+    // The only wall clock read
+    preparedWallClock = EvolutionCurve::getCurrentUnixSeconds();
+    samplesSincePrepare = 0;
+    restart();
+}
+
+void EvolutionClock::setStartTime (double secondsSinceMidnight)
+{
+    startTime = secondsSinceMidnight < 0.0 ? -1.0 : std::min (secondsSinceMidnight, kSecondsPerDay);
+    restart();
+}
+
+void EvolutionClock::setWarp (double factor)
+{
+    warp = std::max (0.0, factor);
+    updateIncrement();
+}
+
+void EvolutionClock::setFollowsTimeline (bool shouldFollow)
+{
+    following = shouldFollow;
+    restart();
+}
+
+void EvolutionClock::restart()
+{
+    // Counted on from the reading taken in prepare
+    double now = pinnedWallClock >= 0.0 ? pinnedWallClock
+                                        : preparedWallClock + static_cast<double> (samplesSincePrepare) / sampleRate;
+    wallClock = now;
+    ++restartCount;
+    double secondsSinceMidnight = std::fmod (now, kSecondsPerDay);
+
+    dayStart = now - secondsSinceMidnight;
+
+    if (following)
+        timeSeconds = getOrigin() + timelineSeconds * warp;
+    else
+        timeSeconds = startTime < 0.0 ? secondsSinceMidnight : startTime;
+}
+
+void EvolutionClock::updateIncrement()
+{
+    secondsPerSample = warp / sampleRate;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+/**
+ * EvolutionClock — Timebase for the 24-hour evolution curves.
+ *
+ * Wall time is read once, in prepare (off the audio thread). A restart
+ * (a new start time, or following the timeline or not) takes that reading
+ * plus the real time processed since. From then on the clock advances by
+ * the samples actually processed, scaled by a time-warp factor, so the
+ * audio thread never asks the system for the time and an offline render
+ * with a fixed start time always evolves the same way. The time does not wrap at
+ * midnight; the curves are continuous through it.
+ *
+ * While following the host timeline (offline renders) the time is the
+ * start time plus the warped timeline position instead, and a wall-clock
+ * start is taken as midnight, so every bounce of a passage is identical.
+ */
+class EvolutionClock
+{
+public:
+    static constexpr double kSecondsPerDay = 86400.0;
+
+    /** Set the sample rate, read the wall clock and restart from the start time. */
+    void prepare (double sampleRate);
+
+    /** Start at a fixed time of day (seconds since midnight), or at the
+        wall clock when negative. Restarts the clock. */
+    void setStartTime (double secondsSinceMidnight);
+
+    /** Evolution seconds per real second (1 = real time). */
+    void setWarp (double factor);
+
+    /** Follow the host timeline instead of the wall clock. Restarts the clock. */
+    void setFollowsTimeline (bool shouldFollow);
+
+    bool followsTimeline() const noexcept { return following; }
+
+    /** Host timeline position in seconds, once per block while following. */
+    void setTimelinePosition (double seconds) noexcept
+    {
+        timelineSeconds = seconds;
+        timeSeconds = getOrigin() + timelineSeconds * warp;
+    }
+
+    /** Advance by processed samples. */
+    void advance (int numSamples) noexcept
+    {
+        timeSeconds += numSamples * secondsPerSample;
+        samplesSincePrepare += numSamples;
+    }
+
+    /** Current evolution time in seconds since midnight of the start day. */
+    double getTimeSeconds() const noexcept { return timeSeconds; }
+
+    /** Unix time the last restart started from, and the number of restarts
+        so far, for journaling the wall clock. */
+    double getWallClock() const noexcept            { return wallClock; }
+    unsigned int getRestartCount() const noexcept   { return restartCount; }
+
+    /** Have restarts take this Unix time instead of the system clock
+        (replaying a journal). */
+    void setWallClock (double unixSeconds) noexcept { pinnedWallClock = unixSeconds; }
+
+    /** The evolution time as Unix seconds (from midnight UTC of the day the
+        clock started), for lining it up with recorded data. */
+    double getUnixTime() const noexcept { return dayStart + timeSeconds; }
+
+private:
+    void restart();
+    void updateIncrement();
+
+    double getOrigin() const noexcept { return startTime < 0.0 ? 0.0 : startTime; }
+
+    double sampleRate = 44100.0;
+    double warp = 1.0;
+    double startTime = -1.0;           // Negative: wall clock
+    double secondsPerSample = 1.0 / 44100.0;
+    double timeSeconds = 0.0;
+    double dayStart = 0.0;             // Unix time of the start day's midnight
+    double timelineSeconds = 0.0;
+    bool following = false;
+    double wallClock = 0.0;
+    double preparedWallClock = 0.0;    // Unix time read in prepare
+    long long samplesSincePrepare = 0;
+    double pinnedWallClock = -1.0;     // Negative: use the system clock
+    unsigned int restartCount = 0;
+};
@@ -4,39 +4,32 @@
 /**
  * EvolutionCurve — 24-hour deterministic modulation source.
  *
- * Returns a value 0–1 that changes slowly over a 24-hour period.
- * Uses a sum of sinusoids at prime-ratio periods to create complex,
- * non-repeating (within the day) but deterministic modulation.
+ * A curve is the mean of five sinusoids at prime-ratio periods, which
+ * changes slowly and does not repeat within the day. Each curve's seed
+ * gives its sinusoids their own phases, so different curves evolve
+ * differently.
  *
- * Multiple independent curves with different phase seeds
- * allow different parameters to evolve differently.
+ * This defines the sinusoids; the ModMatrix runs them as rotating phasors,
+ * starting from getAngle().
  */
 class EvolutionCurve
 {
 public:
-    EvolutionCurve();
+    /** Wall clock as whole Unix seconds. A system call: the audio thread
+        reads time from an EvolutionClock instead. */
+    static double getCurrentUnixSeconds();
 
-    /** Set the seed for this particular curve instance.
-        Different seeds produce different evolution shapes. */
-    void setSeed (int seed);
+    static constexpr int kNumTerms = 5;
 
-    /** Set the evolution depth (0–1). At 0, the curve always returns 0.5.
-        At 1, the curve uses full range. */
-    void setDepth (float depth);
+    /** Angle (radians) of one sinusoid of a seeded curve at a given time. */
+    static double getAngle (int seed, int term, double seconds);
 
-    /** Evaluate the curve at a given time (seconds since midnight).
-        Returns a value in [0, 1]. */
-    float evaluate (double secondsSinceMidnight) const;
-
-    /** Convenience: get current time as seconds since midnight. */
-    static double getCurrentTimeSeconds();
+    /** Angular speed (radians per second) of one sinusoid. */
+    static double getAngularRate (int term);
 
 private:
-    int curveSeed = 0;
-    float evolutionDepth = 0.5f;
-
     // Prime-ratio periods in seconds (hours * 3600)
-    static constexpr double kPeriods[5] = {
+    static constexpr double kPeriods[kNumTerms] = {
         7.0 * 3600.0,    // 7 hours
         11.0 * 3600.0,   // 11 hours
         13.0 * 3600.0,   // 13 hours
@@ -1,21 +1,39 @@
 #include "GenerativeEngine.h"
-#include "ParameterLayout.h"
+#include <algorithm>
+#include <cmath>
 
 GenerativeEngine::GenerativeEngine()
 {
-    // Initialize voices with unique indices and MIDI channels
+    // Initialize voices with unique indices
     for (int i = 0; i < kMaxVoices; ++i)
-        voices[i].init (i, i + 1);   // Voice 0 → channel 1, etc.
+    {
+        voices[i].init (i, seed);
+        voices[i].setSettings (&voiceSettings);
+    }
+
+    voiceSettings.scale = &scaleQuantizer;
+    voiceSettings.harmony = &harmony;
 
-    // Seed evolution curves with different seeds
-    evolutionDensity.setSeed (1);
-    evolutionVelocity.setSeed (2);
-    evolutionOctave.setSeed (3);
+    // Build the preset melody tables now rather than on the audio thread
+    MarkovMelody::getPresetTable (MarkovMelody::Hymn, 0);
 }
 
-void GenerativeEngine::prepare (double newSampleRate, int /*blockSize*/)
+void GenerativeEngine::prepare (double newSampleRate, int blockSize)
 {
     sampleRate = newSampleRate;
+
+    // Per-voice event storage: a bend every Logline at its shortest (1 ms,
+    // Plumb 0) across the block, plus the note events and a seek at its
+    // start. A host block longer than prepared can still fill a list; its
+    // last slot is kept for the note-off.
+    int minBendInterval = juce::jmax (1, juce::roundToInt (0.001 * sampleRate));
+    voiceEventCapacity = juce::jmax (1, blockSize) / minBendInterval + 32;
+    voiceEventPool.assign (static_cast<size_t> (voiceEventCapacity) * kMaxVoices, DriftEvent());
+
+    for (int i = 0; i < kMaxVoices; ++i)
+        voiceEvents[static_cast<size_t> (i)].setStorage (voiceEventPool.data() + static_cast<size_t> (i) * static_cast<size_t> (voiceEventCapacity),
+                                                         voiceEventCapacity);
+
     reset();
 }
 
@@ -23,54 +41,141 @@ void GenerativeEngine::reset()
 {
     internalBeatPosition = 0.0;
     wasPlaying = false;
+    seekedVoiceCount = 0;
+    wasGenerationEnabled = true;
+
+    // Keys are applied again on the next block, over whatever Heading and
+    // Chart set up
+    appliedKey = 0;
+    appliedDetectedKey = 0;
 
     for (int i = 0; i < kMaxVoices; ++i)
         voices[i].reset();
+
+    harmony.clear();
 }
 
-void GenerativeEngine::updateParameters (juce::AudioProcessorValueTreeState& apvts)
+void GenerativeEngine::updateParameters (const ParameterSnapshot& params, ParameterSnapshot::Mask changed,
+                                         const ModMatrix& modulation)
 {
-    // Read all parameters from APVTS
-    int rootNote = static_cast<int> (apvts.getRawParameterValue (ID::heading)->load());
-    int scaleIdx = static_cast<int> (apvts.getRawParameterValue (ID::chart)->load());
-    activeVoiceCount = static_cast<int> (apvts.getRawParameterValue (ID::crew)->load());
+    using P = ParameterSnapshot;
+
+    // Helm can replace Heading and Chart with the key heard on the sidechain
+    int helm = params.getInt (P::Helm);
+    juce::uint32 detected = helm == 2 ? detectedKey.load (std::memory_order_relaxed) : 0;
+    bool detectedChanged = detected != appliedDetectedKey;
+    appliedDetectedKey = detected;
+
+    if (detected != 0)
+    {
+        if (detectedChanged)
+            scaleQuantizer.setRootAndScale (PitchTracker::getRoot (detected), PitchTracker::getScale (detected));
+    }
+    else if (detectedChanged || (changed & (P::bit (P::Heading) | P::bit (P::Chart))) != 0)
+    {
+        scaleQuantizer.setRootAndScale (params.getInt (P::Heading), params.getInt (P::Chart));
+    }
+
+    // ... or with the key held on the MIDI input: one word per block
+    juce::uint32 key = helm == 1 ? followedKey.load (std::memory_order_relaxed) : 0;
+    bool keyChanged = key != appliedKey;
+
+    if (keyChanged)
+    {
+        scaleQuantizer.setPitchClasses (KeyFollower::getPitchClasses (key), KeyFollower::getRoot (key));
+        appliedKey = key;
+    }
+
+    // Compass plays the loaded tuning instead. It may be replaced at any
+    // time, so it is looked up every block while in use.
+    const ScaleQuantizer::Tuning* tuning = params.getBool (P::Compass) ? loadedTuning.acquire() : nullptr;
+    bool tuningChanged = tuning != scaleQuantizer.getTuning();
+
+    if (tuningChanged)
+        scaleQuantizer.setTuning (tuning);
+
+    if (changed & P::bit (P::Shanty))
+        melodyStyle = params.getInt (P::Shanty);
+
+    // The voices draw from the style's table for this root/scale. A learned
+    // melody may be replaced at any time, so it is looked up every block.
+    // A tuning or a followed key has no scale of its own and uses the
+    // chromatic tables.
+    if (melodyStyle == MarkovMelody::Learned || tuningChanged || keyChanged || detectedChanged
+        || (changed & (P::bit (P::Heading) | P::bit (P::Chart) | P::bit (P::Shanty))) != 0)
+    {
+        bool ownScale = tuning == nullptr && key == 0;
+        auto scale = static_cast<size_t> (ownScale ? scaleQuantizer.getScale() : ScaleQuantizer::Chromatic);
+        auto root = static_cast<size_t> (tuning != nullptr ? 0 : (key != 0 ? KeyFollower::getRoot (key) : scaleQuantizer.getRootNote()));
+        const MarkovMelody::Table* table = nullptr;
+
+        if (melodyStyle == MarkovMelody::Learned)
+        {
+            auto* learned = learnedMelody.acquire();
+            table = learned != nullptr ? &learned->tables[scale][root]
+                                       : &MarkovMelody::getPresetTable (MarkovMelody::Hymn, static_cast<int> (scale));
+        }
+        else if (melodyStyle != MarkovMelody::Drift)
+        {
+            table = &MarkovMelody::getPresetTable (static_cast<MarkovMelody::Style> (melodyStyle), static_cast<int> (scale));
+        }
 
-    paramFlotsam   = apvts.getRawParameterValue (ID::flotsam)->load();
-    paramCurrent   = apvts.getRawParameterValue (ID::current)->load();
-    paramDoldrums  = apvts.getRawParameterValue (ID::doldrums)->load();
-    paramGale      = apvts.getRawParameterValue (ID::gale)->load();
-    paramShallows  = static_cast<int> (apvts.getRawParameterValue (ID::shallows)->load());
-    paramDepths    = static_cast<int> (apvts.getRawParameterValue (ID::depths)->load());
-    paramSargasso  = apvts.getRawParameterValue (ID::sargasso)->load();
-    paramLeeward   = apvts.getRawParameterValue (ID::leeward)->load();
-    paramBerth     = apvts.getRawParameterValue (ID::berth)->load();
-    paramMaelstrom = apvts.getRawParameterValue (ID::maelstrom)->load();
-    generationEnabled = apvts.getRawParameterValue (ID::genEnabled)->load() >= 0.5f;
-    droneMode = apvts.getRawParameterValue (ID::droneMode)->load() >= 0.5f;
+        voiceSettings.melody = table;
+    }
 
-    // Update scale
-    scaleQuantizer.setRootNote (rootNote);
-    scaleQuantizer.setScale (scaleIdx);
+    // Trim 0 leaves the voices independent; at 1 a note may not clash at all
+    if (changed & P::bit (P::Trim))
+    {
+        float trim = params.get (P::Trim);
+        voiceSettings.harmonyTolerance = trim > 0.0f ? juce::roundToInt ((1.0f - trim) * 6.0f) : -1;
+    }
 
-    // Update evolution depth (drone mode forces high evolution for slow breathing)
-    float evoDepth = droneMode ? 0.9f : paramBerth;
-    evolutionDensity.setDepth (evoDepth);
-    evolutionVelocity.setDepth (evoDepth);
-    evolutionOctave.setDepth (evoDepth);
+    if (changed & P::bit (P::Crew))
+        activeVoiceCount = params.getInt (P::Crew);
+
+    if (changed & P::bit (P::GenEnabled))
+        generationEnabled = params.getBool (P::GenEnabled);
+
+    if (changed & P::bit (P::Current))
+        internalBPM = params.get (P::Current);   // Internal BPM from the Current parameter
+
+    if (changed & kVoiceParameterMask)
+    {
+        paramFlotsam   = params.get (P::Flotsam);
+        paramDoldrums  = params.get (P::Doldrums);
+        paramGale      = params.get (P::Gale);
+        paramShallows  = params.getInt (P::Shallows);
+        paramDepths    = params.getInt (P::Depths);
+        paramSargasso  = params.get (P::Sargasso);
+        paramLeeward   = params.get (P::Leeward);
+        paramBerth     = params.get (P::Berth);
+        paramMaelstrom = params.get (P::Maelstrom);
+        paramLogline   = params.get (P::Logline);
+        paramPlumb     = params.get (P::Plumb);
+        droneMode      = params.getBool (P::DroneMode);
+
+        // Update evolution depth (drone mode forces high evolution for slow breathing)
+        evolutionDepth = droneMode ? 0.9f : juce::jlimit (0.0f, 1.0f, paramBerth);
+    }
 
-    // Internal BPM from the Current parameter
-    internalBPM = paramCurrent;
+    // The evolution curves are sampled once per evolution second; recompute
+    // the shared voice settings only when they or a voice parameter changed
+    double evolutionSecond = std::floor (modulation.getEvolutionTime());
 
-    // Update all voice parameters
-    updateVoiceParameters();
+    if ((changed & kVoiceParameterMask) != 0 || evolutionSecond != lastEvolutionSecond)
+    {
+        lastEvolutionSecond = evolutionSecond;
+        updateVoiceParameters (modulation);
+    }
 }
 
-void GenerativeEngine::processBlock (juce::MidiBuffer& midiBuffer, int numSamples,
+void GenerativeEngine::processBlock (DriftEventQueue& events, int numSamples,
                                       juce::AudioPlayHead* playHead)
 {
     // Determine BPM and beat position
     float bpm = internalBPM;
-    bool isPlaying = true;
+    bool hostPlaying = false;
+    double hostPosition = 0.0;
 
     if (playHead != nullptr)
     {
@@ -80,65 +185,256 @@ void GenerativeEngine::processBlock (juce::MidiBuffer& midiBuffer, int numSample
             if (auto bpmOpt = posInfo->getBpm())
                 bpm = static_cast<float> (*bpmOpt);
 
-            isPlaying = posInfo->getIsPlaying();
+            if (auto ppqOpt = posInfo->getPpqPosition())
+            {
+                hostPlaying = posInfo->getIsPlaying() || nonRealtime;
+                hostPosition = *ppqOpt;
+            }
         }
     }
 
     // If host is not playing, use internal clock with the Current (BPM) parameter
     // Always generate when in standalone or when host is stopped
     // (for ambient installations, we always want output)
-    if (! isPlaying)
-    {
+    if (! hostPlaying)
         bpm = internalBPM;
-        isPlaying = true;  // Force playing for continuous generation
-    }
 
-    if (! isPlaying)
-        return;
+    currentBPM = bpm;
+    double beatsPerSample = getBeatsPerSample (bpm);
+    double secondsPerSample = 1.0 / sampleRate;
+
+    // Follow the host playhead: a start, loop or relocation rebuilds the voices
+    bool needsSeek = false;
+
+    if (hostPlaying)
+    {
+        double tolerance = 2.0 * beatsPerSample + 1.0e-9;
+        needsSeek = ! wasPlaying || std::abs (hostPosition - internalBeatPosition) > tolerance;
+        internalBeatPosition = hostPosition;
+    }
+    wasPlaying = hostPlaying;
 
     // If generation just got disabled, silence all voices
     if (! generationEnabled && wasGenerationEnabled)
     {
-        for (int i = 0; i < kMaxVoices; ++i)
+        for (int i = 0; i < seekedVoiceCount; ++i)
         {
             if (voices[i].isNoteActive())
                 voices[i].reset();
         }
     }
+
+    if (generationEnabled && ! wasGenerationEnabled)
+        needsSeek = true;
+
     wasGenerationEnabled = generationEnabled;
 
     if (! generationEnabled)
+    {
+        internalBeatPosition += beatsPerSample * numSamples;
         return;
+    }
 
-    double beatsPerSample = getBeatsPerSample (bpm);
-    double secondsPerSample = 1.0 / sampleRate;
+    int numActive = juce::jmin (activeVoiceCount, kMaxVoices);
+    int previousActive = seekedVoiceCount;
+    int numTouched = juce::jmax (numActive, previousActive);
 
-    // Process each active voice
-    for (int i = 0; i < activeVoiceCount && i < kMaxVoices; ++i)
-    {
-        voices[i].processBlock (midiBuffer, beatsPerSample, numSamples, secondsPerSample);
-    }
+    for (int i = 0; i < numTouched; ++i)
+        voiceEvents[static_cast<size_t> (i)].clear();
 
     // Send note-off for voices that just became inactive
     // (when crew count is reduced)
-    for (int i = activeVoiceCount; i < kMaxVoices; ++i)
+    for (int i = numActive; i < previousActive; ++i)
     {
         if (voices[i].isNoteActive())
-        {
-            // Force a note-off by processing with zero beats
-            juce::MidiBuffer tempBuf;
-            voices[i].processBlock (tempBuf, 0.0, 0, 0.0);
+            voices[i].releaseCurrentNote (voiceEvents[static_cast<size_t> (i)], 0);
+    }
 
-            // If still active, manually send note-off
-            if (voices[i].isNoteActive())
-                voices[i].reset();
-        }
+    if (needsSeek)
+    {
+        seekVoices (internalBeatPosition);
+    }
+    else
+    {
+        // Voices joining the crew start where they would have been
+        for (int i = previousActive; i < numActive; ++i)
+            voices[i].seekTo (voiceEvents[static_cast<size_t> (i)], 0,
+                              internalBeatPosition, beatsToSeconds (internalBeatPosition));
     }
 
+    seekedVoiceCount = numActive;
+
+    // Process each active voice into its own list. A voice only reads the
+    // others through the consonance constraint; then they take turns.
+    if (voiceSettings.harmonyTolerance >= 0)
+    {
+        processVoicesInTimeOrder (numActive, beatsPerSample, numSamples, secondsPerSample);
+    }
+    else
+    {
+        for (int i = 0; i < numActive; ++i)
+            voices[i].processBlock (voiceEvents[static_cast<size_t> (i)], beatsPerSample, numSamples, secondsPerSample);
+    }
+
+    // One k-way merge puts the whole block in time order
+    mergeVoiceEvents (events, numTouched);
+
     // Advance internal clock
     internalBeatPosition += beatsPerSample * numSamples;
 }
 
+void GenerativeEngine::seekTo (double ppqPosition, DriftEventQueue& events)
+{
+    int numTouched = juce::jmax (juce::jmin (activeVoiceCount, kMaxVoices), seekedVoiceCount);
+
+    for (int i = 0; i < numTouched; ++i)
+        voiceEvents[static_cast<size_t> (i)].clear();
+
+    seekVoices (ppqPosition);
+    mergeVoiceEvents (events, numTouched);
+
+    // Already at the position: a playing host there needs no second seek
+    wasPlaying = true;
+}
+
+void GenerativeEngine::seekVoices (double ppqPosition)
+{
+    internalBeatPosition = juce::jmax (0.0, ppqPosition);
+    double timeSeconds = beatsToSeconds (internalBeatPosition);
+
+    int numActive = juce::jmin (activeVoiceCount, kMaxVoices);
+
+    // Everything stops before anything is chased, so the notes chased here
+    // never see the chord from before the seek
+    for (int i = 0; i < juce::jmax (numActive, seekedVoiceCount); ++i)
+        voices[i].releaseCurrentNote (voiceEvents[static_cast<size_t> (i)], 0);
+
+    for (int i = 0; i < numActive; ++i)
+        voices[i].seekTo (voiceEvents[static_cast<size_t> (i)], 0, internalBeatPosition, timeSeconds);
+
+    seekedVoiceCount = numActive;
+}
+
+void GenerativeEngine::processVoicesInTimeOrder (int numVoices, double beatsPerSample, int numSamples,
+                                                 double secondsPerSample)
+{
+    // Each voice runs from one note change to the next, earliest first
+    // (equal samples in voice order), so a new note is checked against
+    // the chord sounding on its sample, whatever the block size
+    auto later = [this] (juce::int16 a, juce::int16 b)
+    {
+        int changeA = nextNoteChange[static_cast<size_t> (a)];
+        int changeB = nextNoteChange[static_cast<size_t> (b)];
+        return changeA != changeB ? changeA > changeB : a > b;
+    };
+
+    // The sample after the voice's next note change, if it is in this block
+    auto schedule = [this, beatsPerSample, numSamples] (int voice)
+    {
+        auto v = static_cast<size_t> (voice);
+        int until = juce::jmax (1, voices[voice].samplesUntilNoteChange (beatsPerSample));
+
+        if (until > numSamples - voicePositions[v])
+            return false;
+
+        nextNoteChange[v] = voicePositions[v] + until;
+        return true;
+    };
+
+    auto* heap = mergeHeap.data();
+    int heapSize = 0;
+
+    for (int i = 0; i < numVoices; ++i)
+    {
+        voices[i].applySettings();
+        voicePositions[static_cast<size_t> (i)] = 0;
+
+        if (schedule (i))
+            heap[heapSize++] = static_cast<juce::int16> (i);
+        else
+            voices[i].process (voiceEvents[static_cast<size_t> (i)], 0, numSamples, beatsPerSample, secondsPerSample);
+    }
+
+    std::make_heap (heap, heap + heapSize, later);
+
+    while (heapSize > 0)
+    {
+        std::pop_heap (heap, heap + heapSize, later);
+        auto voice = heap[heapSize - 1];
+        auto v = static_cast<size_t> (voice);
+
+        voices[voice].process (voiceEvents[v], voicePositions[v], nextNoteChange[v], beatsPerSample, secondsPerSample);
+        voicePositions[v] = nextNoteChange[v];
+
+        if (schedule (voice))
+        {
+            std::push_heap (heap, heap + heapSize, later);
+        }
+        else
+        {
+            voices[voice].process (voiceEvents[v], voicePositions[v], numSamples, beatsPerSample, secondsPerSample);
+            --heapSize;
+        }
+    }
+}
+
+void GenerativeEngine::mergeVoiceEvents (DriftEventQueue& events, int numVoices)
+{
+    // Min-heap of voices keyed by their next event (position, then voice
+    // index, so equal times keep the voice order)
+    auto later = [this] (juce::int16 a, juce::int16 b)
+    {
+        int posA = voiceEvents[static_cast<size_t> (a)][mergeCursor[static_cast<size_t> (a)]].samplePosition;
+        int posB = voiceEvents[static_cast<size_t> (b)][mergeCursor[static_cast<size_t> (b)]].samplePosition;
+        return posA != posB ? posA > posB : a > b;
+    };
+
+    auto* heap = mergeHeap.data();
+    int heapSize = 0;
+
+    for (int i = 0; i < numVoices; ++i)
+    {
+        mergeCursor[static_cast<size_t> (i)] = 0;
+
+        if (! voiceEvents[static_cast<size_t> (i)].isEmpty())
+            heap[heapSize++] = static_cast<juce::int16> (i);
+    }
+
+    std::make_heap (heap, heap + heapSize, later);
+
+    while (heapSize > 0)
+    {
+        std::pop_heap (heap, heap + heapSize, later);
+        auto voice = heap[heapSize - 1];
+
+        auto& cursor = mergeCursor[static_cast<size_t> (voice)];
+        events.add (voiceEvents[static_cast<size_t> (voice)][cursor++]);
+
+        if (cursor < voiceEvents[static_cast<size_t> (voice)].size())
+            std::push_heap (heap, heap + heapSize, later);
+        else
+            --heapSize;
+    }
+}
+
+void GenerativeEngine::setSeed (std::uint64_t newSeed)
+{
+    seed = newSeed;
+
+    for (int i = 0; i < kMaxVoices; ++i)
+        voices[i].init (i, seed);
+}
+
+void GenerativeEngine::setLearnedMelody (std::unique_ptr<MarkovMelody::LearnedTables> tables)
+{
+    learnedMelody.publish (std::move (tables));
+}
+
+void GenerativeEngine::setTuning (std::unique_ptr<ScaleQuantizer::Tuning> tuning)
+{
+    loadedTuning.publish (std::move (tuning));
+}
+
 int GenerativeEngine::getVoiceNote (int index) const
 {
     if (index >= 0 && index < kMaxVoices)
@@ -153,13 +449,17 @@ bool GenerativeEngine::isVoiceActive (int index) const
     return false;
 }
 
-void GenerativeEngine::updateVoiceParameters()
+void GenerativeEngine::updateVoiceParameters (const ModMatrix& modulation)
 {
-    // Get evolution modulation values
-    double timeSeconds = EvolutionCurve::getCurrentTimeSeconds();
-    float evoD = evolutionDensity.evaluate (timeSeconds);    // 0–1
-    float evoV = evolutionVelocity.evaluate (timeSeconds);   // 0–1
-    float evoO = evolutionOctave.evaluate (timeSeconds);     // 0–1
+    // Get evolution modulation values: 0.5 ± half the depth (0–1)
+    auto evolve = [this, &modulation] (ModMatrix::Source curve)
+    {
+        return 0.5f + 0.5f * evolutionDepth * modulation.getSource (curve);
+    };
+
+    float evoD = evolve (ModMatrix::EvolutionA);
+    float evoV = evolve (ModMatrix::EvolutionB);
+    float evoO = evolve (ModMatrix::EvolutionC);
 
     // Modulate parameters with evolution curves
     // Evolution adds ±30% variation to base values
@@ -184,17 +484,22 @@ void GenerativeEngine::updateVoiceParameters()
     float micro     = droneMode ? 25.0f  : paramLeeward;
     float chaos     = droneMode ? 0.08f  : paramMaelstrom;
 
-    for (int i = 0; i < kMaxVoices; ++i)
-    {
-        voices[i].setScaleQuantizer (&scaleQuantizer);
-        voices[i].setNoteDensity (density);
-        voices[i].setLegatoFactor (legato);
-        voices[i].setVelocityRange (velRange);
-        voices[i].setOctaveRange (octLo, octHi);
-        voices[i].setPhaseDrift (drift);
-        voices[i].setMicrotonalDepth (micro);
-        voices[i].setRandomness (chaos);
-    }
+    // One write for the whole swarm (same limits as the old per-voice setters)
+    voiceSettings.beatsPerNote    = 4.0 / static_cast<double> (density);    // Assuming 4/4 time
+    voiceSettings.legato          = juce::jlimit (0.1f, 1.0f, legato);
+    voiceSettings.velocityRange   = juce::jlimit (0.0f, 1.0f, velRange);
+    voiceSettings.octaveMin       = juce::jlimit (2, 6, octLo);
+    voiceSettings.octaveMax       = juce::jlimit (3, 7, octHi);
+    voiceSettings.phaseDrift      = drift;
+    voiceSettings.microtonalCents = micro;
+    voiceSettings.randomness      = juce::jlimit (0.0f, 1.0f, chaos);
+
+    // Detune is checked every Logline ms and only sent when it moved by Plumb cents
+    voiceSettings.bendIntervalSamples = juce::jmax (1, juce::roundToInt (paramLogline * 0.001 * sampleRate));
+    voiceSettings.bendStepCents       = juce::jmax (0.0f, paramPlumb);
+
+    if (voiceSettings.octaveMax <= voiceSettings.octaveMin)
+        voiceSettings.octaveMax = voiceSettings.octaveMin + 1;
 }
 
 double GenerativeEngine::getBeatsPerSample (float bpm) const
@@ -204,3 +509,11 @@ double GenerativeEngine::getBeatsPerSample (float bpm) const
 
     return static_cast<double> (bpm) / (60.0 * sampleRate);
 }
+
+double GenerativeEngine::beatsToSeconds (double beats) const
+{
+    if (currentBPM <= 0.0f)
+        return 0.0;
+
+    return beats * 60.0 / static_cast<double> (currentBPM);
+}
@@ -1,38 +1,99 @@
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_processors/juce_audio_processors.h>
+#include "AtomicSnapshot.h"
 #include "DriftVoice.h"
+#include "MarkovMelody.h"
 #include "ScaleQuantizer.h"
-#include "EvolutionCurve.h"
+#include "ModMatrix.h"
+#include "ParameterSnapshot.h"
+#include "KeyFollower.h"
+#include "PitchTracker.h"
+#include <array>
+#include <atomic>
+#include <vector>
 
 /**
  * GenerativeEngine — Master coordinator for Captain Drift.
  *
- * Owns 8 DriftVoice instances, a ScaleQuantizer, and EvolutionCurves.
- * Reads parameters from the APVTS and distributes them to voices.
+ * Owns a swarm of up to 512 DriftVoice instances and a ScaleQuantizer.
+ * Voice parameters are written once per block into one shared
+ * DriftVoiceSettings. Only the active crew is processed, so the per-block
+ * cost follows the crew size and the number of events.
+ * Reads parameters from the snapshot, shaped by the evolution curves of
+ * the ModMatrix, and distributes them to voices.
  * Manages the internal clock when host transport is not running.
+ *
+ * The generated sequence is a function of (seed, parameters, beat
+ * position). When the host relocates, loops or starts playback, the
+ * voices are rebuilt at the new position with seekTo() instead of
+ * continuing from wherever they were. Under the consonance constraint the
+ * voices take turns from note change to note change, so each new note is
+ * checked against the chord sounding on its sample whatever the block
+ * size, and a seek stops every voice before any note is chased.
  */
 class GenerativeEngine
 {
 public:
-    static constexpr int kMaxVoices = 8;
+    static constexpr int kMaxVoices = DriftEvent::kMaxVoices;
+    static constexpr std::uint64_t kDefaultSeed = 42;
 
     GenerativeEngine();
 
     /** Prepare the engine for playback. */
     void prepare (double sampleRate, int blockSize);
 
+    /** The most events one prepared block can produce; size the
+        DriftEventQueue passed to processBlock() with this. */
+    int getEventCapacity() const noexcept { return voiceEventCapacity * kMaxVoices; }
+
     /** Reset all voices and state. */
     void reset();
 
-    /** Update parameters from APVTS. Call once per processBlock. */
-    void updateParameters (juce::AudioProcessorValueTreeState& apvts);
+    /** Apply the fields of the parameter snapshot that changed, and the
+        evolution curves of the modulation matrix. Call once per processBlock. */
+    void updateParameters (const ParameterSnapshot& params, ParameterSnapshot::Mask changed,
+                           const ModMatrix& modulation);
 
-    /** Generate MIDI events for the current block.
+    /** Generate note events for the current block, in time order.
         Uses host transport if available, otherwise uses internal clock. */
-    void processBlock (juce::MidiBuffer& midiBuffer, int numSamples,
+    void processBlock (DriftEventQueue& events, int numSamples,
                        juce::AudioPlayHead* playHead);
 
+    /** Rebuild every active voice at an absolute beat position. Held notes
+        are released, and notes that would still sound there are restarted. */
+    void seekTo (double ppqPosition, DriftEventQueue& events);
+
+    /** Beat position the next block starts at. */
+    double getBeatPosition() const noexcept { return internalBeatPosition; }
+
+    /** Select the random sequence. Takes effect from the next seek or reset. */
+    void setSeed (std::uint64_t newSeed);
+    std::uint64_t getSeed() const noexcept { return seed; }
+
+    /** Hand over the transitions of a learned melody, used by the Learned
+        style (message thread). */
+    void setLearnedMelody (std::unique_ptr<MarkovMelody::LearnedTables> tables);
+
+    /** Hand over a compiled tuning, played while Compass is on (message thread). */
+    void setTuning (std::unique_ptr<ScaleQuantizer::Tuning> tuning);
+
+    /** Key held on the MIDI input (a KeyFollower word), played while Helm
+        follows it. Any thread; one atomic store. */
+    void setFollowedKey (juce::uint32 key) noexcept { followedKey.store (key, std::memory_order_relaxed); }
+
+    /** Key detected on the sidechain (a PitchTracker word), played while Helm
+        follows it. Any thread; one atomic store. */
+    void setDetectedKey (juce::uint32 key) noexcept { detectedKey.store (key, std::memory_order_relaxed); }
+
+    /** The keys last handed over, for the journal. */
+    juce::uint32 getFollowedKey() const noexcept { return followedKey.load (std::memory_order_relaxed); }
+    juce::uint32 getDetectedKey() const noexcept { return detectedKey.load (std::memory_order_relaxed); }
+
+    /** Offline renders take the host's beat position whenever it has one,
+        even if the transport reports stopped. */
+    void setNonRealtime (bool shouldBeNonRealtime) noexcept { nonRealtime = shouldBeNonRealtime; }
+
     /** Query voice activity (safe for GUI polling). */
     int getVoiceNote (int index) const;
     bool isVoiceActive (int index) const;
@@ -42,27 +103,67 @@ private:
 
     // Voices
     DriftVoice voices[kMaxVoices];
+    DriftVoiceSettings voiceSettings;
+
+    // Per-voice event lists (storage sized in prepare) and merge state
+    std::vector<DriftEvent> voiceEventPool;
+    int voiceEventCapacity = 0;
+    std::array<DriftEventList, kMaxVoices> voiceEvents;
+    std::array<juce::int16, kMaxVoices> mergeHeap;
+    std::array<int, kMaxVoices> mergeCursor;
+
+    // Under the consonance constraint: where each voice has got to in the
+    // block, and the sample after its next note change
+    std::array<int, kMaxVoices> voicePositions;
+    std::array<int, kMaxVoices> nextNoteChange;
+
     int activeVoiceCount = 4;
+    int seekedVoiceCount = 0;            // Voices already placed at the current position
+    std::uint64_t seed = kDefaultSeed;
 
-    // Scale
+    // Scale, and the tuning handed over by the message thread
     ScaleQuantizer scaleQuantizer;
+    AtomicSnapshot<ScaleQuantizer::Tuning> loadedTuning;
+
+    // Key from the MIDI input, and the one the quantizer is using
+    std::atomic<juce::uint32> followedKey { 0 };
+    juce::uint32 appliedKey = 0;
 
-    // Evolution curves (one per modulation target)
-    EvolutionCurve evolutionDensity;     // Modulates note density
-    EvolutionCurve evolutionVelocity;    // Modulates velocity
-    EvolutionCurve evolutionOctave;      // Modulates octave spread
+    // Key detected on the sidechain, and the one the quantizer is using
+    std::atomic<juce::uint32> detectedKey { 0 };
+    juce::uint32 appliedDetectedKey = 0;
+
+    // Notes sounding across the swarm, for the consonance constraint
+    HarmonyState harmony;
+
+    // Melody style, and the learned transitions handed over by the message thread
+    int melodyStyle = MarkovMelody::Drift;
+    AtomicSnapshot<MarkovMelody::LearnedTables> learnedMelody;
+
+    // How far the evolution curves reach (Berth, or fixed in drone mode)
+    float evolutionDepth = 0.5f;
 
     // Internal clock (used when host transport is not running)
     double internalBeatPosition = 0.0;
     float internalBPM = 60.0f;
-    bool wasPlaying = false;
+    float currentBPM = 60.0f;
+    bool wasPlaying = false;             // Host transport was driving the position
+    bool nonRealtime = false;
     bool generationEnabled = true;
     bool wasGenerationEnabled = true;
     bool droneMode = false;
 
+    // Snapshot fields that feed the shared voice settings
+    static constexpr ParameterSnapshot::Mask kVoiceParameterMask =
+        ParameterSnapshot::bit (ParameterSnapshot::Flotsam)   | ParameterSnapshot::bit (ParameterSnapshot::Doldrums)
+      | ParameterSnapshot::bit (ParameterSnapshot::Gale)      | ParameterSnapshot::bit (ParameterSnapshot::Shallows)
+      | ParameterSnapshot::bit (ParameterSnapshot::Depths)    | ParameterSnapshot::bit (ParameterSnapshot::Sargasso)
+      | ParameterSnapshot::bit (ParameterSnapshot::Leeward)   | ParameterSnapshot::bit (ParameterSnapshot::Berth)
+      | ParameterSnapshot::bit (ParameterSnapshot::Maelstrom) | ParameterSnapshot::bit (ParameterSnapshot::DroneMode)
+      | ParameterSnapshot::bit (ParameterSnapshot::Logline)   | ParameterSnapshot::bit (ParameterSnapshot::Plumb);
+
     // Cached parameters
     float paramFlotsam = 1.0f;
-    float paramCurrent = 60.0f;
     float paramDoldrums = 0.7f;
     float paramGale = 0.5f;
     int   paramShallows = 3;
@@ -71,8 +172,15 @@ private:
     float paramLeeward = 15.0f;
     float paramBerth = 0.5f;
     float paramMaelstrom = 0.2f;
+    float paramLogline = 5.0f;
+    float paramPlumb = 0.5f;
+    double lastEvolutionSecond = -1.0;
 
     // Internal methods
-    void updateVoiceParameters();
+    void updateVoiceParameters (const ModMatrix& modulation);
+    void seekVoices (double ppqPosition);
+    void processVoicesInTimeOrder (int numVoices, double beatsPerSample, int numSamples, double secondsPerSample);
+    void mergeVoiceEvents (DriftEventQueue& events, int numVoices);
     double getBeatsPerSample (float bpm) const;
+    double beatsToSeconds (double beats) const;
 };
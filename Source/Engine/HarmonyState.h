@@ -0,0 +1,116 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+
+/**
+ * HarmonyState — The notes the whole swarm is sounding, as bit sets.
+ *
+ * Keeps a 128-bit mask of sounding MIDI notes and a 12-bit pitch-class
+ * set, each backed by per-note counts so voices sharing a note can come
+ * and go in any order. A candidate note is scored against the chord with
+ * a few mask operations and popcounts: interval classes from the
+ * precomputed consonance tables, plus any notes within a whole tone of it
+ * (a cluster). No loop over the other voices is needed.
+ */
+class HarmonyState
+{
+public:
+    void clear() noexcept
+    {
+        noteCounts.fill (0);
+        pitchClassCounts.fill (0);
+        notes[0] = notes[1] = 0;
+        pitchClasses = 0;
+    }
+
+    void addNote (int note) noexcept
+    {
+        if (! juce::isPositiveAndBelow (note, 128))
+            return;
+
+        if (noteCounts[static_cast<size_t> (note)]++ == 0)
+            notes[note >> 6] |= juce::uint64 (1) << (note & 63);
+
+        if (pitchClassCounts[static_cast<size_t> (note % 12)]++ == 0)
+            pitchClasses |= 1u << (note % 12);
+    }
+
+    void removeNote (int note) noexcept
+    {
+        if (! juce::isPositiveAndBelow (note, 128) || noteCounts[static_cast<size_t> (note)] == 0)
+            return;
+
+        if (--noteCounts[static_cast<size_t> (note)] == 0)
+            notes[note >> 6] &= ~(juce::uint64 (1) << (note & 63));
+
+        if (--pitchClassCounts[static_cast<size_t> (note % 12)] == 0)
+            pitchClasses &= ~(1u << (note % 12));
+    }
+
+    /** How much a note would clash with the chord (0 = consonant with all of it).
+        Semitones and major sevenths count 2, whole tones, minor sevenths and
+        tritones 1, and every other note within a whole tone 2 more. */
+    int getDissonance (int note) const noexcept
+    {
+        if (! juce::isPositiveAndBelow (note, 128))
+            return 0;
+
+        auto pc = static_cast<size_t> (note % 12);
+        int harsh = juce::countNumberOfBits (pitchClasses & kHarsh[pc]);
+        int mild = juce::countNumberOfBits (pitchClasses & kMild[pc]);
+
+        int self = noteCounts[static_cast<size_t> (note)] > 0 ? 1 : 0;
+        int cluster = countNotes (note - 2, note + 2) - self;
+
+        return 2 * harsh + mild + 2 * cluster;
+    }
+
+    juce::uint32 getPitchClasses() const noexcept   { return pitchClasses; }
+
+private:
+    static constexpr juce::uint32 rotate (juce::uint32 intervals, int pitchClass)
+    {
+        return ((intervals << pitchClass) | (intervals >> (12 - pitchClass))) & 0xfffu;
+    }
+
+    // Pitch classes that clash with each pitch class
+    static constexpr std::array<juce::uint32, 12> makeTable (juce::uint32 intervals)
+    {
+        std::array<juce::uint32, 12> t {};
+        for (int pc = 0; pc < 12; ++pc)
+            t[static_cast<size_t> (pc)] = rotate (intervals, pc);
+        return t;
+    }
+
+    static const std::array<juce::uint32, 12> kHarsh;   // Semitone, major seventh
+    static const std::array<juce::uint32, 12> kMild;    // Whole tone, minor seventh, tritone
+
+    // Bits low..high of one 64-bit word (0 <= low <= high <= 63)
+    static juce::uint64 bitRange (int low, int high) noexcept
+    {
+        return (~juce::uint64 (0) >> (63 - (high - low))) << low;
+    }
+
+    int countNotes (int low, int high) const noexcept
+    {
+        low = juce::jmax (0, low);
+        high = juce::jmin (127, high);
+        int count = 0;
+
+        if (low <= juce::jmin (high, 63))
+            count += juce::countNumberOfBits (notes[0] & bitRange (low, juce::jmin (high, 63)));
+
+        if (high >= 64 && juce::jmax (low, 64) <= high)
+            count += juce::countNumberOfBits (notes[1] & bitRange (juce::jmax (low, 64) - 64, high - 64));
+
+        return count;
+    }
+
+    std::array<juce::uint16, 128> noteCounts {};
+    std::array<juce::uint16, 12> pitchClassCounts {};
+    juce::uint64 notes[2] = {};
+    juce::uint32 pitchClasses = 0;
+};
+
+inline constexpr std::array<juce::uint32, 12> HarmonyState::kHarsh = HarmonyState::makeTable ((1u << 1) | (1u << 11));
+inline constexpr std::array<juce::uint32, 12> HarmonyState::kMild  = HarmonyState::makeTable ((1u << 2) | (1u << 10) | (1u << 6));
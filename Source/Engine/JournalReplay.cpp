@@ -0,0 +1,533 @@
+#include "JournalReplay.h"
+#include "EnsembleChorus.h"
+#include "GenerativeEngine.h"
+#include "MidiEventWriter.h"
+#include "PadSynth.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    using P = ParameterSnapshot;
+    using J = DecisionJournal;
+
+    constexpr size_t kMagicBytes = 4;
+
+    // Bounds-checked little-endian reads; a read past the end fails the rest
+    class Reader
+    {
+    public:
+        Reader (const juce::uint8* bytes, size_t numBytes) noexcept : data (bytes), size (numBytes) {}
+
+        bool ok() const noexcept            { return ! failed; }
+        bool isExhausted() const noexcept   { return position >= size; }
+        size_t getPosition() const noexcept { return position; }
+
+        juce::uint8 readByte() noexcept
+        {
+            if (position >= size)
+            {
+                failed = true;
+                return 0;
+            }
+
+            return data[position++];
+        }
+
+        juce::uint64 readVarint() noexcept
+        {
+            juce::uint64 value = 0;
+
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                auto byte = readByte();
+                value |= static_cast<juce::uint64> (byte & 0x7f) << shift;
+
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+
+            failed = true;
+            return 0;
+        }
+
+        juce::uint32 readUint32() noexcept
+        {
+            juce::uint32 value = 0;
+            for (int i = 0; i < 4; ++i)
+                value |= static_cast<juce::uint32> (readByte()) << (8 * i);
+            return value;
+        }
+
+        juce::uint64 readUint64() noexcept
+        {
+            juce::uint64 value = 0;
+            for (int i = 0; i < 8; ++i)
+                value |= static_cast<juce::uint64> (readByte()) << (8 * i);
+            return value;
+        }
+
+        float readFloat() noexcept
+        {
+            auto bits = readUint32();
+            float value;
+            std::memcpy (&value, &bits, sizeof (value));
+            return value;
+        }
+
+        double readDouble() noexcept
+        {
+            auto bits = readUint64();
+            double value;
+            std::memcpy (&value, &bits, sizeof (value));
+            return value;
+        }
+
+    private:
+        const juce::uint8* data;
+        size_t size;
+        size_t position = 0;
+        bool failed = false;
+    };
+
+    // One decoded group: each record type appears at most once per block
+    struct Records
+    {
+        juce::int64 delta = 0;
+
+        bool hasStart = false;
+        double sampleRate = 0.0;
+        int maxBlockSize = 0;
+        std::uint64_t seed = 0;
+
+        int blockSize = 0;              // 0 = unchanged
+
+        P::Mask parameterFields = 0;
+        std::array<float, P::NumParameters> parameters {};
+
+        bool hasTransport = false;
+        juce::uint8 transportFlags = 0;
+        double ppq = 0.0, bpm = 0.0;
+
+        bool hasKeys = false;
+        juce::uint32 followedKey = 0, detectedKey = 0;
+
+        bool hasClock = false;
+        double wallClock = 0.0;
+
+        bool hasMorph = false;
+        bool release = false;
+        double morphSeconds = 0.0;
+        PresetMorph::Preset preset;
+
+        bool hasRoutes = false;
+        juce::Array<ModMatrix::Route> routes;
+
+        P::Mask remoteFields = 0, heldFields = 0;
+        std::array<float, P::NumParameters> remote {}, held {};
+    };
+
+    P::Mask readFields (Reader& in, std::array<float, P::NumParameters>& values)
+    {
+        auto fields = in.readUint32();
+
+        for (int i = 0; i < P::NumParameters; ++i)
+            if (fields & P::bit (static_cast<P::Index> (i)))
+                values[static_cast<size_t> (i)] = in.readFloat();
+
+        return fields;
+    }
+
+    bool readGroup (Reader& in, Records& r)
+    {
+        r.hasStart = r.hasTransport = r.hasKeys = r.hasClock = r.hasMorph = r.hasRoutes = false;
+        r.blockSize = 0;
+        r.parameterFields = r.remoteFields = r.heldFields = 0;
+        r.delta = static_cast<juce::int64> (in.readVarint());
+
+        for (;;)
+        {
+            auto type = in.readByte();
+            if (! in.ok())
+                return false;
+
+            switch (type)
+            {
+                case J::End:
+                    return true;
+
+                case J::Start:
+                    r.hasStart = true;
+                    r.sampleRate = in.readDouble();
+                    r.maxBlockSize = static_cast<int> (in.readVarint());
+                    r.seed = in.readUint64();
+                    break;
+
+                case J::BlockSize:
+                    r.blockSize = static_cast<int> (in.readVarint());
+                    break;
+
+                case J::Parameters:
+                    r.parameterFields = readFields (in, r.parameters);
+                    break;
+
+                case J::Transport:
+                    r.hasTransport = true;
+                    r.transportFlags = in.readByte();
+                    r.ppq = in.readDouble();
+                    r.bpm = in.readDouble();
+                    break;
+
+                case J::Keys:
+                    r.hasKeys = true;
+                    r.followedKey = in.readUint32();
+                    r.detectedKey = in.readUint32();
+                    break;
+
+                case J::Clock:
+                    r.hasClock = true;
+                    r.wallClock = in.readDouble();
+                    break;
+
+                case J::Morph:
+                    r.hasMorph = true;
+                    r.release = in.readByte() != 0;
+                    r.morphSeconds = in.readDouble();
+                    r.preset.fields = readFields (in, r.preset.values);
+                    break;
+
+                case J::Routes:
+                {
+                    r.hasRoutes = true;
+                    r.routes.clear();
+
+                    int numRoutes = in.readByte();
+                    for (int i = 0; i < numRoutes; ++i)
+                    {
+                        ModMatrix::Route route;
+                        route.source = in.readByte();
+                        route.target = in.readByte();
+                        route.depth = in.readFloat();
+                        r.routes.add (route);
+                    }
+                    break;
+                }
+
+                case J::Remote:
+                    r.remoteFields = readFields (in, r.remote);
+                    break;
+
+                case J::Held:
+                    r.heldFields = readFields (in, r.held);
+                    break;
+
+                default:
+                    return false;        // Torn, or written by a newer version
+            }
+        }
+    }
+
+    // The host transport as journaled
+    class ReplayPlayHead : public juce::AudioPlayHead
+    {
+    public:
+        juce::Optional<PositionInfo> getPosition() const override
+        {
+            PositionInfo info;
+            info.setIsPlaying ((flags & J::IsPlaying) != 0);
+
+            if (flags & J::HasTempo)
+                info.setBpm (bpm);
+
+            if (flags & J::HasPosition)
+                info.setPpqPosition (ppq);
+
+            return info;
+        }
+
+        void advance (int numSamples, double sampleRate) noexcept
+        {
+            ppq = J::advancePosition (ppq, bpm, (flags & J::IsPlaying) != 0, numSamples, sampleRate);
+        }
+
+        juce::uint8 flags = 0;
+        double ppq = 0.0;
+        double bpm = 0.0;
+    };
+}
+
+// The processor's generator, as it runs with Lookout off
+class JournalReplay::Chain
+{
+public:
+    explicit Chain (juce::AudioProcessorValueTreeState& apvts) : parameters (apvts), morph (apvts) {}
+
+    ParameterSnapshot parameters;
+    PresetMorph morph;
+    ModMatrix modMatrix;
+    GenerativeEngine engine;
+    DriftEventQueue events;
+    PadSynth padSynth;
+    EnsembleChorus ensemble;
+    MidiEventWriter midiWriter;
+    ReplayPlayHead playHead;
+};
+
+JournalReplay::JournalReplay (juce::AudioProcessorValueTreeState& apvts)
+    : state (apvts)
+{
+}
+
+JournalReplay::~JournalReplay() = default;
+
+void JournalReplay::setLearnedMelody (std::unique_ptr<MarkovMelody::LearnedTables> tables)
+{
+    learnedMelody = std::move (tables);
+}
+
+void JournalReplay::setTuning (std::unique_ptr<ScaleQuantizer::Tuning> newTuning)
+{
+    tuning = std::move (newTuning);
+}
+
+bool JournalReplay::load (const juce::File& file)
+{
+    juce::MemoryBlock data;
+
+    if (! file.loadFileAsData (data) || data.getSize() < kMagicBytes
+        || std::memcmp (data.getData(), "KDJ1", kMagicBytes) != 0)
+        return false;
+
+    journal = std::move (data);
+    segments.clear();
+
+    Reader in (static_cast<const juce::uint8*> (journal.getData()) + kMagicBytes, journal.getSize() - kMagicBytes);
+    Records r;
+    juce::int64 samples = 0;       // Before the current group's block
+    int blockSize = 0;
+    bool timed = false;
+
+    while (! in.isExhausted())
+    {
+        auto groupStart = in.getPosition() + kMagicBytes;
+
+        if (! readGroup (in, r))
+            break;
+
+        if (r.hasStart)
+        {
+            // The previous segment is only usable if its first block gave a time
+            if (! segments.empty() && ! timed)
+                segments.pop_back();
+
+            Segment segment;
+            segment.sampleRate = r.sampleRate;
+            segment.maxBlockSize = r.maxBlockSize;
+            segment.seed = r.seed;
+            segment.begin = groupStart;
+            segments.push_back (segment);
+
+            samples = 0;
+            blockSize = 0;
+            timed = r.hasClock && r.delta == 0;
+
+            if (timed)
+                segments.back().startTime = r.wallClock;
+        }
+        else if (segments.empty())
+        {
+            continue;
+        }
+        else
+        {
+            samples += r.delta * blockSize;
+        }
+
+        if (r.blockSize > 0)
+            blockSize = r.blockSize;
+
+        auto& segment = segments.back();
+        segment.numSamples = samples + blockSize;
+        segment.end = in.getPosition() + kMagicBytes;
+    }
+
+    if (! segments.empty() && ! timed)
+        segments.pop_back();
+
+    return true;
+}
+
+bool JournalReplay::render (double unixSeconds, int numSamples, juce::AudioBuffer<float>& audio, juce::MidiBuffer& midi)
+{
+    audio.setSize (2, numSamples);
+    audio.clear();
+    midi.clear();
+
+    // The latest segment holding the time (a clock set back can overlap an earlier one)
+    const Segment* found = nullptr;
+
+    for (const auto& segment : segments)
+        if (unixSeconds >= segment.startTime && unixSeconds < segment.getEndTime())
+            found = &segment;
+
+    if (found == nullptr)
+        return false;
+
+    auto startSample = static_cast<juce::int64> (std::floor ((unixSeconds - found->startTime) * found->sampleRate));
+    renderSegment (*found, startSample, numSamples, audio, midi);
+    return true;
+}
+
+void JournalReplay::renderSegment (const Segment& segment, juce::int64 startSample, int numSamples,
+                                   juce::AudioBuffer<float>& audio, juce::MidiBuffer& midi)
+{
+    auto chain = std::make_unique<Chain> (state);
+    auto& c = *chain;
+
+    // The state a segment starts from: freshly prepared, at the journaled time
+    c.modMatrix.setWallClock (segment.startTime);
+    c.engine.setSeed (segment.seed);
+
+    if (learnedMelody != nullptr)
+        c.engine.setLearnedMelody (std::make_unique<MarkovMelody::LearnedTables> (*learnedMelody));
+
+    if (tuning != nullptr)
+        c.engine.setTuning (std::make_unique<ScaleQuantizer::Tuning> (*tuning));
+
+    c.engine.prepare (segment.sampleRate, segment.maxBlockSize);
+    c.events.prepare (c.engine.getEventCapacity());
+    c.modMatrix.prepare (segment.sampleRate);
+    c.morph.prepare (segment.sampleRate);
+    c.padSynth.prepare (segment.sampleRate, segment.maxBlockSize);
+    c.ensemble.prepare (segment.sampleRate, segment.maxBlockSize);
+    c.midiWriter.prepare (segment.sampleRate);
+
+    juce::AudioBuffer<float> buffer (2, juce::jmax (1, segment.maxBlockSize));
+    juce::MidiBuffer blockMidi;
+    blockMidi.ensureSize (MidiEventWriter::kReserveBytes);
+
+    std::array<float, P::NumParameters> host {}, remote {}, held {};
+    int blockSize = 0;
+
+    Reader in (static_cast<const juce::uint8*> (journal.getData()) + segment.begin, segment.end - segment.begin);
+    Records r;
+    bool groupsLeft = readGroup (in, r);
+    juce::int64 nextGroupBlock = r.delta;
+
+    auto endSample = juce::jmin (startSample + numSamples, segment.numSamples);
+
+    for (juce::int64 block = 0, position = 0; position < endSample; ++block)
+    {
+        P::Mask remoteFields = 0, heldFields = 0;
+
+        // The block's records, before it is processed
+        if (groupsLeft && block == nextGroupBlock)
+        {
+            if (r.blockSize > 0)
+                blockSize = r.blockSize;
+
+            for (int i = 0; i < P::NumParameters; ++i)
+                if (r.parameterFields & P::bit (static_cast<P::Index> (i)))
+                    host[static_cast<size_t> (i)] = r.parameters[static_cast<size_t> (i)];
+
+            if (r.hasTransport)
+            {
+                c.playHead.flags = r.transportFlags;
+                c.playHead.ppq = r.ppq;
+                c.playHead.bpm = r.bpm;
+            }
+
+            if (r.hasKeys)
+            {
+                c.engine.setFollowedKey (r.followedKey);
+                c.engine.setDetectedKey (r.detectedKey);
+            }
+
+            if (r.hasClock)
+                c.modMatrix.setWallClock (r.wallClock);
+
+            if (r.hasMorph)
+                c.morph.replay (r.preset, r.morphSeconds, r.release);
+
+            if (r.hasRoutes)
+                c.modMatrix.setRoutes (r.routes);
+
+            // Applied once the block's host values are in
+            remoteFields = r.remoteFields;
+            heldFields = r.heldFields;
+            remote = r.remote;
+            held = r.held;
+
+            groupsLeft = readGroup (in, r);
+            nextGroupBlock += r.delta;
+        }
+
+        if (blockSize <= 0)
+            break;
+
+        int n = blockSize;
+
+        // The pad renders the whole buffer; this only reallocates for a larger block
+        if (n != buffer.getNumSamples())
+            buffer.setSize (2, n, false, false, true);
+
+        buffer.clear();
+
+        // processBlock's order, from the snapshot to the follower input
+        auto changed = c.parameters.update (host);
+
+        for (int i = 0; i < P::NumParameters; ++i)
+            if (heldFields & P::bit (static_cast<P::Index> (i)))
+                changed |= c.parameters.setOverride (static_cast<P::Index> (i), held[static_cast<size_t> (i)]);
+
+        changed |= c.morph.process (c.parameters, n, 0);
+
+        for (int i = 0; i < P::NumParameters; ++i)
+            if (remoteFields & P::bit (static_cast<P::Index> (i)))
+                changed |= c.parameters.setOverride (static_cast<P::Index> (i), remote[static_cast<size_t> (i)]);
+
+        changed |= c.modMatrix.process (c.parameters, changed, n);
+
+        c.engine.updateParameters (c.parameters, changed, c.modMatrix);
+
+        if (changed != 0)
+        {
+            c.padSynth.setDroneMode (c.parameters.getBool (P::DroneMode));
+            c.ensemble.setMix (c.parameters.get (P::Wake));
+            c.midiWriter.setMaxBendRate (c.parameters.get (P::Bunting));
+        }
+
+        c.events.clear();
+        c.engine.processBlock (c.events, n, &c.playHead);
+
+        c.padSynth.setModulation (c.modMatrix.getSynthTarget (ModMatrix::PadCutoff),
+                                  c.modMatrix.getSynthTarget (ModMatrix::PadDetune));
+        c.padSynth.processBlock (buffer, c.events);
+        c.ensemble.process (buffer);
+
+        blockMidi.clear();
+        if (c.parameters.getBool (P::Semaphore))
+            c.midiWriter.write (c.events, blockMidi, n);
+
+        c.modMatrix.setFollowerInput (buffer.getMagnitude (0, n));
+
+        // Keep the part inside the range
+        auto from = juce::jmax (position, startSample);
+        auto to = juce::jmin (position + n, endSample);
+
+        if (from < to)
+        {
+            auto count = static_cast<int> (to - from);
+
+            for (int ch = 0; ch < 2; ++ch)
+                audio.copyFrom (ch, static_cast<int> (from - startSample), buffer, ch, static_cast<int> (from - position), count);
+
+            for (const auto m : blockMidi)
+                if (m.samplePosition >= from - position && m.samplePosition < to - position)
+                    midi.addEvent (m.data, m.numBytes, static_cast<int> (position + m.samplePosition - startSample));
+        }
+
+        position += n;
+        c.playHead.advance (n, segment.sampleRate);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "DecisionJournal.h"
+#include "MarkovMelody.h"
+#include "ScaleQuantizer.h"
+#include <memory>
+#include <vector>
+
+/**
+ * JournalReplay — Regenerates the notes and audio of any moment a DecisionJournal covers.
+ *
+ * Loading reads the whole journal (it is small) and indexes its segments by
+ * the Unix time of their first sample, which is the wall clock their first
+ * block's clock restart read. Rendering builds a fresh generator chain, the
+ * one the processor runs with Lookout off, and feeds it the journaled
+ * inputs block by block from the start of the segment, keeping only what
+ * falls inside the requested range. Nothing waits on a clock, so this runs
+ * as fast as the generator can.
+ *
+ * The output is the pad and its ensemble, and the MIDI 1.0 notes when
+ * Semaphore was on. It is bit-exact for sessions generated with Lookout off
+ * and the same melody and tuning loaded. Not for the audio thread.
+ */
+class JournalReplay
+{
+public:
+    /** A continuous stretch of the journal, from one generation restart. */
+    struct Segment
+    {
+        double startTime = 0.0;          // Unix seconds of its first sample
+        double sampleRate = 44100.0;
+        int maxBlockSize = 0;
+        std::uint64_t seed = 0;
+        juce::int64 numSamples = 0;      // Up to its last recorded block
+        size_t begin = 0, end = 0;       // Its groups in the journal
+
+        double getEndTime() const noexcept { return startTime + numSamples / sampleRate; }
+    };
+
+    /** Uses the plugin's parameter ranges; the state is not touched. */
+    explicit JournalReplay (juce::AudioProcessorValueTreeState& apvts);
+    ~JournalReplay();
+
+    /** Read a journal. Returns false if the file is not one; a torn last
+        group is ignored. */
+    bool load (const juce::File& file);
+
+    const std::vector<Segment>& getSegments() const noexcept { return segments; }
+
+    /** The melody and tuning to generate with (copied into each render). */
+    void setLearnedMelody (std::unique_ptr<MarkovMelody::LearnedTables> tables);
+    void setTuning (std::unique_ptr<ScaleQuantizer::Tuning> tuning);
+
+    /** Regenerate numSamples from the given Unix time into a stereo buffer
+        and its MIDI, both resized or cleared first. Samples past the end of
+        the segment stay silent. Returns false if no segment holds the time. */
+    bool render (double unixSeconds, int numSamples, juce::AudioBuffer<float>& audio, juce::MidiBuffer& midi);
+
+private:
+    class Chain;
+
+    juce::AudioProcessorValueTreeState& state;
+    juce::MemoryBlock journal;
+    std::vector<Segment> segments;
+    std::unique_ptr<MarkovMelody::LearnedTables> learnedMelody;
+    std::unique_ptr<ScaleQuantizer::Tuning> tuning;
+
+    void renderSegment (const Segment& segment, juce::int64 startSample, int numSamples,
+                        juce::AudioBuffer<float>& audio, juce::MidiBuffer& midi);
+
+    JUCE_DECLARE_NON_COPYABLE (JournalReplay)
+};
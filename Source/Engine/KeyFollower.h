@@ -0,0 +1,91 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+
+/**
+ * KeyFollower — The key a performer is holding down on the MIDI input.
+ *
+ * Counts the held notes across all channels and reduces them to one word:
+ * the pitch classes in bits 0–11 and the pitch class of the lowest held
+ * note (the root) in bits 12–15. The word fits a single atomic, so the
+ * generators pick up a new key with one load per block. The key changes
+ * only when a note is pressed; letting go of some or all of a chord leaves
+ * it in place, so the drift keeps the key it was given.
+ */
+class KeyFollower
+{
+public:
+    static constexpr juce::uint32 kPitchClassMask = 0xfffu;
+
+    static juce::uint32 getPitchClasses (juce::uint32 key) noexcept  { return key & kPitchClassMask; }
+    static int getRoot (juce::uint32 key) noexcept                   { return static_cast<int> ((key >> 12) & 0xfu); }
+
+    void reset() noexcept
+    {
+        held.fill (0);
+        numHeld = 0;
+        key = 0;
+    }
+
+    /** Track the note-ons and note-offs of a block of input. */
+    void process (const juce::MidiBuffer& midi) noexcept
+    {
+        bool pressed = false;
+
+        for (const auto metadata : midi)
+        {
+            auto m = metadata.getMessage();
+
+            if (m.isNoteOn())
+            {
+                ++held[static_cast<size_t> (m.getNoteNumber())];
+                ++numHeld;
+                pressed = true;
+            }
+            else if (m.isNoteOff())
+            {
+                auto& count = held[static_cast<size_t> (m.getNoteNumber())];
+                if (count > 0)
+                {
+                    --count;
+                    --numHeld;
+                }
+            }
+            else if (m.isAllNotesOff() || m.isAllSoundOff())
+            {
+                held.fill (0);
+                numHeld = 0;
+            }
+        }
+
+        // Only a new key changes the chord; letting go leaves it in place
+        if (pressed && numHeld > 0)
+            key = makeKey();
+    }
+
+    /** The held key as a word, or 0 if nothing has been played yet. */
+    juce::uint32 getKey() const noexcept { return key; }
+
+private:
+    juce::uint32 makeKey() const noexcept
+    {
+        juce::uint32 pitchClasses = 0;
+        int lowest = -1;
+
+        for (int n = 0; n < 128; ++n)
+        {
+            if (held[static_cast<size_t> (n)] > 0)
+            {
+                pitchClasses |= 1u << (n % 12);
+                if (lowest < 0)
+                    lowest = n;
+            }
+        }
+
+        return pitchClasses | (static_cast<juce::uint32> (lowest % 12) << 12);
+    }
+
+    std::array<juce::uint8, 128> held {};
+    int numHeld = 0;
+    juce::uint32 key = 0;
+};
@@ -0,0 +1,512 @@
+#include "LookaheadGenerator.h"
+#include <cmath>
+#include <limits>
+
+LookaheadGenerator::LookaheadGenerator (juce::AudioProcessorValueTreeState& apvts)
+    : juce::Thread ("CaptainDrift lookahead"),
+      params (apvts)
+{
+    eventBuffer.resize (static_cast<size_t> (kFifoSize));
+
+    for (auto& n : soundingNotes)
+        n.store (-1, std::memory_order_relaxed);
+}
+
+LookaheadGenerator::~LookaheadGenerator()
+{
+    stopThread (2000);
+}
+
+void LookaheadGenerator::prepare (double newSampleRate, int newBlockSize)
+{
+    stopThread (2000);
+
+    sampleRate = newSampleRate;
+    blockSize = juce::jmax (1, newBlockSize);
+
+    engine.prepare (sampleRate, blockSize);
+    blockEvents.prepare (engine.getEventCapacity());
+    modulation.prepare (sampleRate);
+    params.invalidate();
+
+    eventFifo.reset();
+    anchorFifo.reset();
+    anchor = {};
+    anchorUnsent = false;
+    workerTime = 0;
+    historyCount = 0;
+
+    audioTime = 0;
+    audioPosition.store (0, std::memory_order_relaxed);
+    lookaheadSamples.store (lookaheadBlocks * blockSize, std::memory_order_relaxed);
+
+    // The synths are reset with us: nothing is sounding. A running
+    // lookahead starts again from the new position.
+    for (auto& n : soundingNotes)
+        n.store (-1, std::memory_order_relaxed);
+
+    startPending = running;
+    startBeat = 0.0;
+
+    startThread (juce::Thread::Priority::high);
+}
+
+void LookaheadGenerator::setRoutes (const juce::Array<ModMatrix::Route>& routes)
+{
+    modulation.setRoutes (routes);
+}
+
+void LookaheadGenerator::setLearnedMelody (std::unique_ptr<MarkovMelody::LearnedTables> tables)
+{
+    engine.setLearnedMelody (std::move (tables));
+}
+
+void LookaheadGenerator::setTuning (std::unique_ptr<ScaleQuantizer::Tuning> tuning)
+{
+    engine.setTuning (std::move (tuning));
+}
+
+//==============================================================================
+// Audio thread
+
+void LookaheadGenerator::start (const GenerativeEngine& takeOverFrom)
+{
+    running = true;
+    startPending = true;
+    startBeat = takeOverFrom.getBeatPosition();
+
+    // The first seek is reconciled against these, so held notes carry on
+    for (int v = 0; v < kMaxVoices; ++v)
+        soundingNotes[static_cast<size_t> (v)].store (takeOverFrom.isVoiceActive (v) ? takeOverFrom.getVoiceNote (v) : -1,
+                                                      std::memory_order_relaxed);
+}
+
+void LookaheadGenerator::stop (DriftEventQueue& events)
+{
+    for (int v = 0; v < kMaxVoices; ++v)
+    {
+        int note = soundingNotes[static_cast<size_t> (v)].load (std::memory_order_relaxed);
+
+        if (note >= 0)
+        {
+            DriftEvent off;
+            off.type = DriftEvent::NoteOff;
+            off.note = static_cast<juce::uint8> (note);
+            off.voice = static_cast<juce::int16> (v);
+            emit (events, off, 0);
+        }
+    }
+
+    running = false;
+
+    // Idle the worker and drop whatever it had generated
+    cutoffs[generation % kNumAnchors] = audioTime;
+    ++generation;
+
+    Anchor idle;
+    idle.generation = generation;
+    idle.time = audioTime;
+    sendAnchor (idle);
+
+    eventFifo.finishedRead (eventFifo.getNumReady());
+}
+
+void LookaheadGenerator::setLookaheadBlocks (int numBlocks) noexcept
+{
+    lookaheadBlocks = juce::jmax (1, numBlocks);
+    lookaheadSamples.store (lookaheadBlocks * blockSize, std::memory_order_relaxed);
+}
+
+void LookaheadGenerator::processBlock (DriftEventQueue& events, int numSamples,
+                                       juce::AudioPlayHead* playHead, ParameterSnapshot::Mask hostChanged)
+{
+    if (anchorUnsent)
+        sendAnchor (unsentAnchor);
+
+    // Host transport, read the way GenerativeEngine reads it
+    bool playing = false;
+    double ppq = 0.0;
+    double bpm = lastBpm > 0.0 ? lastBpm : 120.0;
+
+    if (playHead != nullptr)
+    {
+        auto posInfo = playHead->getPosition();
+        if (posInfo.hasValue())
+        {
+            if (auto bpmOpt = posInfo->getBpm())
+                bpm = *bpmOpt;
+
+            if (auto ppqOpt = posInfo->getPpqPosition())
+            {
+                playing = posInfo->getIsPlaying();
+                ppq = *ppqOpt;
+            }
+        }
+    }
+
+    double beatsPerSample = bpm / (60.0 * sampleRate);
+
+    // A start, stop, jump or tempo change invalidates everything from this
+    // block on. A parameter change keeps this block and regenerates from the next.
+    bool relocated = playing && (std::abs (ppq - expectedPpq) > 2.0 * beatsPerSample + 1.0e-9 || bpm != lastBpm);
+
+    if (startPending || playing != lastPlaying || relocated)
+        openGeneration (audioTime, playing, playing ? ppq : (startPending ? startBeat : -1.0), bpm);
+    else if ((hostChanged & kGeneratorMask) != 0)
+        openGeneration (audioTime + numSamples, playing, playing ? ppq + numSamples * beatsPerSample : -1.0, bpm);
+
+    startPending = false;
+    lastPlaying = playing;
+    lastBpm = bpm;
+    expectedPpq = ppq + numSamples * beatsPerSample;
+
+    drain (events, numSamples);
+
+    audioTime += numSamples;
+    audioPosition.store (audioTime, std::memory_order_release);
+}
+
+int LookaheadGenerator::getVoiceNote (int index) const noexcept
+{
+    if (juce::isPositiveAndBelow (index, kMaxVoices))
+        return soundingNotes[static_cast<size_t> (index)].load (std::memory_order_relaxed);
+    return -1;
+}
+
+void LookaheadGenerator::openGeneration (juce::int64 anchorTime, bool playing, double beat, double bpm)
+{
+    // The current generation ends at the anchor; the new one runs open-ended
+    cutoffs[generation % kNumAnchors] = anchorTime;
+    ++generation;
+    cutoffs[generation % kNumAnchors] = std::numeric_limits<juce::int64>::max();
+
+    Anchor a;
+    a.generation = generation;
+    a.time = anchorTime;
+    a.active = true;
+    a.playing = playing;
+    a.beat = beat;
+    a.bpm = bpm;
+    sendAnchor (a);
+}
+
+void LookaheadGenerator::sendAnchor (const Anchor& a)
+{
+    int start1, size1, start2, size2;
+    anchorFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+    {
+        // Worker stalled: keep the latest anchor and retry next block
+        unsentAnchor = a;
+        anchorUnsent = true;
+        return;
+    }
+
+    anchorBuffer[static_cast<size_t> (start1)] = a;
+    anchorFifo.finishedWrite (1);
+    anchorUnsent = false;
+}
+
+bool LookaheadGenerator::isLive (const TimedEvent& te) const noexcept
+{
+    if (generation - te.generation >= static_cast<juce::uint32> (kNumAnchors))
+        return false;
+
+    return te.time < cutoffs[te.generation % kNumAnchors];
+}
+
+void LookaheadGenerator::drain (DriftEventQueue& events, int numSamples)
+{
+    auto blockEnd = audioTime + numSamples;
+
+    for (;;)
+    {
+        int start1, size1, start2, size2;
+        eventFifo.prepareToRead (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+            break;
+
+        const auto te = eventBuffer[static_cast<size_t> (start1)];
+        bool live = isLive (te);
+
+        // Future events stay queued for their block
+        if (live && te.time >= blockEnd)
+            break;
+
+        eventFifo.finishedRead (1);
+
+        if (! live)
+            continue;
+
+        // Late events (the worker fell behind) play at the start of the block
+        int position = static_cast<int> (juce::jlimit<juce::int64> (0, numSamples - 1, te.time - audioTime));
+
+        if (te.flags & kChaseEnd)
+            finishChase (events, te.generation, position);
+        else if (te.flags & kChase)
+            chase (events, te, position);
+        else
+            emit (events, te.event, position);
+    }
+}
+
+void LookaheadGenerator::emit (DriftEventQueue& events, DriftEvent e, int position)
+{
+    e.samplePosition = position;
+
+    if (! events.add (e))
+        return;
+
+    auto& sounding = soundingNotes[static_cast<size_t> (e.voice)];
+
+    if (e.type == DriftEvent::NoteOn)
+        sounding.store (e.note, std::memory_order_relaxed);
+    else if (e.type == DriftEvent::NoteOff && sounding.load (std::memory_order_relaxed) == e.note)
+        sounding.store (-1, std::memory_order_relaxed);
+}
+
+void LookaheadGenerator::chase (DriftEventQueue& events, const TimedEvent& te, int position)
+{
+    if (chaseGeneration != te.generation)
+    {
+        chased.fill (false);
+        chaseGeneration = te.generation;
+    }
+
+    const auto& e = te.event;
+    auto voice = static_cast<size_t> (e.voice);
+
+    switch (e.type)
+    {
+        case DriftEvent::NoteOff:
+            break;   // The worker letting go of notes from its own future
+
+        case DriftEvent::NoteOn:
+        {
+            chased[voice] = true;
+            int sounding = soundingNotes[voice].load (std::memory_order_relaxed);
+
+            // Still the right note: keep it sounding instead of restarting it
+            if (sounding == e.note)
+                break;
+
+            if (sounding >= 0)
+            {
+                DriftEvent off;
+                off.type = DriftEvent::NoteOff;
+                off.note = static_cast<juce::uint8> (sounding);
+                off.voice = e.voice;
+                emit (events, off, position);
+            }
+
+            emit (events, e, position);
+            break;
+        }
+
+        case DriftEvent::Bend:
+            emit (events, e, position);
+            break;
+    }
+}
+
+void LookaheadGenerator::finishChase (DriftEventQueue& events, juce::uint32 chaseGen, int position)
+{
+    // No chased notes at all for this generation
+    if (chaseGeneration != chaseGen)
+    {
+        chased.fill (false);
+        chaseGeneration = chaseGen;
+    }
+
+    // Whatever the seek didn't restart shouldn't be sounding at the anchor
+    for (int v = 0; v < kMaxVoices; ++v)
+    {
+        int note = soundingNotes[static_cast<size_t> (v)].load (std::memory_order_relaxed);
+
+        if (note >= 0 && ! chased[static_cast<size_t> (v)])
+        {
+            DriftEvent off;
+            off.type = DriftEvent::NoteOff;
+            off.note = static_cast<juce::uint8> (note);
+            off.voice = static_cast<juce::int16> (v);
+            emit (events, off, position);
+        }
+    }
+}
+
+//==============================================================================
+// Worker thread
+
+juce::Optional<juce::AudioPlayHead::PositionInfo> LookaheadGenerator::PredictedPlayHead::getPosition() const
+{
+    PositionInfo info;
+    info.setIsPlaying (true);
+    info.setBpm (bpm);
+    info.setPpqPosition (ppq);
+    return info;
+}
+
+void LookaheadGenerator::run()
+{
+    while (! threadShouldExit())
+    {
+        if (pullAnchor() && anchor.active)
+            restart();
+
+        bool ahead = workerTime >= audioPosition.load (std::memory_order_acquire)
+                                   + lookaheadSamples.load (std::memory_order_relaxed);
+
+        if (! anchor.active || ahead)
+        {
+            wait (1);
+            continue;
+        }
+
+        generateBlock();
+    }
+}
+
+bool LookaheadGenerator::pullAnchor()
+{
+    int start1, size1, start2, size2;
+    anchorFifo.prepareToRead (anchorFifo.getNumReady(), start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+        return false;
+
+    // Only the latest anchor matters
+    anchor = size2 > 0 ? anchorBuffer[static_cast<size_t> (start2 + size2 - 1)]
+                       : anchorBuffer[static_cast<size_t> (start1 + size1 - 1)];
+
+    anchorFifo.finishedRead (size1 + size2);
+    return true;
+}
+
+void LookaheadGenerator::restart()
+{
+    double beat = anchor.beat >= 0.0 ? anchor.beat : beatAt (anchor.time);
+
+    // Regenerating must not run the evolution curves ahead
+    if (workerTime > anchor.time)
+        modulation.rewindEvolution (static_cast<int> (juce::jmin<juce::int64> (workerTime - anchor.time,
+                                                                              std::numeric_limits<int>::max())));
+
+    workerTime = anchor.time;
+    historyCount = 0;
+
+    updateParameters (0);
+
+    blockEvents.clear();
+    engine.seekTo (beat, blockEvents);
+
+    if (! push (blockEvents, workerTime, kChase))
+        return;
+
+    TimedEvent marker;
+    marker.time = workerTime;
+    marker.generation = anchor.generation;
+    marker.flags = kChaseEnd;
+    pushOne (marker);
+}
+
+bool LookaheadGenerator::generateBlock()
+{
+    updateParameters (blockSize);
+
+    predictedPlayHead.bpm = anchor.bpm;
+    predictedPlayHead.ppq = anchor.beat + static_cast<double> (workerTime - anchor.time) * anchor.bpm / (60.0 * sampleRate);
+
+    double beatStart = engine.getBeatPosition();
+
+    blockEvents.clear();
+    engine.processBlock (blockEvents, blockSize, anchor.playing ? &predictedPlayHead : nullptr);
+
+    if (! push (blockEvents, workerTime, 0))
+        return false;
+
+    auto& entry = history[static_cast<size_t> (historyCount % kHistorySize)];
+    entry.time = workerTime;
+    entry.beatStart = beatStart;
+    entry.beatEnd = engine.getBeatPosition();
+    ++historyCount;
+
+    workerTime += blockSize;
+    return true;
+}
+
+void LookaheadGenerator::updateParameters (int numSamples)
+{
+    modulation.setFollowerInput (followerLevel.load (std::memory_order_relaxed));
+
+    auto changed = params.update();
+
+    if (presetMorph != nullptr)
+        changed |= presetMorph->process (params, numSamples, presetReader);
+
+    changed |= modulation.process (params, changed, numSamples);
+    engine.updateParameters (params, changed, modulation);
+}
+
+bool LookaheadGenerator::push (const DriftEventQueue& events, juce::int64 blockTime, juce::uint8 flags)
+{
+    TimedEvent te;
+    te.generation = anchor.generation;
+    te.flags = flags;
+
+    for (const auto& e : events)
+    {
+        te.time = blockTime + e.samplePosition;
+        te.event = e;
+
+        if (! pushOne (te))
+            return false;
+    }
+
+    return true;
+}
+
+bool LookaheadGenerator::pushOne (const TimedEvent& te)
+{
+    for (;;)
+    {
+        int start1, size1, start2, size2;
+        eventFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 > 0)
+        {
+            eventBuffer[static_cast<size_t> (start1)] = te;
+            eventFifo.finishedWrite (1);
+            return true;
+        }
+
+        // Full: wait for the audio thread, unless the work is obsolete
+        if (threadShouldExit() || anchorFifo.getNumReady() > 0)
+            return false;
+
+        wait (1);
+    }
+}
+
+double LookaheadGenerator::beatAt (juce::int64 time) const
+{
+    if (historyCount == 0)
+        return engine.getBeatPosition();
+
+    int first = juce::jmax (0, historyCount - kHistorySize);
+
+    for (int i = historyCount - 1; i >= first; --i)
+    {
+        const auto& entry = history[static_cast<size_t> (i % kHistorySize)];
+
+        if (time >= entry.time)
+        {
+            // Within (or, for the newest block, past) this block: interpolate
+            double fraction = static_cast<double> (time - entry.time) / blockSize;
+            return entry.beatStart + (entry.beatEnd - entry.beatStart) * fraction;
+        }
+    }
+
+    return history[static_cast<size_t> (first % kHistorySize)].beatStart;
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "GenerativeEngine.h"
+#include "ModMatrix.h"
+#include "ParameterSnapshot.h"
+#include "PresetMorph.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+/**
+ * LookaheadGenerator — Runs a GenerativeEngine ahead of the playhead on a worker thread.
+ *
+ * The worker owns its own engine, parameter snapshot and modulation matrix
+ * and keeps generating until it is a set number of samples past the audio
+ * thread. Its events carry absolute sample times and go through a lock-free
+ * single-producer/single-consumer FIFO; the audio thread only drains the
+ * events that fall inside its block.
+ *
+ * The audio thread stays in charge of the timeline. When the host starts,
+ * stops, relocates or changes tempo, or a generator parameter changes, it
+ * opens a new generation with an anchor time. Events of older generations
+ * from the anchor on are dropped, and the worker seeks its engine to the
+ * anchor and regenerates from there. The notes chased by that seek are
+ * reconciled with the notes actually sounding, so a note that is still
+ * right keeps playing instead of being restarted.
+ */
+class LookaheadGenerator : private juce::Thread
+{
+public:
+    explicit LookaheadGenerator (juce::AudioProcessorValueTreeState& apvts);
+    ~LookaheadGenerator() override;
+
+    /** Stop the worker, prepare everything and start it again. Not for the audio thread. */
+    void prepare (double sampleRate, int blockSize);
+
+    /** Give the worker's modulation matrix new routes (message thread). */
+    void setRoutes (const juce::Array<ModMatrix::Route>& routes);
+
+    /** Let the worker's modulation matrix read a data series (before the worker starts). */
+    void setDataSeries (DataSeries* series, int readerIndex) noexcept { modulation.setDataSeries (series, readerIndex); }
+
+    /** Let the worker's snapshot follow preset morphs (before the worker starts). */
+    void setPresetMorph (PresetMorph* morph, int readerIndex) noexcept
+    {
+        presetMorph = morph;
+        presetReader = readerIndex;
+    }
+
+    /** Give the worker's engine a learned melody (message thread). */
+    void setLearnedMelody (std::unique_ptr<MarkovMelody::LearnedTables> tables);
+
+    /** Give the worker's engine a compiled tuning (message thread). */
+    void setTuning (std::unique_ptr<ScaleQuantizer::Tuning> tuning);
+
+    /** Give the worker's engine the key held on the MIDI input (audio thread). */
+    void setFollowedKey (juce::uint32 key) noexcept { engine.setFollowedKey (key); }
+
+    /** Give the worker's engine the key detected on the sidechain (audio thread). */
+    void setDetectedKey (juce::uint32 key) noexcept { engine.setDetectedKey (key); }
+
+    //==============================================================================
+    // Audio thread
+
+    /** Start generating ahead, taking over the notes the given engine is holding. */
+    void start (const GenerativeEngine& takeOverFrom);
+
+    /** Stop, and release every note still sounding. */
+    void stop (DriftEventQueue& events);
+
+    bool isRunning() const noexcept { return running; }
+
+    /** How many host blocks the worker may run ahead. */
+    void setLookaheadBlocks (int numBlocks) noexcept;
+
+    /** Fill the block's events from the FIFO. hostChanged is the mask of
+        parameters changed by the host or the editor this block. */
+    void processBlock (DriftEventQueue& events, int numSamples,
+                       juce::AudioPlayHead* playHead, ParameterSnapshot::Mask hostChanged);
+
+    /** Level for the worker's envelope follower. */
+    void setFollowerInput (float level) noexcept { followerLevel.store (level, std::memory_order_relaxed); }
+
+    /** Note sounding on a voice at the playhead, or -1 (safe for GUI polling). */
+    int getVoiceNote (int index) const noexcept;
+
+private:
+    static constexpr int kMaxVoices = DriftEvent::kMaxVoices;
+    static constexpr int kFifoSize = 1 << 16;
+    static constexpr int kNumAnchors = 16;
+    static constexpr int kHistorySize = 64;         // Blocks of beat history on the worker
+
+    // Snapshot fields that change what the engine generates (the generator
+    // block of the enum, everything before Cargo)
+    static constexpr ParameterSnapshot::Mask kGeneratorMask =
+        ParameterSnapshot::bit (ParameterSnapshot::Cargo) - 1;
+
+    enum Flags : juce::uint8
+    {
+        kChase    = 1,    // Emitted by the seek at an anchor
+        kChaseEnd = 2     // Marker: the seek's events are complete
+    };
+
+    struct TimedEvent
+    {
+        juce::int64 time = 0;
+        juce::uint32 generation = 0;
+        juce::uint8 flags = 0;
+        DriftEvent event;
+    };
+
+    struct Anchor
+    {
+        juce::uint32 generation = 0;
+        juce::int64 time = 0;
+        bool active = false;        // False: stop generating
+        bool playing = false;       // Host transport is running
+        double beat = -1.0;         // Position at the anchor; -1 = continue the worker's clock
+        double bpm = 120.0;
+    };
+
+    /** Play head the worker's engine sees: the host transport extrapolated from the anchor. */
+    class PredictedPlayHead : public juce::AudioPlayHead
+    {
+    public:
+        juce::Optional<PositionInfo> getPosition() const override;
+
+        double ppq = 0.0;
+        double bpm = 120.0;
+    };
+
+    // Shared
+    juce::AbstractFifo eventFifo { kFifoSize };
+    std::vector<TimedEvent> eventBuffer;
+    juce::AbstractFifo anchorFifo { kNumAnchors };
+    std::array<Anchor, kNumAnchors> anchorBuffer;
+    std::atomic<juce::int64> audioPosition { 0 };
+    std::atomic<int> lookaheadSamples { 0 };
+    std::atomic<float> followerLevel { 0.0f };
+
+    double sampleRate = 44100.0;
+    int blockSize = 512;
+    int lookaheadBlocks = 1;
+
+    // Audio thread
+    bool running = false;
+    bool startPending = false;
+    double startBeat = 0.0;
+    juce::int64 audioTime = 0;
+    juce::uint32 generation = 0;
+    std::array<juce::int64, kNumAnchors> cutoffs {};     // Per generation: events from here on are stale
+    Anchor unsentAnchor;
+    bool anchorUnsent = false;
+    bool lastPlaying = false;
+    double lastBpm = 0.0;
+    double expectedPpq = 0.0;
+    std::array<std::atomic<int>, kMaxVoices> soundingNotes;
+    std::array<bool, kMaxVoices> chased {};
+    juce::uint32 chaseGeneration = 0;
+
+    // Worker thread
+    ParameterSnapshot params;
+    PresetMorph* presetMorph = nullptr;
+    int presetReader = 0;
+    ModMatrix modulation;
+    GenerativeEngine engine;
+    DriftEventQueue blockEvents;
+    PredictedPlayHead predictedPlayHead;
+    Anchor anchor;
+    juce::int64 workerTime = 0;
+
+    struct HistoryEntry { juce::int64 time = 0; double beatStart = 0.0, beatEnd = 0.0; };
+    std::array<HistoryEntry, kHistorySize> history;
+    int historyCount = 0;
+
+    // Audio thread
+    void openGeneration (juce::int64 anchorTime, bool playing, double beat, double bpm);
+    void sendAnchor (const Anchor& a);
+    void drain (DriftEventQueue& events, int numSamples);
+    void emit (DriftEventQueue& events, DriftEvent e, int position);
+    void chase (DriftEventQueue& events, const TimedEvent& te, int position);
+    void finishChase (DriftEventQueue& events, juce::uint32 chaseGen, int position);
+    bool isLive (const TimedEvent& te) const noexcept;
+
+    // Worker thread
+    void run() override;
+    bool pullAnchor();
+    void restart();
+    bool generateBlock();
+    void updateParameters (int numSamples);
+    bool push (const DriftEventQueue& events, juce::int64 blockTime, juce::uint8 flags);
+    bool pushOne (const TimedEvent& te);
+    double beatAt (juce::int64 time) const;
+
+    JUCE_DECLARE_NON_COPYABLE (LookaheadGenerator)
+};
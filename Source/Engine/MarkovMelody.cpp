@@ -0,0 +1,268 @@
+#include "MarkovMelody.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr int kStepIndex (int step) { return step + MarkovMelody::kMaxStep; }
+
+    // Weights of a preset style for a note of a degree class, in a scale
+    // with numClasses degrees per octave
+    MarkovMelody::Weights presetWeights (MarkovMelody::Style style, int degreeClass, int numClasses)
+    {
+        MarkovMelody::Weights w {};
+        auto add = [&w] (int step, float weight)
+        {
+            if (std::abs (step) <= MarkovMelody::kMaxStep)
+                w[static_cast<size_t> (kStepIndex (step))] += weight;
+        };
+
+        // Degree classes roughly a fifth and a fourth above the root
+        int fifth = (numClasses * 4 + 3) / 7;
+        int fourth = (numClasses * 3 + 3) / 7;
+
+        switch (style)
+        {
+            case MarkovMelody::Reel:
+                add (0, 0.5f);
+                add (-1, 2.0f);  add (1, 2.0f);
+                add (-2, 5.0f);  add (2, 5.0f);
+                add (-3, 1.0f);  add (3, 1.0f);
+                add (-4, 2.0f);  add (4, 2.0f);
+                add (-numClasses, 0.5f);  add (numClasses, 0.5f);
+
+                // Fall back to the root from the fifth, climb from the root
+                if (degreeClass == fifth)   add (-fifth, 3.0f);
+                if (degreeClass == 0)       add (fifth, 2.0f);
+                break;
+
+            case MarkovMelody::Lament:
+                add (0, 1.0f);
+                add (-1, 6.0f);  add (1, 1.5f);
+                add (-2, 2.0f);  add (2, 2.0f);
+                add (3, 1.5f);   add (4, 1.0f);
+
+                // After the descent reaches the root, leap back up
+                if (degreeClass == 0)
+                {
+                    add (fourth, 3.0f);
+                    add (fifth, 3.0f);
+                }
+                break;
+
+            case MarkovMelody::Hymn:
+            default:
+                add (0, 1.5f);
+                add (-1, 6.0f);  add (1, 6.0f);
+                add (-2, 3.0f);  add (2, 3.0f);
+                add (-3, 1.0f);  add (3, 1.0f);
+                add (-4, 0.5f);  add (4, 0.5f);
+
+                // Leading tone resolves up, the fourth leans down to the third
+                if (degreeClass == numClasses - 1)  add (1, 12.0f);
+                if (degreeClass == fourth)          add (-1, 4.0f);
+                break;
+        }
+
+        return w;
+    }
+
+    struct PresetTables
+    {
+        // Hymn, Reel and Lament for every scale
+        std::array<std::array<MarkovMelody::Table, ScaleQuantizer::NumScales>, 3> tables;
+
+        PresetTables()
+        {
+            ScaleQuantizer quantizer;
+
+            for (int scale = 0; scale < ScaleQuantizer::NumScales; ++scale)
+            {
+                quantizer.setScale (scale);
+                int numClasses = quantizer.getNotesPerOctave();
+
+                for (int s = 0; s < 3; ++s)
+                {
+                    auto style = static_cast<MarkovMelody::Style> (MarkovMelody::Hymn + s);
+                    auto& table = tables[static_cast<size_t> (s)][static_cast<size_t> (scale)];
+
+                    for (int c = 0; c < MarkovMelody::kMaxClasses; ++c)
+                        table.rows[static_cast<size_t> (c)] = MarkovMelody::makeRow (presetWeights (style, c % numClasses, numClasses));
+                }
+            }
+        }
+    };
+
+    const PresetTables& getPresets()
+    {
+        static const PresetTables presets;
+        return presets;
+    }
+}
+
+const MarkovMelody::Table& MarkovMelody::getPresetTable (Style style, int scale) noexcept
+{
+    // Anything but a preset style gets Hymn
+    int s = (style >= Hymn && style <= Lament) ? style - Hymn : 0;
+    return getPresets().tables[static_cast<size_t> (s)][static_cast<size_t> (juce::jlimit (0, (int) ScaleQuantizer::NumScales - 1, scale))];
+}
+
+MarkovMelody::Row MarkovMelody::makeRow (const Weights& weights) noexcept
+{
+    Row row;
+
+    float total = 0.0f;
+    for (float w : weights)
+        total += juce::jmax (0.0f, w);
+
+    if (total <= 0.0f)
+    {
+        for (int k = 0; k < kNumSteps; ++k)
+        {
+            row.threshold[static_cast<size_t> (k)] = 0;
+            row.alias[static_cast<size_t> (k)] = static_cast<juce::uint8> (kStepIndex (0));
+        }
+        return row;
+    }
+
+    // Scale so the average column holds exactly 1, then pair every column
+    // below 1 with one above it
+    std::array<double, kNumSteps> p {};
+    std::array<int, kNumSteps> small {}, large {};
+    int numSmall = 0, numLarge = 0;
+
+    for (int k = 0; k < kNumSteps; ++k)
+    {
+        p[static_cast<size_t> (k)] = juce::jmax (0.0f, weights[static_cast<size_t> (k)]) * kNumSteps / static_cast<double> (total);
+
+        if (p[static_cast<size_t> (k)] < 1.0)
+            small[static_cast<size_t> (numSmall++)] = k;
+        else
+            large[static_cast<size_t> (numLarge++)] = k;
+    }
+
+    auto toThreshold = [] (double probability)
+    {
+        return static_cast<juce::uint32> (juce::jlimit (0.0, 4294967295.0, probability * 4294967296.0));
+    };
+
+    while (numSmall > 0 && numLarge > 0)
+    {
+        int s = small[static_cast<size_t> (--numSmall)];
+        int l = large[static_cast<size_t> (numLarge - 1)];
+
+        row.threshold[static_cast<size_t> (s)] = toThreshold (p[static_cast<size_t> (s)]);
+        row.alias[static_cast<size_t> (s)] = static_cast<juce::uint8> (l);
+
+        p[static_cast<size_t> (l)] -= 1.0 - p[static_cast<size_t> (s)];
+
+        if (p[static_cast<size_t> (l)] < 1.0)
+        {
+            --numLarge;
+            small[static_cast<size_t> (numSmall++)] = l;
+        }
+    }
+
+    // What is left holds (up to rounding) exactly 1: always keep it
+    for (int i = 0; i < numLarge; ++i)
+    {
+        auto k = static_cast<size_t> (large[static_cast<size_t> (i)]);
+        row.threshold[k] = 0xffffffffu;
+        row.alias[k] = static_cast<juce::uint8> (k);
+    }
+
+    for (int i = 0; i < numSmall; ++i)
+    {
+        auto k = static_cast<size_t> (small[static_cast<size_t> (i)]);
+        row.threshold[k] = 0xffffffffu;
+        row.alias[k] = static_cast<juce::uint8> (k);
+    }
+
+    return row;
+}
+
+std::unique_ptr<MarkovMelody::LearnedTables> MarkovMelody::learn (const juce::MidiFile& file)
+{
+    std::vector<std::vector<int>> melodies;
+
+    for (int t = 0; t < file.getNumTracks(); ++t)
+    {
+        const auto* track = file.getTrack (t);
+        if (track == nullptr)
+            continue;
+
+        // One note per onset: the top voice of a chord carries the line
+        std::vector<int> melody;
+        double lastTime = -1.0;
+
+        for (int i = 0; i < track->getNumEvents(); ++i)
+        {
+            const auto& m = track->getEventPointer (i)->message;
+            if (! m.isNoteOn())
+                continue;
+
+            if (! melody.empty() && m.getTimeStamp() == lastTime)
+                melody.back() = juce::jmax (melody.back(), m.getNoteNumber());
+            else
+                melody.push_back (m.getNoteNumber());
+
+            lastTime = m.getTimeStamp();
+        }
+
+        if (melody.size() > 1)
+            melodies.push_back (std::move (melody));
+    }
+
+    return learn (melodies);
+}
+
+std::unique_ptr<MarkovMelody::LearnedTables> MarkovMelody::learn (const std::vector<std::vector<int>>& melodies)
+{
+    auto learned = std::make_unique<LearnedTables>();
+    bool anySteps = false;
+    ScaleQuantizer quantizer;
+
+    for (int scale = 0; scale < ScaleQuantizer::NumScales; ++scale)
+    {
+        for (int root = 0; root < 12; ++root)
+        {
+            quantizer.setRootAndScale (root, scale);
+            int numClasses = quantizer.getNotesPerOctave();
+
+            std::array<Weights, kMaxClasses> counts {};
+            std::array<bool, kMaxClasses> seen {};
+
+            for (const auto& melody : melodies)
+            {
+                for (size_t i = 1; i < melody.size(); ++i)
+                {
+                    int from = quantizer.getNearestDegree (melody[i - 1]);
+                    int step = quantizer.getNearestDegree (melody[i]) - from;
+
+                    // Leaps past the table are left out rather than folded in
+                    if (std::abs (step) > kMaxStep)
+                        continue;
+
+                    auto c = static_cast<size_t> (quantizer.getDegreeClass (from));
+                    counts[c][static_cast<size_t> (kStepIndex (step))] += 1.0f;
+                    seen[c] = true;
+                    anySteps = true;
+                }
+            }
+
+            // Classes the melody never visits follow the Hymn preset
+            auto& table = learned->tables[static_cast<size_t> (scale)][static_cast<size_t> (root)];
+            const auto& fallback = getPresetTable (Hymn, scale);
+
+            for (int c = 0; c < kMaxClasses; ++c)
+            {
+                auto k = static_cast<size_t> (c % numClasses);
+                table.rows[static_cast<size_t> (c)] = seen[k] ? makeRow (counts[k]) : fallback.rows[static_cast<size_t> (c)];
+            }
+        }
+    }
+
+    if (! anySteps)
+        return nullptr;
+
+    return learned;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "ScaleQuantizer.h"
+#include <array>
+#include <memory>
+#include <vector>
+
+/**
+ * MarkovMelody — Note transitions drawn from a matrix over scale degrees.
+ *
+ * A state is the degree class of the current note (0 = the root, up to
+ * one octave of degrees); an outcome is a step of up to ±kMaxStep
+ * degrees. Every row of the matrix is stored as a Walker alias table, so
+ * a transition is one 64-bit random value, one multiply and one compare,
+ * however many states and steps there are.
+ *
+ * The preset styles are built once for every scale. A melody learned
+ * from a MIDI file is quantized to every root/scale on the message
+ * thread and handed over as LearnedTables; the audio thread only ever
+ * selects a table.
+ */
+class MarkovMelody
+{
+public:
+    enum Style
+    {
+        Drift = 0,      // No matrix: DriftVoice's bounded random walk
+        Hymn,           // Mostly stepwise, leading tone resolves up
+        Reel,           // Arpeggios: thirds and fifths
+        Lament,         // Falling steps, rising leaps
+        Learned,        // Learned from a MIDI file (Hymn until one is loaded)
+        NumStyles
+    };
+
+    static constexpr int kMaxStep = 7;
+    static constexpr int kNumSteps = 2 * kMaxStep + 1;
+    static constexpr int kMaxClasses = 12;
+
+    /** Relative weights of the steps -kMaxStep .. +kMaxStep. */
+    using Weights = std::array<float, kNumSteps>;
+
+    /** One row as an alias table: column k keeps its own step with
+        probability threshold[k] / 2^32, and gives alias[k] otherwise. */
+    struct Row
+    {
+        std::array<juce::uint32, kNumSteps> threshold {};
+        std::array<juce::uint8, kNumSteps> alias {};
+    };
+
+    /** A matrix for one scale: a row per degree class. */
+    struct Table
+    {
+        std::array<Row, kMaxClasses> rows;
+    };
+
+    /** A learned matrix for every root/scale. */
+    struct LearnedTables
+    {
+        std::array<std::array<Table, 12>, ScaleQuantizer::NumScales> tables;
+    };
+
+    /** Matrix of a preset style (Hymn, Reel or Lament) for a scale. The
+        presets are built on the first call. */
+    static const Table& getPresetTable (Style style, int scale) noexcept;
+
+    /** Learn the transitions of every track of a MIDI file. Returns nullptr
+        if the file has no melodic steps. Not for the audio thread. */
+    static std::unique_ptr<LearnedTables> learn (const juce::MidiFile& file);
+
+    /** Learn from melodies given as MIDI note sequences. */
+    static std::unique_ptr<LearnedTables> learn (const std::vector<std::vector<int>>& melodies);
+
+    /** Step in degrees from a note of the given degree class, for a uniform
+        64-bit random value. */
+    static int drawStep (const Table& table, int degreeClass, std::uint64_t random) noexcept
+    {
+        const auto& row = table.rows[static_cast<size_t> (degreeClass)];
+        auto column = static_cast<size_t> (((random >> 32) * kNumSteps) >> 32);
+        bool keep = static_cast<juce::uint32> (random) < row.threshold[column];
+        return (keep ? static_cast<int> (column) : row.alias[column]) - kMaxStep;
+    }
+
+    /** Build the alias table of a row (Vose's method). A row with no
+        weight always stays on the same degree. */
+    static Row makeRow (const Weights& weights) noexcept;
+};
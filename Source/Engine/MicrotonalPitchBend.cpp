@@ -1,4 +1,5 @@
 #include "MicrotonalPitchBend.h"
+#include <algorithm>
 #include <cmath>
 
 #ifndef M_PI
@@ -14,18 +15,23 @@ void MicrotonalPitchBend::setMaxCents (float cents)
 
 void MicrotonalPitchBend::setVoiceIndex (int index)
 {
-    voiceIndex = (index >= 0 && index < 8) ? index : 0;
+    lfoRate = getLFORate (index);
 }
 
 void MicrotonalPitchBend::advance (double seconds)
 {
-    phase += seconds * getLFORate();
+    phase += seconds * lfoRate;
 
     // Keep phase bounded to avoid precision loss over long periods
     if (phase > 1000000.0)
         phase = std::fmod (phase, 1000000.0);
 }
 
+void MicrotonalPitchBend::setTime (double seconds)
+{
+    phase = std::fmod (std::max (0.0, seconds) * lfoRate, 1000000.0);
+}
+
 void MicrotonalPitchBend::reset()
 {
     phase = 0.0;
@@ -63,7 +69,7 @@ int MicrotonalPitchBend::centsToPitchBend (float cents)
     return bendValue;
 }
 
-double MicrotonalPitchBend::getLFORate() const
+double MicrotonalPitchBend::getLFORate (int voiceIndex)
 {
     // Each voice gets a unique slow rate based on prime numbers
     // Rates range from ~0.01 Hz to ~0.05 Hz (20-100 second periods)
@@ -78,5 +84,11 @@ double MicrotonalPitchBend::getLFORate() const
         0.0509    // ~20s
     };
 
-    return rates[voiceIndex];
+    if (voiceIndex >= 0 && voiceIndex < 8)
+        return rates[voiceIndex];
+
+    // Beyond the table: plastic-number Weyl sequence over the same range,
+    // independent of the golden-ratio sequence used for phase drift
+    double weyl = std::fmod (static_cast<double> (std::max (0, voiceIndex)) * 0.7548776662466927, 1.0);
+    return 0.0137 + 0.0372 * weyl;
 }
@@ -17,12 +17,15 @@ public:
     /** Set the maximum detune depth in cents (0–50). */
     void setMaxCents (float cents);
 
-    /** Set the voice index (0–7) for unique wandering. */
+    /** Set the voice index for unique wandering. */
     void setVoiceIndex (int index);
 
     /** Advance the internal LFO by a time step (seconds). */
     void advance (double seconds);
 
+    /** Set the LFO to an absolute time (seconds from the start). */
+    void setTime (double seconds);
+
     /** Reset the internal state. */
     void reset();
 
@@ -38,9 +41,9 @@ public:
 
 private:
     float maxCents = 15.0f;
-    int voiceIndex = 0;
+    double lfoRate = 0.0137;
     double phase = 0.0;
 
     // Each voice has a unique slow LFO rate
-    double getLFORate() const;
+    static double getLFORate (int voiceIndex);
 };
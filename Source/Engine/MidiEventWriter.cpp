@@ -0,0 +1,201 @@
+#include "MidiEventWriter.h"
+#include "MicrotonalPitchBend.h"
+
+MidiEventWriter::MidiEventWriter()
+{
+    reset();
+}
+
+void MidiEventWriter::prepare (double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    reset();
+}
+
+void MidiEventWriter::reset()
+{
+    channels.fill (Channel());
+    voiceChannel.fill (kNone);
+    pendingBend.fill (-1);
+    clock = 0;
+    tokens = getBurstSize();
+    flushCursor = 0;
+}
+
+void MidiEventWriter::setMaxBendRate (float bendsPerSecond)
+{
+    maxBendRate = juce::jmax (1.0f, bendsPerSecond);
+}
+
+double MidiEventWriter::getBurstSize() const
+{
+    // Enough for every channel to open a note at once, or 20 ms at the full rate
+    return juce::jmax (static_cast<double> (kNumChannels), 0.02 * static_cast<double> (maxBendRate));
+}
+
+void MidiEventWriter::append (juce::MidiBuffer& midiBuffer, const juce::uint8* data, int numBytes, int samplePosition)
+{
+    // MidiBuffer's record layout: int32 sample position, uint16 size, bytes
+    constexpr int headerSize = static_cast<int> (sizeof (juce::int32) + sizeof (juce::uint16));
+
+    auto& raw = midiBuffer.data;
+    int offset = raw.size();
+    raw.resize (offset + headerSize + numBytes);
+
+    auto* d = raw.getRawDataPointer() + offset;
+    juce::writeUnaligned<juce::int32> (d, samplePosition);
+    juce::writeUnaligned<juce::uint16> (d + sizeof (juce::int32), static_cast<juce::uint16> (numBytes));
+    std::memcpy (d + headerSize, data, static_cast<size_t> (numBytes));
+}
+
+void MidiEventWriter::append (juce::MidiBuffer& midiBuffer, const juce::MidiMessage& message, int samplePosition)
+{
+    append (midiBuffer, message.getRawData(), message.getRawDataSize(), samplePosition);
+}
+
+void MidiEventWriter::write (const DriftEventQueue& events, juce::MidiBuffer& midiBuffer, int numSamples)
+{
+    // Refill the bucket for this block, then send what was parked
+    double refill = static_cast<double> (numSamples) * static_cast<double> (maxBendRate) / sampleRate;
+    tokens = juce::jmin (getBurstSize(), tokens + refill);
+    flushPendingBends (midiBuffer);
+
+    for (const auto& e : events)
+    {
+        int voice = e.voice;
+        if (! juce::isPositiveAndBelow (voice, DriftEvent::kMaxVoices))
+            continue;
+
+        int index = voiceChannel[static_cast<size_t> (voice)];
+
+        switch (e.type)
+        {
+            case DriftEvent::NoteOn:
+            {
+                if (index < 0)
+                    index = allocateChannel (voice, e.samplePosition, midiBuffer);
+
+                auto& ch = channels[static_cast<size_t> (index)];
+                ch.note = e.note;
+                ch.lastUsed = ++clock;
+
+                append (midiBuffer, juce::MidiMessage::noteOn (index + 1, e.note, e.velocity), e.samplePosition);
+                break;
+            }
+
+            case DriftEvent::NoteOff:
+            {
+                // A voice whose channel was stolen has already been cut
+                if (index < 0)
+                {
+                    voiceChannel[static_cast<size_t> (voice)] = kNone;
+                    break;
+                }
+
+                auto& ch = channels[static_cast<size_t> (index)];
+                append (midiBuffer, juce::MidiMessage::noteOff (index + 1, e.note, (juce::uint8) 0), e.samplePosition);
+
+                pendingBend[static_cast<size_t> (index)] = -1;
+                ch.voice = -1;
+                ch.note = -1;
+                ch.lastUsed = ++clock;
+                voiceChannel[static_cast<size_t> (voice)] = kNone;
+                break;
+            }
+
+            case DriftEvent::Bend:
+            {
+                // Bends of a cut note go nowhere
+                if (index == kCut)
+                    break;
+
+                // The bend before a note-on claims the channel for it and
+                // always goes out: it sets the note's starting pitch
+                bool opensNote = (index == kNone);
+                if (opensNote)
+                    index = allocateChannel (voice, e.samplePosition, midiBuffer);
+
+                addBend (index, MicrotonalPitchBend::centsToPitchBend (e.cents), e.samplePosition, opensNote, midiBuffer);
+                break;
+            }
+        }
+    }
+}
+
+void MidiEventWriter::addBend (int channelIndex, int value, int samplePosition, bool force, juce::MidiBuffer& midiBuffer)
+{
+    auto& pending = pendingBend[static_cast<size_t> (channelIndex)];
+
+    if (! force && tokens < 1.0)
+    {
+        pending = value;   // Latest value wins
+        return;
+    }
+
+    tokens -= 1.0;
+    pending = -1;
+    append (midiBuffer, juce::MidiMessage::pitchWheel (channelIndex + 1, value), samplePosition);
+}
+
+void MidiEventWriter::flushPendingBends (juce::MidiBuffer& midiBuffer)
+{
+    // Round-robin so no channel is starved
+    for (int n = 0; n < kNumChannels && tokens >= 1.0; ++n)
+    {
+        int i = (flushCursor + n) % kNumChannels;
+        auto& pending = pendingBend[static_cast<size_t> (i)];
+
+        if (pending >= 0)
+        {
+            append (midiBuffer, juce::MidiMessage::pitchWheel (i + 1, pending), 0);
+            pending = -1;
+            tokens -= 1.0;
+            flushCursor = (i + 1) % kNumChannels;
+        }
+    }
+}
+
+int MidiEventWriter::allocateChannel (int voice, int samplePosition, juce::MidiBuffer& midiBuffer)
+{
+    int chosen = voice % kNumChannels;
+
+    if (channels[static_cast<size_t> (chosen)].voice >= 0)
+    {
+        // Prefer the free channel released longest ago (lets release tails ring)
+        int oldestFree = -1, oldestBusy = -1;
+
+        for (int i = 0; i < kNumChannels; ++i)
+        {
+            const auto& ch = channels[static_cast<size_t> (i)];
+
+            if (ch.voice < 0)
+            {
+                if (oldestFree < 0 || ch.lastUsed < channels[static_cast<size_t> (oldestFree)].lastUsed)
+                    oldestFree = i;
+            }
+            else if (oldestBusy < 0 || ch.lastUsed < channels[static_cast<size_t> (oldestBusy)].lastUsed)
+            {
+                oldestBusy = i;
+            }
+        }
+
+        chosen = (oldestFree >= 0) ? oldestFree : oldestBusy;
+    }
+
+    auto& ch = channels[static_cast<size_t> (chosen)];
+
+    // All channels busy: cut the oldest note
+    if (ch.voice >= 0)
+    {
+        if (ch.note >= 0)
+            append (midiBuffer, juce::MidiMessage::noteOff (chosen + 1, ch.note, (juce::uint8) 0), samplePosition);
+
+        voiceChannel[static_cast<size_t> (ch.voice)] = kCut;
+    }
+
+    pendingBend[static_cast<size_t> (chosen)] = -1;
+    ch.voice = voice;
+    ch.note = -1;
+    voiceChannel[static_cast<size_t> (voice)] = static_cast<juce::int8> (chosen);
+    return chosen;
+}
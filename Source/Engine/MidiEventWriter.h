@@ -0,0 +1,80 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "DriftEvent.h"
+#include <array>
+
+/**
+ * MidiEventWriter — Serializes DriftEvents into MIDI 1.0 for the host.
+ *
+ * Channels are handed out to sounding voices MPE-style, so any number of
+ * generative voices can share the 16 channels while every sounding note
+ * keeps its own pitch bend. A voice gets its own channel (voice 0 →
+ * channel 1, ...) whenever that is free, so a crew of up to 16 maps
+ * exactly as before. Otherwise it gets the channel that was released
+ * longest ago, and when all 16 are busy the oldest note is cut. Cents
+ * are converted to 14-bit pitch wheel values assuming a ±2 semitone bend
+ * range.
+ *
+ * Pitch bends on the port go through a token bucket. A bend over the rate
+ * is parked as the channel's latest value and sent when tokens return.
+ * Notes and the bend that opens a note are never held back.
+ *
+ * Events are appended to the end of the buffer (see append()), so a block
+ * costs time linear in its events and stays inside the buffer's reserve.
+ */
+class MidiEventWriter
+{
+public:
+    static constexpr int kNumChannels = 16;
+
+    // Output MIDI buffer reservation: about 5000 3-byte events (9 bytes each
+    // with MidiBuffer's header)
+    static constexpr size_t kReserveBytes = 4096 * 12;
+
+    MidiEventWriter();
+
+    void prepare (double sampleRate);
+
+    /** Forget all channel assignments (call when playback restarts). */
+    void reset();
+
+    /** Limit pitch bend messages on the output (per second). */
+    void setMaxBendRate (float bendsPerSecond);
+
+    /** Append the block's events to the MIDI buffer. */
+    void write (const DriftEventQueue& events, juce::MidiBuffer& midiBuffer, int numSamples);
+
+    /** Append an event no earlier than the buffer's last one, in constant time.
+        MidiBuffer::addEvent searches the buffer from the start for the place
+        to insert; for events in time order that place is always the end. */
+    static void append (juce::MidiBuffer& midiBuffer, const juce::uint8* data, int numBytes, int samplePosition);
+    static void append (juce::MidiBuffer& midiBuffer, const juce::MidiMessage& message, int samplePosition);
+
+private:
+    struct Channel
+    {
+        int voice = -1;            // Owning generative voice, -1 = free
+        int note = -1;             // Sounding note, -1 = none
+        juce::uint32 lastUsed = 0; // Allocation clock at the last note-on/off
+    };
+
+    enum { kNone = -1, kCut = -2 };
+
+    std::array<Channel, kNumChannels> channels;
+
+    // Channel index per voice: kNone, or kCut while a stolen note is still held
+    std::array<juce::int8, DriftEvent::kMaxVoices> voiceChannel;
+    juce::uint32 clock = 0;
+
+    // Bend rate limiter
+    double sampleRate = 44100.0;
+    float maxBendRate = 1000.0f;
+    double tokens = 0.0;
+    std::array<int, kNumChannels> pendingBend;   // Parked pitch wheel value, -1 = none
+    int flushCursor = 0;
+
+    void addBend (int channelIndex, int value, int samplePosition, bool force, juce::MidiBuffer& midiBuffer);
+    void flushPendingBends (juce::MidiBuffer& midiBuffer);
+    double getBurstSize() const;
+    int allocateChannel (int voice, int samplePosition, juce::MidiBuffer& midiBuffer);
+};
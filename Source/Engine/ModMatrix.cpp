@@ -0,0 +1,394 @@
+#include "ModMatrix.h"
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace
+{
+    // LFO rates (Hz): far apart and non-harmonic, so their sum rarely repeats
+    constexpr double kLfoRates[ModMatrix::kNumLfos] = { 0.07, 0.17, 0.41, 1.3 };
+
+    // Time for each random walk to wander across its whole range (seconds)
+    constexpr double kWalkSeconds[ModMatrix::kNumWalks] = { 10.0, 30.0, 90.0, 270.0 };
+
+    constexpr double kFollowerAttackSeconds = 0.05;
+    constexpr double kFollowerReleaseSeconds = 0.5;
+
+    constexpr std::uint64_t kWalkSeed = 0x6d6f646d6174ULL;
+
+    const char* const kSourceNames[ModMatrix::NumSources] = {
+        "evolutionA", "evolutionB", "evolutionC", "evolutionD",
+        "lfo1", "lfo2", "lfo3", "lfo4",
+        "walk1", "walk2", "walk3", "walk4",
+        "follower", "data"
+    };
+
+    const char* const kSynthTargetNames[ModMatrix::NumTargets - ParameterSnapshot::NumParameters] = {
+        "padCutoff", "padDetune"
+    };
+
+    // Snapshot fields a route may move: the continuous ones
+    using P = ParameterSnapshot;
+
+    constexpr P::Mask kRoutableParameters =
+        P::bit (P::Trim) | P::bit (P::Flotsam) | P::bit (P::Current)
+      | P::bit (P::Doldrums) | P::bit (P::Gale) | P::bit (P::Sargasso)
+      | P::bit (P::Leeward) | P::bit (P::Berth) | P::bit (P::Maelstrom)
+      | P::bit (P::Tide) | P::bit (P::Logline) | P::bit (P::Plumb)
+      | P::bit (P::Cargo) | P::bit (P::Wake) | P::bit (P::Bunting);
+
+    // Evolution curve seeds (the first three match the engine's original curves)
+    constexpr int curveSeed (int curve) { return curve + 1; }
+}
+
+ModMatrix::ModMatrix()
+{
+    routing.publish (std::make_unique<Routing>());
+}
+
+void ModMatrix::prepare (double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    clock.prepare (sampleRate);
+
+    double tickSeconds = kControlInterval / sampleRate;
+
+    for (int i = 0; i < kNumWalks; ++i)
+        walkSteps[static_cast<size_t> (i)] = static_cast<float> (std::sqrt (3.0 * tickSeconds / kWalkSeconds[i]));
+
+    followerAttack  = static_cast<float> (1.0 - std::exp (-tickSeconds / kFollowerAttackSeconds));
+    followerRelease = static_cast<float> (1.0 - std::exp (-tickSeconds / kFollowerReleaseSeconds));
+
+    updateRotations();
+    reset();
+}
+
+void ModMatrix::reset()
+{
+    syncPhasors (true);
+
+    walks.fill (0.0f);
+    walkRandom.setSeed (kWalkSeed);
+    follower = 0.0f;
+    followerInput = 0.0f;
+    tickCountdown = kControlInterval;
+
+    updateSourceValues();
+}
+
+//==============================================================================
+// Message thread
+
+void ModMatrix::setRoutes (const juce::Array<Route>& routes)
+{
+    auto next = std::make_unique<Routing>();
+
+    for (const auto& r : routes)
+    {
+        if (next->numRoutes == kMaxRoutes)
+            break;
+
+        if (juce::isPositiveAndBelow (r.source, (int) NumSources) && isRoutableTarget (r.target))
+            next->routes[static_cast<size_t> (next->numRoutes++)] = { r.source, r.target, juce::jlimit (-1.0f, 1.0f, r.depth) };
+    }
+
+    routing.publish (std::move (next));
+}
+
+juce::String ModMatrix::getSourceName (int source)
+{
+    return juce::isPositiveAndBelow (source, (int) NumSources) ? kSourceNames[source] : "";
+}
+
+juce::String ModMatrix::getTargetName (int target)
+{
+    if (juce::isPositiveAndBelow (target, (int) ParameterSnapshot::NumParameters))
+        return ParameterSnapshot::getParameterID (static_cast<ParameterSnapshot::Index> (target));
+
+    if (juce::isPositiveAndBelow (target, (int) NumTargets))
+        return kSynthTargetNames[target - ParameterSnapshot::NumParameters];
+
+    return {};
+}
+
+bool ModMatrix::isRoutableTarget (int target) noexcept
+{
+    if (juce::isPositiveAndBelow (target, (int) P::NumParameters))
+        return (kRoutableParameters & P::bit (static_cast<P::Index> (target))) != 0;
+
+    return juce::isPositiveAndBelow (target, (int) NumTargets);
+}
+
+juce::Array<ModMatrix::Route> ModMatrix::readRoutes (const juce::ValueTree& state)
+{
+    juce::Array<Route> routes;
+    auto matrix = state.getChildWithName ("MODMATRIX");
+
+    for (int i = 0; i < matrix.getNumChildren(); ++i)
+    {
+        auto node = matrix.getChild (i);
+        juce::String sourceName = node.getProperty ("source").toString();
+        juce::String targetName = node.getProperty ("target").toString();
+
+        Route r;
+        r.source = -1;
+        r.target = -1;
+        r.depth = static_cast<float> (node.getProperty ("depth", 0.0));
+
+        for (int s = 0; s < NumSources; ++s)
+            if (getSourceName (s) == sourceName)
+                r.source = s;
+
+        for (int t = 0; t < NumTargets; ++t)
+            if (getTargetName (t) == targetName)
+                r.target = t;
+
+        // Routes naming sources or targets this build doesn't know or route are skipped
+        if (r.source >= 0 && isRoutableTarget (r.target))
+            routes.add (r);
+    }
+
+    return routes;
+}
+
+void ModMatrix::writeRoutes (juce::ValueTree& state, const juce::Array<Route>& routes)
+{
+    auto matrix = state.getOrCreateChildWithName ("MODMATRIX", nullptr);
+    matrix.removeAllChildren (nullptr);
+
+    for (const auto& r : routes)
+    {
+        juce::ValueTree node ("ROUTE");
+        node.setProperty ("source", getSourceName (r.source), nullptr);
+        node.setProperty ("target", getTargetName (r.target), nullptr);
+        node.setProperty ("depth", r.depth, nullptr);
+        matrix.appendChild (node, nullptr);
+    }
+}
+
+//==============================================================================
+// Audio thread
+
+ParameterSnapshot::Mask ModMatrix::process (ParameterSnapshot& params, ParameterSnapshot::Mask changed, int numSamples)
+{
+    using P = ParameterSnapshot;
+
+    // Sum the routes (sources as of the end of the previous block)
+    std::array<float, NumTargets> amounts {};
+    P::Mask routed = 0;
+
+    activeRouting = routing.acquire();
+
+    if (const auto* current = activeRouting)
+    {
+        for (int i = 0; i < current->numRoutes; ++i)
+        {
+            const auto& r = current->routes[static_cast<size_t> (i)];
+            amounts[static_cast<size_t> (r.target)] += r.depth * sourceValues[static_cast<size_t> (r.source)];
+
+            if (r.target < P::NumParameters)
+                routed |= P::Mask (1) << r.target;
+        }
+    }
+
+    P::Mask moved = 0;
+
+    for (int i = 0; i < P::NumParameters; ++i)
+    {
+        auto index = static_cast<P::Index> (i);
+
+        if (routed & P::bit (index))
+            moved |= params.modulate (index, amounts[static_cast<size_t> (i)]);
+        else if (routedLastBlock & P::bit (index))
+            moved |= params.clearModulation (index);
+    }
+
+    routedLastBlock = routed;
+
+    for (size_t i = 0; i < synthAmounts.size(); ++i)
+        synthAmounts[i] = juce::jlimit (-1.0f, 1.0f, amounts[P::NumParameters + i]);
+
+    // Evolution timebase: Almanac 0 follows the wall clock, 1–24 start at a fixed hour
+    auto all = changed | moved;
+
+    if (all & P::bit (P::Tide))
+    {
+        warp = juce::jmax (0.0, static_cast<double> (params.get (P::Tide)));
+        clock.setWarp (warp);
+        updateRotations();
+    }
+
+    if (all & P::bit (P::Almanac))
+    {
+        clock.setStartTime ((params.getInt (P::Almanac) - 1) * 3600.0);
+        syncPhasors (false);
+        updateSourceValues();   // In case no tick falls in this block
+    }
+
+    // Advance the sources by the ticks that fall in this block
+    clock.advance (numSamples);
+
+    bool ticked = false;
+    for (tickCountdown -= numSamples; tickCountdown <= 0; tickCountdown += kControlInterval)
+    {
+        tick();
+        ticked = true;
+    }
+
+    if (ticked)
+        updateSourceValues();
+
+    return moved;
+}
+
+void ModMatrix::setNonRealtime (bool nonRealtime)
+{
+    clock.setFollowsTimeline (nonRealtime);
+    reset();
+}
+
+void ModMatrix::setTimelinePosition (double seconds) noexcept
+{
+    double expected = clock.getTimeSeconds();
+    clock.setTimelinePosition (seconds);
+
+    // The phasors carry on across a block; only a jump needs exact phases
+    if (std::abs (clock.getTimeSeconds() - expected) > warp * kControlInterval / sampleRate)
+    {
+        syncPhasors (false);
+        updateSourceValues();
+    }
+}
+
+void ModMatrix::rewindEvolution (int numSamples)
+{
+    clock.advance (-numSamples);
+    syncPhasors (false);
+    updateSourceValues();
+}
+
+void ModMatrix::syncPhasors (bool resetLfos)
+{
+    // Exact phases from the clock; the recurrence carries on from here
+    alignas (32) double c[kNumPhasorVecs * kLanes] = {};
+    alignas (32) double s[kNumPhasorVecs * kLanes] = {};
+
+    // Keep the LFO lanes where they are unless they restart too
+    for (int v = 0; ! resetLfos && v < kNumPhasorVecs; ++v)
+    {
+        phasorCos[static_cast<size_t> (v)].copyToRawArray (c + v * kLanes);
+        phasorSin[static_cast<size_t> (v)].copyToRawArray (s + v * kLanes);
+    }
+
+    double time = clock.getTimeSeconds();
+
+    for (int curve = 0; curve < kNumEvolutionCurves; ++curve)
+    {
+        for (int term = 0; term < EvolutionCurve::kNumTerms; ++term)
+        {
+            double angle = EvolutionCurve::getAngle (curveSeed (curve), term, time);
+            int i = curve * EvolutionCurve::kNumTerms + term;
+            c[i] = std::cos (angle);
+            s[i] = std::sin (angle);
+        }
+    }
+
+    // LFOs start a quarter turn apart
+    for (int lfo = 0; resetLfos && lfo < kNumLfos; ++lfo)
+    {
+        double angle = 0.5 * M_PI * lfo;
+        c[kNumEvolutionPhasors + lfo] = std::cos (angle);
+        s[kNumEvolutionPhasors + lfo] = std::sin (angle);
+    }
+
+    for (int v = 0; v < kNumPhasorVecs; ++v)
+    {
+        phasorCos[static_cast<size_t> (v)] = Vec::fromRawArray (c + v * kLanes);
+        phasorSin[static_cast<size_t> (v)] = Vec::fromRawArray (s + v * kLanes);
+    }
+}
+
+void ModMatrix::updateRotations()
+{
+    alignas (32) double c[kNumPhasorVecs * kLanes] = {};
+    alignas (32) double s[kNumPhasorVecs * kLanes] = {};
+
+    double tickSeconds = kControlInterval / sampleRate;
+
+    for (int i = 0; i < kNumPhasorVecs * kLanes; ++i)
+    {
+        double step = 0.0;
+
+        if (i < kNumEvolutionPhasors)
+            step = EvolutionCurve::getAngularRate (i % EvolutionCurve::kNumTerms) * tickSeconds * warp;
+        else if (i < kNumPhasors)
+            step = 2.0 * M_PI * kLfoRates[i - kNumEvolutionPhasors] * tickSeconds;
+
+        c[i] = std::cos (step);
+        s[i] = std::sin (step);
+    }
+
+    for (int v = 0; v < kNumPhasorVecs; ++v)
+    {
+        rotCos[static_cast<size_t> (v)] = Vec::fromRawArray (c + v * kLanes);
+        rotSin[static_cast<size_t> (v)] = Vec::fromRawArray (s + v * kLanes);
+    }
+}
+
+void ModMatrix::tick()
+{
+    for (size_t v = 0; v < phasorCos.size(); ++v)
+    {
+        auto c = phasorCos[v] * rotCos[v] - phasorSin[v] * rotSin[v];
+        auto s = phasorSin[v] * rotCos[v] + phasorCos[v] * rotSin[v];
+
+        // Pull the magnitude back to 1 (first-order), so rounding never accumulates
+        auto gain = Vec::expand (1.5) - (c * c + s * s) * 0.5;
+        phasorCos[v] = c * gain;
+        phasorSin[v] = s * gain;
+    }
+
+    // Random walks reflect off ±1
+    for (size_t i = 0; i < walks.size(); ++i)
+    {
+        float w = walks[i] + walkSteps[i] * walkRandom.nextFloat (-1.0f, 1.0f);
+
+        if (w > 1.0f)  w = 2.0f - w;
+        if (w < -1.0f) w = -2.0f - w;
+
+        walks[i] = w;
+    }
+
+    float coeff = followerInput > follower ? followerAttack : followerRelease;
+    follower += coeff * (followerInput - follower);
+}
+
+void ModMatrix::updateSourceValues()
+{
+    alignas (32) double s[kNumPhasorVecs * kLanes];
+
+    for (int v = 0; v < kNumPhasorVecs; ++v)
+        phasorSin[static_cast<size_t> (v)].copyToRawArray (s + v * kLanes);
+
+    // Each curve is the mean of its sinusoids, as -1..1
+    for (int curve = 0; curve < kNumEvolutionCurves; ++curve)
+    {
+        double sum = 0.0;
+
+        for (int term = 0; term < EvolutionCurve::kNumTerms; ++term)
+            sum += s[curve * EvolutionCurve::kNumTerms + term];
+
+        sourceValues[static_cast<size_t> (EvolutionA + curve)] = static_cast<float> (sum / EvolutionCurve::kNumTerms);
+    }
+
+    for (int lfo = 0; lfo < kNumLfos; ++lfo)
+        sourceValues[static_cast<size_t> (Lfo1 + lfo)] = static_cast<float> (s[kNumEvolutionPhasors + lfo]);
+
+    for (int walk = 0; walk < kNumWalks; ++walk)
+        sourceValues[static_cast<size_t> (Walk1 + walk)] = walks[static_cast<size_t> (walk)];
+
+    sourceValues[Follower] = follower;
+    sourceValues[Data] = dataSeries != nullptr ? dataSeries->getValue (clock, dataReader) : 0.0f;
+}
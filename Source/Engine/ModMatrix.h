@@ -0,0 +1,193 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_dsp/juce_dsp.h>
+#include "AtomicSnapshot.h"
+#include "DataSeries.h"
+#include "DriftRandom.h"
+#include "EvolutionClock.h"
+#include "EvolutionCurve.h"
+#include "ParameterSnapshot.h"
+#include <array>
+
+/**
+ * ModMatrix — Control-rate modulation sources and their routes.
+ *
+ * All sources advance together once every kControlInterval samples:
+ * four 24-hour evolution curves running on the warped EvolutionClock,
+ * four LFOs, four bounded random walks, an envelope follower on the
+ * plugin output, and a recorded DataSeries read at the clock's time.
+ * The 20 sinusoids of the curves and the LFOs are rotating phasors
+ * packed into SIMD registers, so a tick costs a few multiply-adds per
+ * register and no sin calls. The tick does not depend on the host block
+ * size, so neither does the modulation.
+ *
+ * A route scales one source onto one target: a continuous field of the
+ * ParameterSnapshot (as an offset of its normalised range) or a synth
+ * target. Keys, modes, switches, counts and the Almanac hour are not
+ * targets; moved at LFO rate they would flip modes or restart things.
+ * Routes are edited on the message thread, stored in the plugin state,
+ * and handed to the audio thread as one immutable Routing.
+ */
+class ModMatrix
+{
+public:
+    enum Source
+    {
+        EvolutionA = 0,   // Drives note density
+        EvolutionB,       // Drives velocity
+        EvolutionC,       // Drives octave spread
+        EvolutionD,       // Free for routing
+        Lfo1,
+        Lfo2,
+        Lfo3,
+        Lfo4,
+        Walk1,
+        Walk2,
+        Walk3,
+        Walk4,
+        Follower,         // Output level, 0–1 (all other sources are -1..1)
+        Data,             // The loaded DataSeries over its range (0 without one)
+        NumSources
+    };
+
+    // Targets are the snapshot fields, followed by the synth targets
+    enum SynthTarget
+    {
+        PadCutoff = ParameterSnapshot::NumParameters,   // ±3 octaves
+        PadDetune,                                      // 0–2x the chorus detune
+        NumTargets
+    };
+
+    static constexpr int kNumEvolutionCurves = 4;
+    static constexpr int kNumLfos = 4;
+    static constexpr int kNumWalks = 4;
+    static constexpr int kMaxRoutes = 16;
+    static constexpr int kControlInterval = 64;   // Samples per control tick
+
+    struct Route
+    {
+        int source = EvolutionD;
+        int target = PadCutoff;
+        float depth = 0.0f;       // -1..1 of the target's range
+    };
+
+    struct Routing
+    {
+        std::array<Route, kMaxRoutes> routes;
+        int numRoutes = 0;
+    };
+
+    ModMatrix();
+
+    void prepare (double sampleRate);
+
+    /** Restart every source (the evolution curves from the clock's start time). */
+    void reset();
+
+    //==============================================================================
+    // Message thread
+
+    /** Publish a new set of routes (invalid or surplus routes are dropped). */
+    void setRoutes (const juce::Array<Route>& routes);
+
+    /** Routes stored in a plugin state tree, and back. */
+    static juce::Array<Route> readRoutes (const juce::ValueTree& state);
+    static void writeRoutes (juce::ValueTree& state, const juce::Array<Route>& routes);
+
+    /** Stable names used in the saved state. */
+    static juce::String getSourceName (int source);
+    static juce::String getTargetName (int target);
+
+    /** Whether a route may move this target (continuous fields and synth targets). */
+    static bool isRoutableTarget (int target) noexcept;
+
+    //==============================================================================
+    // Audio thread
+
+    /** Apply the routes to the snapshot, follow its Tide and Almanac fields,
+        then advance the sources by a block. Returns the snapshot fields
+        whose effective values moved. */
+    ParameterSnapshot::Mask process (ParameterSnapshot& params, ParameterSnapshot::Mask changed, int numSamples);
+
+    /** Read a data series through one of its reader slots (null for none).
+        Set before processing starts; the series must outlive the matrix. */
+    void setDataSeries (DataSeries* series, int readerIndex) noexcept
+    {
+        dataSeries = series;
+        dataReader = readerIndex;
+    }
+
+    /** Level the follower tracks (e.g. the peak of the last output block). */
+    void setFollowerInput (float level) noexcept { followerInput = level; }
+
+    float getSource (Source source) const noexcept   { return sourceValues[static_cast<size_t> (source)]; }
+
+    /** Summed modulation of a synth target, -1..1. */
+    float getSynthTarget (SynthTarget target) const noexcept
+    {
+        return synthAmounts[static_cast<size_t> (target - ParameterSnapshot::NumParameters)];
+    }
+
+    double getEvolutionTime() const noexcept    { return clock.getTimeSeconds(); }
+
+    /** Run the evolution clock from the host timeline (offline renders)
+        instead of the wall clock. Restarts every source, so each render
+        starts from the same state. */
+    void setNonRealtime (bool nonRealtime);
+
+    /** The evolution clock, and the routes the last block used (null for
+        none), for the journal. */
+    const EvolutionClock& getClock() const noexcept  { return clock; }
+    const Routing* getRouting() const noexcept       { return activeRouting; }
+
+    /** Restart the evolution clock from this Unix time instead of the
+        system clock (replaying a journal). */
+    void setWallClock (double unixSeconds) noexcept  { clock.setWallClock (unixSeconds); }
+
+    /** Host timeline position (seconds) at the start of the next block,
+        while rendering offline. A relocation resyncs the curves. */
+    void setTimelinePosition (double seconds) noexcept;
+
+    /** Step the evolution clock back (e.g. when regenerating audio that was
+        already generated ahead). LFOs, walks and the follower carry on. */
+    void rewindEvolution (int numSamples);
+
+private:
+    using Vec = juce::dsp::SIMDRegister<double>;
+
+    static constexpr int kLanes = static_cast<int> (Vec::SIMDNumElements);
+    static constexpr int kNumEvolutionPhasors = kNumEvolutionCurves * EvolutionCurve::kNumTerms;
+    static constexpr int kNumPhasors = kNumEvolutionPhasors + kNumLfos;
+    static constexpr int kNumPhasorVecs = (kNumPhasors + kLanes - 1) / kLanes;
+
+    double sampleRate = 44100.0;
+    double warp = 1.0;
+    EvolutionClock clock;
+
+    // Phasors (evolution terms first, then the LFOs) and their per-tick rotation
+    std::array<Vec, kNumPhasorVecs> phasorCos, phasorSin, rotCos, rotSin;
+
+    std::array<float, kNumWalks> walks {};
+    std::array<float, kNumWalks> walkSteps {};
+    DriftRandom walkRandom;
+
+    float followerInput = 0.0f;
+    float follower = 0.0f;
+    float followerAttack = 0.0f, followerRelease = 0.0f;
+
+    DataSeries* dataSeries = nullptr;
+    int dataReader = 0;
+
+    int tickCountdown = kControlInterval;
+    std::array<float, NumSources> sourceValues {};
+    std::array<float, NumTargets - ParameterSnapshot::NumParameters> synthAmounts {};
+    ParameterSnapshot::Mask routedLastBlock = 0;
+
+    AtomicSnapshot<Routing> routing;
+    const Routing* activeRouting = nullptr;
+
+    void syncPhasors (bool resetLfos);
+    void updateRotations();
+    void tick();
+    void updateSourceValues();
+};
@@ -0,0 +1,168 @@
+#include "OscControl.h"
+#include <cmath>
+
+namespace
+{
+    constexpr int kCommitCheckHz = 10;
+}
+
+OscControl::OscControl (juce::AudioProcessorValueTreeState& apvts)
+    : state (apvts)
+{
+    commands.resize (static_cast<size_t> (kQueueSize));
+
+    for (int i = 0; i < P::NumParameters; ++i)
+        addresses.emplace_back (juce::String (kAddressPrefix) + P::getParameterID (static_cast<P::Index> (i)));
+
+    receiver.addListener (this);
+}
+
+OscControl::~OscControl()
+{
+    stopTimer();
+    receiver.removeListener (this);
+    receiver.disconnect();
+}
+
+//==============================================================================
+// Message thread
+
+bool OscControl::setPort (int newPort)
+{
+    receiver.disconnect();
+    port = 0;
+
+    if (newPort <= 0 || newPort > 65535 || ! receiver.connect (newPort))
+    {
+        // Whatever arrived is still committed
+        return newPort == 0;
+    }
+
+    port = newPort;
+    startTimerHz (kCommitCheckHz);
+    return true;
+}
+
+void OscControl::timerCallback()
+{
+    // Commit the fields that moved in the last tick and not since
+    auto moved = received.exchange (0);
+    commit (settling & ~moved);
+    settling = moved;
+
+    if (port == 0 && settling == 0)
+        stopTimer();
+}
+
+void OscControl::commit (P::Mask fields)
+{
+    for (int i = 0; i < P::NumParameters; ++i)
+    {
+        auto index = static_cast<P::Index> (i);
+        if (! (fields & P::bit (index)))
+            continue;
+
+        if (auto* param = state.getParameter (P::getParameterID (index)))
+        {
+            param->beginChangeGesture();
+            param->setValueNotifyingHost (param->convertTo0to1 (latest[static_cast<size_t> (i)].load()));
+            param->endChangeGesture();
+        }
+    }
+}
+
+//==============================================================================
+// Receiver thread
+
+void OscControl::oscMessageReceived (const juce::OSCMessage& message)
+{
+    if (message.size() != 1)
+        return;
+
+    const auto& argument = message[0];
+    float value;
+
+    if (argument.isFloat32())
+        value = argument.getFloat32();
+    else if (argument.isInt32())
+        value = static_cast<float> (argument.getInt32());
+    else
+        return;
+
+    if (! std::isfinite (value))
+        return;
+
+    // A pattern may name several fields
+    const auto& pattern = message.getAddressPattern();
+
+    for (int i = 0; i < P::NumParameters; ++i)
+    {
+        if (! pattern.matches (addresses[static_cast<size_t> (i)]))
+            continue;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+        {
+            dropped.fetch_add (1, std::memory_order_relaxed);
+            continue;
+        }
+
+        commands[static_cast<size_t> (size1 > 0 ? start1 : start2)] = { i, value };
+        fifo.finishedWrite (1);
+
+        // The committed value follows the queue, never leads it
+        latest[static_cast<size_t> (i)].store (value);
+        received.fetch_or (P::bit (static_cast<P::Index> (i)));
+    }
+}
+
+void OscControl::oscBundleReceived (const juce::OSCBundle& bundle)
+{
+    for (const auto& element : bundle)
+    {
+        if (element.isMessage())
+            oscMessageReceived (element.getMessage());
+        else if (element.isBundle())
+            oscBundleReceived (element.getBundle());
+    }
+}
+
+//==============================================================================
+// Audio thread
+
+OscControl::P::Mask OscControl::process (P& params) noexcept
+{
+    applied = 0;
+
+    int ready = fifo.getNumReady();
+    if (ready == 0)
+        return 0;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (ready, start1, size1, start2, size2);
+
+    // In arrival order, so the last value of each field wins
+    auto take = [this] (int start, int size)
+    {
+        for (int k = 0; k < size; ++k)
+        {
+            const auto& c = commands[static_cast<size_t> (start + k)];
+            appliedValues[static_cast<size_t> (c.index)] = c.value;
+            applied |= P::bit (static_cast<P::Index> (c.index));
+        }
+    };
+
+    take (start1, size1);
+    take (start2, size2);
+    fifo.finishedRead (size1 + size2);
+
+    P::Mask moved = 0;
+
+    for (int i = 0; i < P::NumParameters; ++i)
+        if (applied & P::bit (static_cast<P::Index> (i)))
+            moved |= params.setOverride (static_cast<P::Index> (i), appliedValues[static_cast<size_t> (i)]);
+
+    return moved;
+}
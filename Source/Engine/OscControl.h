@@ -0,0 +1,104 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_osc/juce_osc.h>
+#include "ParameterSnapshot.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+/**
+ * OscControl — Drives the parameters from OSC messages over UDP.
+ *
+ * Show control software and lighting desks, on this machine or the LAN,
+ * send /captaindrift/<parameter ID> with one float or int argument in the
+ * parameter's own units, e.g. /captaindrift/flotsam 2.5. Bundles are
+ * unpacked; any other message is ignored.
+ *
+ * The OSC receiver thread turns each message into a command and pushes it
+ * into a preallocated single-producer/single-consumer FIFO; if the FIFO is
+ * full the command is dropped and counted. At the start of each block the
+ * audio thread drains the FIFO, keeps the last value of each field, and
+ * holds it as a snapshot override, so a burst of thousands of messages
+ * costs one pass and never blocks or allocates.
+ *
+ * Once a field stops moving, a message-thread timer writes it into the
+ * APVTS so the host, the editor and the saved state catch up, and the
+ * override settles without a change. Host automation of a field wins over
+ * OSC, as it does over a preset morph. With Lookout on, the worker hears a
+ * change once it is committed.
+ *
+ * To try it from a loopback sender: oscsend localhost 9000 /captaindrift/flotsam f 2.5
+ */
+class OscControl : private juce::OSCReceiver::Listener<juce::OSCReceiver::RealtimeCallback>,
+                   private juce::Timer
+{
+public:
+    using P = ParameterSnapshot;
+
+    static constexpr int kDefaultPort = 9000;
+    static constexpr int kQueueSize = 1 << 14;      // Commands between two blocks
+    static constexpr const char* kAddressPrefix = "/captaindrift/";
+
+    explicit OscControl (juce::AudioProcessorValueTreeState& apvts);
+    ~OscControl() override;
+
+    //==============================================================================
+    // Message thread
+
+    /** Listen on a UDP port (1-65535), or stop with 0. Returns false if the
+        port cannot be opened; OSC control is then off. */
+    bool setPort (int port);
+    int getPort() const noexcept { return port; }
+
+    /** Commands dropped because the queue was full (any thread). */
+    juce::uint32 getNumDropped() const noexcept { return dropped.load (std::memory_order_relaxed); }
+
+    //==============================================================================
+    // Audio thread
+
+    /** Hold the values that arrived since the last block (after the
+        snapshot's update() and the preset morph). Returns the fields whose
+        effective values moved. */
+    P::Mask process (P& params) noexcept;
+
+    /** The fields the last process() applied, and their values, for the journal. */
+    P::Mask getApplied() const noexcept                { return applied; }
+    float getAppliedValue (P::Index index) const noexcept { return appliedValues[static_cast<size_t> (index)]; }
+
+private:
+    struct Command
+    {
+        int index = 0;
+        float value = 0.0f;
+    };
+
+    juce::AudioProcessorValueTreeState& state;
+    juce::OSCReceiver receiver { "CaptainDrift OSC receiver" };
+    std::vector<juce::OSCAddress> addresses;      // One per snapshot field
+    int port = 0;
+
+    // Receiver thread to audio thread
+    juce::AbstractFifo fifo { kQueueSize };
+    std::vector<Command> commands;
+    std::atomic<juce::uint32> dropped { 0 };
+
+    // Receiver thread to message thread: each field's latest value, and
+    // the fields that moved since the last tick
+    std::array<std::atomic<float>, P::NumParameters> latest {};
+    std::atomic<P::Mask> received { 0 };
+
+    // Audio thread
+    P::Mask applied = 0;
+    std::array<float, P::NumParameters> appliedValues {};
+
+    // Message thread: fields that moved in the last tick, committed once quiet
+    P::Mask settling = 0;
+
+    void oscMessageReceived (const juce::OSCMessage& message) override;
+    void oscBundleReceived (const juce::OSCBundle& bundle) override;
+
+    void timerCallback() override;
+    void commit (P::Mask fields);
+
+    JUCE_DECLARE_NON_COPYABLE (OscControl)
+};
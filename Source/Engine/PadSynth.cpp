@@ -1,12 +1,23 @@
 #include "PadSynth.h"
+#include <algorithm>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+namespace
+{
+    // Antiderivative of tanh, without overflow
+    double logCosh (double x)
+    {
+        x = std::abs (x);
+        return x + std::log1p (std::exp (-2.0 * x)) - std::log (2.0);
+    }
+}
+
 PadSynth::PadSynth()
 {
-    channelPitchBend.fill (1.0);
+    sourcePitchBend.fill (1.0);
 }
 
 void PadSynth::prepare (double newSampleRate, int /*blockSize*/)
@@ -27,7 +38,8 @@ void PadSynth::reset()
 
     lpState[0] = 0.0f;
     lpState[1] = 0.0f;
-    channelPitchBend.fill (1.0);
+    clipLast = 0.0;
+    sourcePitchBend.fill (1.0);
 }
 
 void PadSynth::setDroneMode (bool enabled)
@@ -35,71 +47,83 @@ void PadSynth::setDroneMode (bool enabled)
     droneEnabled = enabled;
 }
 
+void PadSynth::setModulation (float cutoff, float detune)
+{
+    cutoffModulation = juce::jlimit (-1.0f, 1.0f, cutoff);
+    detuneModulation = juce::jlimit (-1.0f, 1.0f, detune);
+}
+
 void PadSynth::processBlock (juce::AudioBuffer<float>& audioBuffer,
-                              const juce::MidiBuffer& midiBuffer)
+                              const DriftEventQueue& events)
 {
     auto numSamples = audioBuffer.getNumSamples();
     auto numChannels = audioBuffer.getNumChannels();
 
-    // Process MIDI events
-    for (const auto metadata : midiBuffer)
+    // Process note events
+    for (const auto& e : events)
     {
-        auto msg = metadata.getMessage();
-
-        if (msg.isNoteOn())
-            noteOn (msg.getChannel(), msg.getNoteNumber(), msg.getFloatVelocity());
-        else if (msg.isNoteOff())
-            noteOff (msg.getChannel(), msg.getNoteNumber());
-        else if (msg.isPitchWheel())
-            handlePitchBend (msg.getChannel(), msg.getPitchWheelValue());
+        switch (e.type)
+        {
+            case DriftEvent::NoteOn:  noteOn (e.voice, e.note, static_cast<float> (e.velocity) / 127.0f); break;
+            case DriftEvent::NoteOff: noteOff (e.voice, e.note); break;
+            case DriftEvent::Bend:    handlePitchBend (e.voice, e.cents); break;
+        }
     }
 
-    // Render audio
-    for (int sample = 0; sample < numSamples; ++sample)
+    // Detune factors
+    double detuneCents = kDetuneCents * (1.0 + detuneModulation);
+    detuneUp   = std::pow (2.0, detuneCents / 1200.0);
+    detuneDown = std::pow (2.0, -detuneCents / 1200.0);
+
+    // Simple one-pole lowpass for warmth
+    // Drone mode: darker cutoff (~800 Hz) for deep warmth
+    float lpCutoff = (droneEnabled ? 800.0f : 3000.0f) * std::exp2 (3.0f * cutoffModulation);
+    lpCutoff = juce::jmin (lpCutoff, 0.45f * static_cast<float> (sampleRate));
+    float lpCoeff = 1.0f - std::exp (-2.0f * static_cast<float> (M_PI) * lpCutoff / static_cast<float> (sampleRate));
+
+    // Soft clip (lower gain in drone mode for gentler output)
+    float gainMul = droneEnabled ? 0.45f : 0.7f;
+    int chunkSize = nonRealtime ? kOfflineChunk : kRealtimeChunk;
+
+    // Render audio, one voice at a time over each chunk
+    for (int start = 0; start < numSamples; start += chunkSize)
     {
-        float monoSample = 0.0f;
+        int chunk = juce::jmin (chunkSize, numSamples - start);
+        std::fill_n (voiceSum.data(), chunk, 0.0f);
 
         for (auto& voice : voices)
         {
             if (! voice.active)
                 continue;
 
-            // Update pitch bend factor from channel
-            if (voice.channel >= 1 && voice.channel <= 16)
-                voice.pitchBendFactor = channelPitchBend[static_cast<size_t> (voice.channel - 1)];
+            // Update pitch bend factor from the owning generative voice
+            if (juce::isPositiveAndBelow (voice.source, kMaxSources))
+                voice.pitchBendFactor = sourcePitchBend[static_cast<size_t> (voice.source)];
 
-            monoSample += renderVoice (voice);
-
-            // Deactivate voice when envelope reaches zero during release
-            if (voice.releasing && voice.envelope <= 0.0001f)
-            {
-                voice.active = false;
-                voice.noteNumber = -1;
-            }
+            renderVoice (voice, voiceSum.data(), chunk);
         }
 
-        // Simple one-pole lowpass for warmth
-        // Drone mode: darker cutoff (~800 Hz) for deep warmth
-        float lpCutoff = droneEnabled ? 800.0f : 3000.0f;
-        float lpCoeff = 1.0f - std::exp (-2.0f * static_cast<float> (M_PI) * lpCutoff / static_cast<float> (sampleRate));
-        lpState[0] += lpCoeff * (monoSample - lpState[0]);
+        for (int i = 0; i < chunk; ++i)
+        {
+            lpState[0] += lpCoeff * (voiceSum[static_cast<size_t> (i)] - lpState[0]);
 
-        // Soft clip (lower gain in drone mode for gentler output)
-        float gainMul = droneEnabled ? 0.45f : 0.7f;
-        float out = std::tanh (lpState[0] * gainMul);
+            float x = lpState[0] * gainMul;
+            float out = nonRealtime ? clipAntialiased (x) : std::tanh (x);
+            clipLast = x;
 
-        // Write to all output channels
-        for (int ch = 0; ch < numChannels; ++ch)
-            audioBuffer.addSample (ch, sample, out);
+            // Write to all output channels
+            for (int ch = 0; ch < numChannels; ++ch)
+                audioBuffer.addSample (ch, start + i, out);
+        }
     }
 }
 
-void PadSynth::noteOn (int channel, int note, float velocity)
+void PadSynth::noteOn (int source, int note, float velocity)
 {
-    // Check if this note is already playing on this channel
+    // Check if this note is already playing for this source
     for (auto& v : voices)
     {
-        if (v.active && v.noteNumber == note && v.channel == channel)
+        if (v.active && v.noteNumber == note && v.source == source)
         {
             // Retrigger: reset release state
             v.releasing = false;
@@ -154,7 +178,7 @@ void PadSynth::noteOn (int channel, int note, float velocity)
 
     freeVoice->active = true;
     freeVoice->noteNumber = note;
-    freeVoice->channel = channel;
+    freeVoice->source = source;
     freeVoice->velocity = velocity;
     freeVoice->baseFreq = midiNoteToFreq (note);
     freeVoice->releasing = false;
@@ -172,16 +196,16 @@ void PadSynth::noteOn (int channel, int note, float velocity)
         freeVoice->envelope = 0.0f;
     }
 
-    // Apply channel pitch bend
-    if (channel >= 1 && channel <= 16)
-        freeVoice->pitchBendFactor = channelPitchBend[static_cast<size_t> (channel - 1)];
+    // Apply source pitch bend
+    if (juce::isPositiveAndBelow (source, kMaxSources))
+        freeVoice->pitchBendFactor = sourcePitchBend[static_cast<size_t> (source)];
 }
 
-void PadSynth::noteOff (int channel, int note)
+void PadSynth::noteOff (int source, int note)
 {
     for (auto& v : voices)
     {
-        if (v.active && v.noteNumber == note && v.channel == channel && ! v.releasing)
+        if (v.active && v.noteNumber == note && v.source == source && ! v.releasing)
         {
             v.releasing = true;
             v.releaseLevel = v.envelope;
@@ -190,25 +214,19 @@ void PadSynth::noteOff (int channel, int note)
     }
 }
 
-void PadSynth::handlePitchBend (int channel, int bendValue)
+void PadSynth::handlePitchBend (int source, float cents)
 {
-    if (channel < 1 || channel > 16)
+    if (! juce::isPositiveAndBelow (source, kMaxSources))
         return;
 
-    // Convert 14-bit pitch bend to frequency ratio
-    // Center = 8192, range = ±2 semitones
-    double semitones = (static_cast<double> (bendValue) - 8192.0) / 8192.0 * 2.0;
-    channelPitchBend[static_cast<size_t> (channel - 1)] = std::pow (2.0, semitones / 12.0);
+    // Full-precision cents straight from the generator, no 14-bit round trip
+    sourcePitchBend[static_cast<size_t> (source)] = std::pow (2.0, static_cast<double> (cents) / 1200.0);
 }
 
-float PadSynth::renderVoice (SynthVoice& voice)
+void PadSynth::renderVoice (SynthVoice& voice, float* output, int numSamples)
 {
     double freq = voice.baseFreq * voice.pitchBendFactor;
 
-    // Detune factors
-    double detuneUp   = std::pow (2.0, kDetuneCents / 1200.0);
-    double detuneDown = std::pow (2.0, -kDetuneCents / 1200.0);
-
     // Phase increments
     double inc1 = freq / sampleRate;
     double inc2 = freq * detuneUp / sampleRate;
@@ -216,66 +234,91 @@ float PadSynth::renderVoice (SynthVoice& voice)
     double inc4 = (freq * 0.5) / sampleRate;   // Sub octave
     double inc5 = (freq * 1.5) / sampleRate;   // Perfect fifth (drone harmonic)
 
-    // Advance phases
-    voice.phase1 += inc1;
-    voice.phase2 += inc2;
-    voice.phase3 += inc3;
-    voice.phase4 += inc4;
-    voice.phase5 += inc5;
-
-    if (voice.phase1 >= 1.0) voice.phase1 -= 1.0;
-    if (voice.phase2 >= 1.0) voice.phase2 -= 1.0;
-    if (voice.phase3 >= 1.0) voice.phase3 -= 1.0;
-    if (voice.phase4 >= 1.0) voice.phase4 -= 1.0;
-    if (voice.phase5 >= 1.0) voice.phase5 -= 1.0;
-
-    // Generate waveforms (sine for smooth pad sound)
-    float osc1 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase1));
-    float osc2 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase2));
-    float osc3 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase3));
-    float osc4 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase4));
-    float osc5 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase5));
-
-    // Mix: main + detuned + sub, plus quiet fifth harmonic in drone mode
-    float mix;
-    if (droneEnabled)
-    {
-        // Drone: more sub, add fifth harmonic, wider detuning presence
-        mix = osc1 * 0.3f + osc2 * 0.2f + osc3 * 0.2f + osc4 * 0.2f + osc5 * 0.1f;
-    }
-    else
-    {
-        mix = osc1 * 0.4f + osc2 * 0.2f + osc3 * 0.2f + osc4 * 0.2f;
-    }
-
     // Select envelope rates based on drone mode
     float attackRate  = droneEnabled ? kDroneAttackRate  : kAttackRate;
     float releaseRate = droneEnabled ? kDroneReleaseRate : kReleaseRate;
 
-    // Update envelope
-    if (! voice.releasing)
-    {
-        // Attack
-        voice.envelope += attackRate;
-        if (voice.envelope > 1.0f)
-            voice.envelope = 1.0f;
-    }
-    else
+    for (int i = 0; i < numSamples; ++i)
     {
-        // Release
-        voice.releasePhase += releaseRate;
-        if (voice.releasePhase >= 1.0f)
+        // Advance phases
+        voice.phase1 += inc1;
+        voice.phase2 += inc2;
+        voice.phase3 += inc3;
+        voice.phase4 += inc4;
+        voice.phase5 += inc5;
+
+        if (voice.phase1 >= 1.0) voice.phase1 -= 1.0;
+        if (voice.phase2 >= 1.0) voice.phase2 -= 1.0;
+        if (voice.phase3 >= 1.0) voice.phase3 -= 1.0;
+        if (voice.phase4 >= 1.0) voice.phase4 -= 1.0;
+        if (voice.phase5 >= 1.0) voice.phase5 -= 1.0;
+
+        // Generate waveforms (sine for smooth pad sound)
+        float osc1 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase1));
+        float osc2 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase2));
+        float osc3 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase3));
+        float osc4 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase4));
+        float osc5 = static_cast<float> (std::sin (2.0 * M_PI * voice.phase5));
+
+        // Mix: main + detuned + sub, plus quiet fifth harmonic in drone mode
+        float mix;
+        if (droneEnabled)
         {
-            voice.envelope = 0.0f;
+            // Drone: more sub, add fifth harmonic, wider detuning presence
+            mix = osc1 * 0.3f + osc2 * 0.2f + osc3 * 0.2f + osc4 * 0.2f + osc5 * 0.1f;
         }
         else
         {
-            // Exponential release curve
-            voice.envelope = voice.releaseLevel * (1.0f - voice.releasePhase) * (1.0f - voice.releasePhase);
+            mix = osc1 * 0.4f + osc2 * 0.2f + osc3 * 0.2f + osc4 * 0.2f;
+        }
+
+        // Update envelope
+        if (! voice.releasing)
+        {
+            // Attack
+            voice.envelope += attackRate;
+            if (voice.envelope > 1.0f)
+                voice.envelope = 1.0f;
+        }
+        else
+        {
+            // Release
+            voice.releasePhase += releaseRate;
+            if (voice.releasePhase >= 1.0f)
+            {
+                voice.envelope = 0.0f;
+            }
+            else
+            {
+                // Exponential release curve
+                voice.envelope = voice.releaseLevel * (1.0f - voice.releasePhase) * (1.0f - voice.releasePhase);
+            }
+        }
+
+        output[i] += mix * voice.envelope * voice.velocity * 0.15f;
+
+        // Deactivate voice when envelope reaches zero during release
+        if (voice.releasing && voice.envelope <= 0.0001f)
+        {
+            voice.active = false;
+            voice.noteNumber = -1;
+            return;
         }
     }
+}
+
+float PadSynth::clipAntialiased (float x) noexcept
+{
+    // First-order antiderivative antialiasing: the mean of tanh between the
+    // previous input and this one, from the difference of its antiderivative
+    double x0 = clipLast;
+    double x1 = x;
+    double dx = x1 - x0;
+
+    if (std::abs (dx) < 1.0e-5)
+        return static_cast<float> (std::tanh (0.5 * (x0 + x1)));
 
-    return mix * voice.envelope * voice.velocity * 0.15f;
+    return static_cast<float> ((logCosh (x1) - logCosh (x0)) / dx);
 }
 
 double PadSynth::midiNoteToFreq (int note) const
@@ -1,22 +1,30 @@
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
+#include "DriftEvent.h"
 #include <cmath>
 #include <array>
 
 /**
  * PadSynth — Simple built-in pad synthesizer.
  *
- * Converts the MIDI events generated by the engine into warm pad audio.
+ * Converts the note events generated by the engine into warm pad audio.
  * Uses layered detuned saw/sine oscillators with a slow attack envelope
  * and built-in reverb-like tail via feedback delay.
  *
  * This makes CaptainDrift a self-contained instrument:
  * just load it and press play.
+ *
+ * Voices are rendered one at a time over a chunk of samples, so each
+ * voice's increments are worked out once per chunk. Offline renders use
+ * longer chunks and an antialiased soft clip.
  */
 class PadSynth
 {
 public:
     static constexpr int kMaxSynthVoices = 16;
+    static constexpr int kMaxSources = DriftEvent::kMaxVoices;   // Generative voices that can send events
+    static constexpr int kRealtimeChunk = 256;
+    static constexpr int kOfflineChunk = 4096;
 
     PadSynth();
 
@@ -26,16 +34,23 @@ public:
     /** Enable/disable drone mode (ultra-slow envelopes, dark filter, harmonic fifth). */
     void setDroneMode (bool enabled);
 
-    /** Process MIDI events and generate audio into the buffer. */
+    /** Offline renders trade speed per sample for quality: longer chunks and
+        a soft clip without aliasing. */
+    void setNonRealtime (bool shouldBeNonRealtime) noexcept { nonRealtime = shouldBeNonRealtime; }
+
+    /** Modulation amounts (-1..1): cutoff ±3 octaves, detune 0–2x. */
+    void setModulation (float cutoff, float detune);
+
+    /** Process note events and generate audio into the buffer. */
     void processBlock (juce::AudioBuffer<float>& audioBuffer,
-                       const juce::MidiBuffer& midiBuffer);
+                       const DriftEventQueue& events);
 
 private:
     struct SynthVoice
     {
         bool active = false;
         int noteNumber = -1;
-        int channel = 0;
+        int source = 0;       // Generative voice that owns the note
         float velocity = 0.0f;
 
         // Oscillator phases
@@ -60,15 +75,27 @@ private:
 
     std::array<SynthVoice, kMaxSynthVoices> voices;
 
-    // Per-channel pitch bend (channels 1-8 for our 8 generative voices)
-    std::array<double, 16> channelPitchBend;
+    // Per-source pitch bend factor (one per generative voice)
+    std::array<double, kMaxSources> sourcePitchBend;
 
     // Simple lowpass state for warmth
     float lpState[2] = { 0.0f, 0.0f };
 
+    // Voice sum of the current chunk
+    std::array<float, kOfflineChunk> voiceSum {};
+
+    // Soft clip input of the previous sample (for the antialiased clip)
+    double clipLast = 0.0;
+    bool nonRealtime = false;
+
     // Drone mode state
     bool droneEnabled = false;
 
+    // Modulation, and the per-block values derived from it
+    float cutoffModulation = 0.0f;
+    float detuneModulation = 0.0f;
+    double detuneUp = 1.0, detuneDown = 1.0;
+
     // Envelope parameters — normal mode
     static constexpr float kAttackRate  = 0.0003f;   // Slow attack (~3s to full)
     static constexpr float kReleaseRate = 0.0001f;    // Very slow release (~10s)
@@ -79,9 +106,10 @@ private:
 
     static constexpr float kDetuneCents = 8.0f;       // Detune amount
 
-    void noteOn (int channel, int note, float velocity);
-    void noteOff (int channel, int note);
-    void handlePitchBend (int channel, int bendValue);
-    float renderVoice (SynthVoice& voice);
+    void noteOn (int source, int note, float velocity);
+    void noteOff (int source, int note);
+    void handlePitchBend (int source, float cents);
+    void renderVoice (SynthVoice& voice, float* output, int numSamples);
+    float clipAntialiased (float x) noexcept;
     double midiNoteToFreq (int note) const;
 };
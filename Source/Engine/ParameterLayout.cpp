@@ -16,9 +16,29 @@ juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
                             "In (Japanese)", "Hirajoshi" },
         0));
 
+    layout.add (std::make_unique<juce::AudioParameterBool> (
+        juce::ParameterID { ID::compass, 1 }, "Compass",
+        false));   // Play the loaded Scala tuning instead of Heading and Chart
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> (
+        juce::ParameterID { ID::helm, 1 }, "Helm",
+        juce::StringArray { "Off", "MIDI Input", "Sidechain" },
+        0));   // Chords held on the input, or the key heard on the sidechain, replace Heading and Chart
+
     layout.add (std::make_unique<juce::AudioParameterInt> (
         juce::ParameterID { ID::crew, 1 }, "Crew",
-        1, 8, 4));   // Active voices
+        1, 512, 4));   // Active voices
+
+    // --- Melody ---
+    layout.add (std::make_unique<juce::AudioParameterChoice> (
+        juce::ParameterID { ID::shanty, 1 }, "Shanty",
+        juce::StringArray { "Drift", "Hymn", "Reel", "Lament", "Learned" },
+        0));   // Drift = bounded random walk; the others draw from a transition matrix
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::trim, 1 }, "Trim",
+        juce::NormalisableRange<float> (0.0f, 1.0f, 0.01f),
+        0.0f));   // Consonance: 0 = voices independent, 1 = no clashes with the swarm
 
     // --- Rhythm ---
     layout.add (std::make_unique<juce::AudioParameterFloat> (
@@ -72,6 +92,20 @@ juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
         juce::NormalisableRange<float> (0.0f, 1.0f, 0.01f),
         0.2f));   // Randomness
 
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::tide, 1 }, "Tide",
+        juce::NormalisableRange<float> (1.0f, 1440.0f, 0.1f, 0.2f),
+        1.0f));   // Evolution speed: 1 = real time, 1440 = a day per minute
+
+    juce::StringArray startTimes { "Clock" };
+    for (int hour = 0; hour < 24; ++hour)
+        startTimes.add (juce::String (hour).paddedLeft ('0', 2) + ":00");
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> (
+        juce::ParameterID { ID::almanac, 1 }, "Almanac",
+        startTimes,
+        0));   // Evolution start: wall clock at prepare, or a fixed hour (offline renders)
+
     // --- Generation on/off ---
     layout.add (std::make_unique<juce::AudioParameterBool> (
         juce::ParameterID { ID::genEnabled, 1 }, "Generate",
@@ -82,5 +116,52 @@ juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
         juce::ParameterID { ID::droneMode, 1 }, "Drone",
         false));   // Off by default
 
+    // --- Sample layer ---
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::cargo, 1 }, "Cargo",
+        juce::NormalisableRange<float> (0.0f, 1.0f, 0.01f),
+        0.8f));   // Level of the streamed sample instrument
+
+    // --- Ensemble ---
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::wake, 1 }, "Wake",
+        juce::NormalisableRange<float> (0.0f, 1.0f, 0.01f),
+        0.4f));   // Ensemble chorus mix on the pad
+
+    // --- MIDI output ---
+    layout.add (std::make_unique<juce::AudioParameterBool> (
+        juce::ParameterID { ID::semaphore, 1 }, "Semaphore",
+        true));   // Serialize generated notes to the MIDI output
+
+    layout.add (std::make_unique<juce::AudioParameterBool> (
+        juce::ParameterID { ID::convoy, 1 }, "Convoy",
+        false));   // Pass incoming MIDI through, merged with the generated notes
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::logline, 1 }, "Logline",
+        juce::NormalisableRange<float> (1.0f, 100.0f, 0.1f, 0.5f),
+        5.0f));   // How often a held note's detune is checked (ms)
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::plumb, 1 }, "Plumb",
+        juce::NormalisableRange<float> (0.0f, 5.0f, 0.01f),
+        0.5f));   // Detune change (cents) needed before a new bend is sent
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::bunting, 1 }, "Bunting",
+        juce::NormalisableRange<float> (50.0f, 5000.0f, 1.0f, 0.4f),
+        1000.0f));   // Pitch bend messages per second on the MIDI output
+
+    // --- Presets ---
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        juce::ParameterID { ID::passage, 1 }, "Passage",
+        juce::NormalisableRange<float> (0.0f, 14400.0f, 0.1f, 0.2f),
+        10.0f));   // Time to morph to a newly chosen program: 0 = at once, up to 4 hours
+
+    // --- Lookahead ---
+    layout.add (std::make_unique<juce::AudioParameterInt> (
+        juce::ParameterID { ID::lookout, 1 }, "Lookout",
+        0, 32, 0));   // Blocks generated ahead on a worker thread; 0 generates in the audio callback
+
     return layout;
 }
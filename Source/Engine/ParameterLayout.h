@@ -5,7 +5,7 @@ namespace ID
 {
     inline constexpr const char* heading   = "heading";    // Root note (0-11)
     inline constexpr const char* chart     = "chart";      // Scale type (0-6)
-    inline constexpr const char* crew      = "crew";       // Active voices (1-8)
+    inline constexpr const char* crew      = "crew";       // Active voices (1-512)
     inline constexpr const char* flotsam   = "flotsam";    // Note density
     inline constexpr const char* current   = "current";    // Internal tempo BPM
     inline constexpr const char* doldrums  = "doldrums";   // Note length (legato)
@@ -18,6 +18,21 @@ namespace ID
     inline constexpr const char* maelstrom = "maelstrom";  // Randomness amount
     inline constexpr const char* genEnabled = "genEnabled"; // Generation on/off
     inline constexpr const char* droneMode = "droneMode";   // Drone mode on/off
+    inline constexpr const char* cargo     = "cargo";      // Sample layer level
+    inline constexpr const char* wake      = "wake";       // Ensemble chorus mix
+    inline constexpr const char* semaphore = "semaphore";  // MIDI output on/off
+    inline constexpr const char* logline   = "logline";    // Pitch bend check interval (ms)
+    inline constexpr const char* plumb     = "plumb";      // Minimum pitch bend change (cents)
+    inline constexpr const char* bunting   = "bunting";    // MIDI pitch bend rate limit (per second)
+    inline constexpr const char* lookout   = "lookout";    // Blocks generated ahead on a worker thread (0 = off)
+    inline constexpr const char* tide      = "tide";       // Evolution time-warp factor
+    inline constexpr const char* almanac   = "almanac";    // Evolution start time (wall clock or fixed hour)
+    inline constexpr const char* shanty    = "shanty";     // Melody style (random walk or transition matrix)
+    inline constexpr const char* trim      = "trim";       // Consonance across the swarm (0 = off)
+    inline constexpr const char* compass   = "compass";    // Play the loaded Scala tuning
+    inline constexpr const char* helm      = "helm";       // Follow the key of the MIDI input or the sidechain
+    inline constexpr const char* convoy    = "convoy";     // Merge incoming MIDI into the output
+    inline constexpr const char* passage   = "passage";    // Preset morph time (seconds)
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
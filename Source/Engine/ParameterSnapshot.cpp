@@ -0,0 +1,147 @@
+#include "ParameterSnapshot.h"
+#include "ParameterLayout.h"
+#include <cmath>
+#include <cstring>
+
+const char* ParameterSnapshot::getParameterID (Index index) noexcept
+{
+    // Same order as the Index enum
+    static const char* const ids[NumParameters] = {
+        ID::heading, ID::chart, ID::shanty, ID::trim, ID::compass, ID::helm, ID::crew,
+        ID::flotsam, ID::current, ID::doldrums, ID::gale, ID::shallows, ID::depths, ID::sargasso,
+        ID::leeward, ID::berth, ID::maelstrom, ID::tide, ID::almanac,
+        ID::genEnabled, ID::droneMode,
+        ID::logline, ID::plumb,
+        ID::cargo, ID::wake, ID::semaphore, ID::convoy, ID::bunting, ID::lookout
+    };
+
+    return ids[index];
+}
+
+ParameterSnapshot::ParameterSnapshot (juce::AudioProcessorValueTreeState& apvts)
+{
+    for (int i = 0; i < NumParameters; ++i)
+    {
+        auto* id = getParameterID (static_cast<Index> (i));
+        sources[static_cast<size_t> (i)] = apvts.getRawParameterValue (id);
+        jassert (sources[static_cast<size_t> (i)] != nullptr);
+
+        ranges[static_cast<size_t> (i)] = apvts.getParameterRange (id);
+    }
+}
+
+ParameterSnapshot::Mask ParameterSnapshot::update() noexcept
+{
+    alignas (64) std::array<float, NumParameters> next;
+
+    for (size_t i = 0; i < next.size(); ++i)
+        next[i] = sources[i]->load (std::memory_order_relaxed);
+
+    return update (next);
+}
+
+ParameterSnapshot::Mask ParameterSnapshot::update (const std::array<float, NumParameters>& next) noexcept
+{
+    // Steady state: one compare of the packed block
+    if (valid && std::memcmp (next.data(), host.data(), sizeof (next)) == 0)
+        return 0;
+
+    Mask moved = 0;
+
+    for (size_t i = 0; i < next.size(); ++i)
+        if (next[i] != host[i])
+            moved |= Mask (1) << i;
+
+    host = next;
+
+    // A host value that moves takes the field back from an override. One
+    // that arrives at the overriding value (a preset morph being committed)
+    // changes nothing, give or take the round trip through the host's
+    // normalised value.
+    Mask settled = 0;
+
+    for (size_t i = 0; i < next.size(); ++i)
+    {
+        float tolerance = 1.0e-5f * (ranges[i].end - ranges[i].start);
+
+        if ((moved & overridden & (Mask (1) << i)) && std::abs (host[i] - values[i]) <= tolerance)
+        {
+            settled |= Mask (1) << i;
+            values[i] = host[i];
+        }
+    }
+
+    overridden &= ~moved;
+
+    Mask changed = valid ? (moved & ~settled) : kAll;
+    valid = true;
+
+    // A new host value replaces any modulation until the matrix reapplies it
+    for (size_t i = 0; i < next.size(); ++i)
+    {
+        if ((changed & (Mask (1) << i)) && ! (overridden & (Mask (1) << i)))
+        {
+            values[i] = host[i];
+            effective[i] = values[i];
+        }
+    }
+
+    return changed;
+}
+
+ParameterSnapshot::Mask ParameterSnapshot::setOverride (Index index, float value) noexcept
+{
+    auto i = static_cast<size_t> (index);
+    overridden |= bit (index);
+
+    value = ranges[i].snapToLegalValue (value);
+    if (value == values[i])
+        return 0;
+
+    values[i] = value;
+    effective[i] = value;
+    return bit (index);
+}
+
+ParameterSnapshot::Mask ParameterSnapshot::releaseOverride (Index index) noexcept
+{
+    auto i = static_cast<size_t> (index);
+
+    if (! (overridden & bit (index)))
+        return 0;
+
+    overridden &= ~bit (index);
+
+    if (values[i] == host[i])
+        return 0;
+
+    values[i] = host[i];
+    effective[i] = values[i];
+    return bit (index);
+}
+
+ParameterSnapshot::Mask ParameterSnapshot::modulate (Index index, float normalisedOffset) noexcept
+{
+    auto i = static_cast<size_t> (index);
+    const auto& range = ranges[i];
+
+    float normalised = juce::jlimit (0.0f, 1.0f, range.convertTo0to1 (values[i]) + normalisedOffset);
+    float value = range.snapToLegalValue (range.convertFrom0to1 (normalised));
+
+    if (value == effective[i])
+        return 0;
+
+    effective[i] = value;
+    return bit (index);
+}
+
+ParameterSnapshot::Mask ParameterSnapshot::clearModulation (Index index) noexcept
+{
+    auto i = static_cast<size_t> (index);
+
+    if (effective[i] == values[i])
+        return 0;
+
+    effective[i] = values[i];
+    return bit (index);
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <array>
+#include <atomic>
+
+/**
+ * ParameterSnapshot — Per-block copy of all plugin parameters.
+ *
+ * The APVTS atomics are looked up by ID once, at construction. update()
+ * loads them into a packed array, compares that with the previous block
+ * with one memcmp, and returns a bit mask of the fields that changed.
+ * When nothing moved (the usual case) the mask is 0, and consumers skip
+ * their parameter work entirely.
+ *
+ * Each field has three layers. The host value comes from the APVTS; the
+ * base value is the host value, or a value held by setOverride() (a preset
+ * morph, OSC) until the host moves that field; the effective value, which
+ * is what get() returns, is the base value offset by the modulation matrix.
+ * Neither overrides nor modulation write back to the APVTS.
+ */
+class ParameterSnapshot
+{
+public:
+    enum Index
+    {
+        // Generator
+        Heading = 0,
+        Chart,
+        Shanty,
+        Trim,
+        Compass,
+        Helm,
+        Crew,
+        Flotsam,
+        Current,
+        Doldrums,
+        Gale,
+        Shallows,
+        Depths,
+        Sargasso,
+        Leeward,
+        Berth,
+        Maelstrom,
+        Tide,
+        Almanac,
+        GenEnabled,
+        DroneMode,
+        Logline,
+        Plumb,
+
+        // Sound and output
+        Cargo,
+        Wake,
+        Semaphore,
+        Convoy,
+        Bunting,
+        Lookout,
+
+        NumParameters
+    };
+
+    using Mask = juce::uint32;
+    static_assert (NumParameters <= 32, "Mask must hold one bit per parameter");
+
+    static constexpr Mask bit (Index index) noexcept { return Mask (1) << index; }
+    static constexpr Mask kAll = (Mask (1) << NumParameters) - 1;
+
+    explicit ParameterSnapshot (juce::AudioProcessorValueTreeState& apvts);
+
+    /** APVTS parameter ID of a field. */
+    static const char* getParameterID (Index index) noexcept;
+
+    /** Read the current parameter values. Returns the mask of changed fields
+        (all of them on the first call, or after invalidate()). */
+    Mask update() noexcept;
+
+    /** The same from given host values (replaying a journal). */
+    Mask update (const std::array<float, NumParameters>& hostValues) noexcept;
+
+    /** Report every field as changed on the next update (e.g. after prepare). */
+    void invalidate() noexcept { valid = false; }
+
+    /** Hold a field's base value away from the host value (snapped to a
+        legal value), until released or until the host value changes.
+        Returns the field's bit if the effective value moved. */
+    Mask setOverride (Index index, float value) noexcept;
+
+    /** Return a field's base value to the host value. Returns the field's
+        bit if the effective value moved. */
+    Mask releaseOverride (Index index) noexcept;
+
+    /** Fields whose base value is currently overridden. */
+    Mask getOverridden() const noexcept         { return overridden; }
+
+    /** Offset a field from its base value by a fraction of its range. The
+        result is clamped and snapped to a legal value. Returns the field's
+        bit if the effective value moved. */
+    Mask modulate (Index index, float normalisedOffset) noexcept;
+
+    /** Return a field to its base value. Returns the field's bit if it moved. */
+    Mask clearModulation (Index index) noexcept;
+
+    float get (Index index) const noexcept      { return effective[static_cast<size_t> (index)]; }
+    int getInt (Index index) const noexcept     { return static_cast<int> (get (index)); }
+    bool getBool (Index index) const noexcept   { return get (index) >= 0.5f; }
+
+    /** The base value (the host's, or an override), without modulation. */
+    float getBase (Index index) const noexcept  { return values[static_cast<size_t> (index)]; }
+
+    /** The host value as of the last update, before any override. */
+    float getHost (Index index) const noexcept  { return host[static_cast<size_t> (index)]; }
+
+    const juce::NormalisableRange<float>& getRange (Index index) const noexcept { return ranges[static_cast<size_t> (index)]; }
+
+private:
+    std::array<std::atomic<float>*, NumParameters> sources {};
+    std::array<juce::NormalisableRange<float>, NumParameters> ranges;
+    alignas (64) std::array<float, NumParameters> host {};
+    std::array<float, NumParameters> values {};
+    std::array<float, NumParameters> effective {};
+    Mask overridden = 0;
+    bool valid = false;
+
+    JUCE_DECLARE_NON_COPYABLE (ParameterSnapshot)
+};
@@ -1,5 +1,6 @@
 #include "PhaseAccumulator.h"
 #include <cmath>
+#include <limits>
 
 PhaseAccumulator::PhaseAccumulator() {}
 
@@ -13,7 +14,17 @@ void PhaseAccumulator::setBasePeriod (double beatsPerNote)
     basePeriod = (beatsPerNote > 0.01) ? beatsPerNote : 0.01;
 }
 
-void PhaseAccumulator::setDrift (float driftAmount, int voiceIndex)
+void PhaseAccumulator::setVoiceIndex (int voiceIndex)
+{
+    driftRatio = getDriftRatio (voiceIndex);
+}
+
+void PhaseAccumulator::setDrift (float driftAmount)
+{
+    driftScale = driftRatio * static_cast<double> (driftAmount);
+}
+
+double PhaseAccumulator::getDriftRatio (int voiceIndex)
 {
     // Each voice gets a unique drift offset proportional to its index.
     // Prime ratios ensure voices never re-align at simple intervals.
@@ -28,31 +39,76 @@ void PhaseAccumulator::setDrift (float driftAmount, int voiceIndex)
         0.04303     // voice 7
     };
 
-    int idx = (voiceIndex >= 0 && voiceIndex < 8) ? voiceIndex : 0;
-    driftOffset = basePeriod * primeFactors[idx] * static_cast<double> (driftAmount);
+    if (voiceIndex < 0)
+        return 0.0;
+
+    if (voiceIndex < 8)
+        return primeFactors[voiceIndex];
+
+    // Larger swarms: golden-ratio (Weyl) sequence spread over 0.005–0.05.
+    // Consecutive values are irrational multiples apart, so periods never coincide
+    double weyl = std::fmod (static_cast<double> (voiceIndex) * 0.6180339887498949, 1.0);
+    return 0.005 + 0.045 * weyl;
+}
+
+int PhaseAccumulator::samplesUntilTrigger (double beatsPerSample) const
+{
+    double period = getEffectivePeriod();
+    if (period <= 0.0 || beatsPerSample <= 0.0)
+        return std::numeric_limits<int>::max();
+
+    double samples = std::ceil ((period - phase) / beatsPerSample);
+    if (samples < 1.0)
+        return 1;
+
+    return samples < 1.0e9 ? static_cast<int> (samples) : 1000000000;
 }
 
-bool PhaseAccumulator::advance (double beats)
+void PhaseAccumulator::wrap()
 {
     double period = getEffectivePeriod();
     if (period <= 0.0)
-        return false;
+        return;
 
-    phase += beats;
+    // Wrap phase, preserving fractional overshoot for timing accuracy
+    phase -= period;
 
+    // Only when the period shrank by more than the phase already covered
     if (phase >= period)
-    {
-        // Wrap phase, preserving fractional overshoot for timing accuracy
         phase = std::fmod (phase, period);
-        return true;   // trigger!
+    else if (phase < 0.0)
+        phase = 0.0;
+}
+
+long long PhaseAccumulator::seek (double beatPosition)
+{
+    double period = getEffectivePeriod();
+    if (period <= 0.0 || beatPosition <= 0.0)
+    {
+        phase = 0.0;
+        return 0;
+    }
+
+    double triggers = std::floor (beatPosition / period);
+    phase = beatPosition - triggers * period;
+
+    // Rounding near an exact multiple
+    if (phase >= period)
+    {
+        phase = 0.0;
+        triggers += 1.0;
+    }
+    else if (phase < 0.0)
+    {
+        phase = 0.0;
     }
 
-    return false;
+    return static_cast<long long> (triggers);
 }
 
 double PhaseAccumulator::getPhase() const
 {
-    double period = basePeriod + driftOffset;
+    double period = getEffectivePeriod();
     if (period <= 0.0)
         return 0.0;
 
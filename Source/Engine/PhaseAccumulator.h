@@ -18,22 +18,42 @@ public:
     /** Set the base period in beats (e.g., 4.0 = one note every 4 beats). */
     void setBasePeriod (double beatsPerNote);
 
-    /** Set the drift offset as a fraction of the base period.
-        driftAmount 0–1, voiceIndex 0–7. Each voice gets a unique drift. */
-    void setDrift (float driftAmount, int voiceIndex);
+    /** Select the voice's drift ratio. Each voice index gets a unique one. */
+    void setVoiceIndex (int voiceIndex);
 
-    /** Advance the accumulator by a number of beats.
-        Returns true if a note trigger occurred during this advance. */
-    bool advance (double beats);
+    /** Scale the voice's drift offset (0–1). */
+    void setDrift (float driftAmount);
+
+    /** Drift ratio of a voice: hand-picked for voices 0–7, then a
+        low-discrepancy sequence so no two voices ever share a period. */
+    static double getDriftRatio (int voiceIndex);
+
+    /** Number of samples (at least 1) until the next trigger is reached,
+        counting the sample that reaches it. Very large if the clock is stopped. */
+    int samplesUntilTrigger (double beatsPerSample) const;
+
+    /** Advance the accumulator by a number of beats without wrapping. */
+    void advanceBy (double beats) { phase += beats; }
+
+    /** Consume one period after a trigger, preserving the overshoot. */
+    void wrap();
+
+    /** Jump to an absolute beat position, as if the accumulator had run from
+        beat 0 at the current period. Returns the number of triggers so far. */
+    long long seek (double beatPosition);
+
+    /** Beats elapsed since the last trigger. */
+    double getPhaseBeats() const { return phase; }
 
     /** Get the current phase (0..1 within the current period). */
     double getPhase() const;
 
     /** Get the effective period (base + drift). */
-    double getEffectivePeriod() const { return basePeriod + driftOffset; }
+    double getEffectivePeriod() const { return basePeriod * (1.0 + driftScale); }
 
 private:
     double basePeriod  = 4.0;
-    double driftOffset = 0.0;
+    double driftRatio  = 0.0;
+    double driftScale  = 0.0;   // driftRatio * drift amount
     double phase       = 0.0;
 };
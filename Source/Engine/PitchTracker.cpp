@@ -0,0 +1,282 @@
+#include "PitchTracker.h"
+#include "ScaleQuantizer.h"
+#include <cmath>
+
+namespace
+{
+    // Krumhansl–Kessler key profiles, from the tonic
+    constexpr float kMajorProfile[12] = { 6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f, 2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f };
+    constexpr float kMinorProfile[12] = { 6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f, 2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f };
+
+    // Pearson correlation of the chroma with a profile rotated to a root
+    float correlate (const std::array<float, 12>& chroma, const float* profile, int root)
+    {
+        float meanC = 0.0f, meanP = 0.0f;
+        for (int i = 0; i < 12; ++i)
+        {
+            meanC += chroma[static_cast<size_t> (i)];
+            meanP += profile[i];
+        }
+        meanC /= 12.0f;
+        meanP /= 12.0f;
+
+        float cov = 0.0f, varC = 0.0f, varP = 0.0f;
+        for (int i = 0; i < 12; ++i)
+        {
+            float c = chroma[static_cast<size_t> ((root + i) % 12)] - meanC;
+            float p = profile[i] - meanP;
+            cov += c * p;
+            varC += c * c;
+            varP += p * p;
+        }
+
+        return varC > 0.0f ? cov / std::sqrt (varC * varP) : 0.0f;
+    }
+
+    // Switching key needs a clearly better match than the current one
+    constexpr float kKeyHysteresis = 0.05f;
+}
+
+PitchTracker::PitchTracker()
+{
+    prepare (44100.0);
+}
+
+void PitchTracker::prepare (double sampleRate)
+{
+    decimation = juce::jmax (1, juce::roundToInt (sampleRate / kTargetRate));
+    analysisRate = sampleRate / decimation;
+
+    // Lags for 55 Hz – 1 kHz
+    minLag = juce::jmax (2, static_cast<int> (analysisRate / 1000.0));
+    maxLag = juce::jmin (kMaxLag, static_cast<int> (std::ceil (analysisRate / 55.0)));
+
+    // Butterworth low-pass well below the decimated Nyquist frequency
+    double cutoff = juce::jmin (0.4 * analysisRate, 0.45 * sampleRate);
+    double w = juce::MathConstants<double>::twoPi * cutoff / sampleRate;
+    double q = 1.0 / juce::MathConstants<double>::sqrt2;
+    double alpha = std::sin (w) / (2.0 * q);
+    double cosW = std::cos (w);
+    double a0 = 1.0 + alpha;
+
+    b0 = static_cast<float> ((1.0 - cosW) * 0.5 / a0);
+    b1 = static_cast<float> ((1.0 - cosW) / a0);
+    b2 = b0;
+    a1 = static_cast<float> (-2.0 * cosW / a0);
+    a2 = static_cast<float> ((1.0 - alpha) / a0);
+
+    chromaDecay = static_cast<float> (std::exp (-kHop / (analysisRate * kChromaSeconds)));
+    reset();
+}
+
+void PitchTracker::reset()
+{
+    z1 = z2 = 0.0f;
+    decimationPhase = 0;
+    ring.fill (0.0f);
+    ringWrite = 0;
+    samplesSinceFrame = 0;
+    frameActive = false;
+    nextLag = 1;
+    chroma.fill (0.0f);
+    key = 0;
+    frequency = 0.0f;
+}
+
+void PitchTracker::process (const juce::AudioBuffer<float>& input)
+{
+    int numChannels = input.getNumChannels();
+    int numSamples = input.getNumSamples();
+    if (numChannels == 0 || numSamples == 0)
+        return;
+
+    float gain = 1.0f / static_cast<float> (numChannels);
+    auto* const* channels = input.getArrayOfReadPointers();
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float x = 0.0f;
+        for (int ch = 0; ch < numChannels; ++ch)
+            x += channels[ch][i];
+        x *= gain;
+
+        float y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+
+        if (++decimationPhase >= decimation)
+        {
+            decimationPhase = 0;
+            ring[static_cast<size_t> (ringWrite)] = y;
+            ringWrite = (ringWrite + 1) & (kRingSize - 1);
+            ++samplesSinceFrame;
+        }
+    }
+
+    if (! frameActive && samplesSinceFrame >= kHop)
+        startFrame();
+
+    if (! frameActive)
+        return;
+
+    // Enough lags for this block's share of a hop, so a frame finishes in
+    // about one hop and the cost follows the block length
+    double blockHops = static_cast<double> (numSamples) / static_cast<double> (kHop * decimation);
+    int budget = juce::jlimit (1, maxLag, static_cast<int> (std::ceil (maxLag * blockHops)) + 1);
+
+    for (int n = 0; n < budget && nextLag <= maxLag; ++n, ++nextLag)
+        correlation[static_cast<size_t> (nextLag)] = dot (nextLag);
+
+    if (nextLag > maxLag)
+        finishFrame();
+}
+
+void PitchTracker::startFrame()
+{
+    samplesSinceFrame = 0;
+
+    int frameLength = kWindow + maxLag + kLanes;
+    int start = (ringWrite - frameLength) & (kRingSize - 1);
+
+    energyPrefix[0] = 0.0;
+    for (int i = 0; i < frameLength; ++i)
+    {
+        float x = ring[static_cast<size_t> ((start + i) & (kRingSize - 1))];
+        energyPrefix[static_cast<size_t> (i + 1)] = energyPrefix[static_cast<size_t> (i)] + static_cast<double> (x) * x;
+    }
+
+    // Silence: nothing to detect, and the chroma keeps fading
+    if (energyPrefix[static_cast<size_t> (kWindow)] < kSilence * kWindow)
+    {
+        frequency = 0.0f;
+        for (auto& c : chroma)
+            c *= chromaDecay;
+        return;
+    }
+
+    for (int k = 0; k < kLanes; ++k)
+        for (int i = 0; i < kWindow + maxLag; ++i)
+            shifted[static_cast<size_t> (k)][static_cast<size_t> (i)] = ring[static_cast<size_t> ((start + i + k) & (kRingSize - 1))];
+
+    frameActive = true;
+    nextLag = 1;
+}
+
+float PitchTracker::dot (int lag) const noexcept
+{
+    // x[j + lag] for j = 0, kLanes, ... starts on an aligned element of the
+    // copy shifted by lag % kLanes
+    const float* x = shifted[0].data();
+    const float* y = shifted[static_cast<size_t> (lag % kLanes)].data() + (lag - lag % kLanes);
+
+    auto sum = Vec::expand (0.0f);
+    for (int j = 0; j < kWindow; j += kLanes)
+        sum = Vec::multiplyAdd (sum, Vec::fromRawArray (x + j), Vec::fromRawArray (y + j));
+
+    return sum.sum();
+}
+
+void PitchTracker::finishFrame()
+{
+    frameActive = false;
+
+    // YIN: difference function from the autocorrelation and the window
+    // energies, cumulative mean normalised, first dip below the threshold
+    double e0 = energyPrefix[static_cast<size_t> (kWindow)];
+    double runningSum = 0.0;
+    float dip = 1.0f;
+    int dipLag = -1;
+
+    std::array<float, kMaxLag + 1> normalised {};
+    normalised[0] = 1.0f;
+
+    for (int lag = 1; lag <= maxLag; ++lag)
+    {
+        double eLag = energyPrefix[static_cast<size_t> (lag + kWindow)] - energyPrefix[static_cast<size_t> (lag)];
+        double d = juce::jmax (0.0, e0 + eLag - 2.0 * correlation[static_cast<size_t> (lag)]);
+        runningSum += d;
+
+        float value = runningSum > 0.0 ? static_cast<float> (d * lag / runningSum) : 1.0f;
+        normalised[static_cast<size_t> (lag)] = value;
+
+        if (lag < minLag)
+            continue;
+
+        // Follow the first dip below the threshold down to its bottom
+        if (dipLag < 0)
+        {
+            if (value < kThreshold)
+            {
+                dipLag = lag;
+                dip = value;
+            }
+        }
+        else if (value < dip)
+        {
+            dipLag = lag;
+            dip = value;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // No dip under the threshold: unvoiced
+    if (dipLag < 0)
+    {
+        frequency = 0.0f;
+        for (auto& c : chroma)
+            c *= chromaDecay;
+        return;
+    }
+
+    // Parabolic interpolation around the dip
+    double lag = dipLag;
+    if (dipLag > 1 && dipLag < maxLag)
+    {
+        double a = normalised[static_cast<size_t> (dipLag - 1)];
+        double b = normalised[static_cast<size_t> (dipLag)];
+        double c = normalised[static_cast<size_t> (dipLag + 1)];
+        double denominator = a - 2.0 * b + c;
+
+        if (denominator > 0.0)
+            lag += 0.5 * (a - c) / denominator;
+    }
+
+    frequency = static_cast<float> (analysisRate / lag);
+
+    // Clearer pitches count more
+    float midi = 69.0f + 12.0f * std::log2 (frequency / 440.0f);
+    int pitchClass = ((juce::roundToInt (midi) % 12) + 12) % 12;
+
+    for (auto& c : chroma)
+        c *= chromaDecay;
+
+    chroma[static_cast<size_t> (pitchClass)] += 1.0f - dip;
+
+    updateKey();
+}
+
+void PitchTracker::updateKey()
+{
+    int bestRoot = 0, bestScale = ScaleQuantizer::Major;
+    float best = -2.0f;
+    float currentScore = -2.0f;
+
+    for (int root = 0; root < 12; ++root)
+    {
+        float major = correlate (chroma, kMajorProfile, root);
+        float minor = correlate (chroma, kMinorProfile, root);
+
+        if (major > best)  { best = major; bestRoot = root; bestScale = ScaleQuantizer::Major; }
+        if (minor > best)  { best = minor; bestRoot = root; bestScale = ScaleQuantizer::Minor; }
+
+        if (key != 0 && root == getRoot (key))
+            currentScore = getScale (key) == ScaleQuantizer::Major ? major : minor;
+    }
+
+    if (key == 0 || best > currentScore + kKeyHysteresis)
+        key = makeKey (bestRoot, bestScale);
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+
+/**
+ * PitchTracker — Key of an audio input, from its pitch over the last few seconds.
+ *
+ * The input is summed to mono, low-passed and decimated to about 8 kHz.
+ * Every hop, a YIN pitch estimate is made over the latest window; a
+ * detected pitch adds its clarity to a leaky chroma (12 pitch classes),
+ * and the chroma is matched against the Krumhansl–Kessler major and minor
+ * profiles in every key.
+ *
+ * The autocorrelation behind YIN is spread over the blocks of a hop: each
+ * block computes a number of lags proportional to its length, so the cost
+ * per sample is constant and bounded. The window is copied at four offsets
+ * so every lag is a run of aligned SIMD multiply-adds. All storage is fixed
+ * size: nothing is allocated after construction.
+ */
+class PitchTracker
+{
+public:
+    PitchTracker();
+
+    void prepare (double sampleRate);
+    void reset();
+
+    /** Analyse a block of input (any number of channels). */
+    void process (const juce::AudioBuffer<float>& input);
+
+    /** Latest detected key as one word (see makeKey), or 0 before any. */
+    juce::uint32 getKey() const noexcept { return key; }
+
+    /** Latest detected pitch in Hz (0 = none in the last window). */
+    float getFrequency() const noexcept { return frequency; }
+
+    /** Pack a root (0–11) and a ScaleQuantizer scale into a non-zero word. */
+    static juce::uint32 makeKey (int root, int scale) noexcept
+    {
+        return 0x100u | (static_cast<juce::uint32> (scale) << 4) | static_cast<juce::uint32> (root);
+    }
+
+    static int getRoot (juce::uint32 word) noexcept   { return static_cast<int> (word & 0xfu); }
+    static int getScale (juce::uint32 word) noexcept  { return static_cast<int> ((word >> 4) & 0xfu); }
+
+private:
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr int kLanes = static_cast<int> (Vec::SIMDNumElements);
+
+    static constexpr double kTargetRate = 8000.0;
+    static constexpr int kWindow = 512;                 // Samples per YIN window (a multiple of kLanes)
+    static constexpr int kHop = 256;
+    static constexpr int kMaxLag = 256;                 // Covers 55 Hz up to a 14 kHz analysis rate
+    static constexpr int kFrameSize = kWindow + kMaxLag + kLanes;
+    static constexpr int kRingSize = 2048;              // Power of two, > kWindow + kMaxLag + kHop
+    static constexpr float kThreshold = 0.15f;          // YIN absolute threshold
+    static constexpr float kSilence = 1.0e-4f;          // Mean square below which a window is skipped
+    static constexpr double kChromaSeconds = 4.0;       // Memory of the key estimate
+
+    double analysisRate = kTargetRate;
+    int decimation = 1;
+    int decimationPhase = 0;
+    int minLag = 8, maxLag = 145;
+
+    // Anti-aliasing low-pass (biquad, transposed direct form II)
+    float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+    float z1 = 0.0f, z2 = 0.0f;
+
+    // Decimated input
+    std::array<float, kRingSize> ring {};
+    int ringWrite = 0;
+    int samplesSinceFrame = 0;
+
+    // Window being analysed, copied at offsets 0..kLanes-1 for aligned lags
+    alignas (sizeof (Vec)) std::array<std::array<float, kFrameSize>, kLanes> shifted {};
+    std::array<double, kFrameSize + 1> energyPrefix {};
+    std::array<float, kMaxLag + 1> correlation {};
+    bool frameActive = false;
+    int nextLag = 1;
+
+    // Key estimate
+    std::array<float, 12> chroma {};
+    float chromaDecay = 0.99f;
+    juce::uint32 key = 0;
+    float frequency = 0.0f;
+
+    void startFrame();
+    float dot (int lag) const noexcept;
+    void finishFrame();
+    void updateKey();
+};
@@ -0,0 +1,314 @@
+#include "PresetMorph.h"
+#include "ParameterLayout.h"
+
+namespace
+{
+    struct FactoryValue
+    {
+        const char* id;
+        float value;
+    };
+
+    struct FactoryPreset
+    {
+        const char* name;
+        std::initializer_list<FactoryValue> values;
+    };
+
+    // Built-in presets, after the parameter defaults (Open Water)
+    const FactoryPreset kFactoryPresets[] = {
+        { "Becalmed", {
+            { ID::heading, 2 }, { ID::chart, 4 }, { ID::shanty, 0 }, { ID::trim, 0.6f },
+            { ID::crew, 6 }, { ID::flotsam, 0.15f }, { ID::current, 20.0f }, { ID::doldrums, 0.95f },
+            { ID::gale, 0.2f }, { ID::shallows, 3 }, { ID::depths, 5 }, { ID::sargasso, 0.5f },
+            { ID::leeward, 10.0f }, { ID::berth, 0.3f }, { ID::maelstrom, 0.1f }, { ID::droneMode, 1 },
+            { ID::cargo, 0.6f }, { ID::wake, 0.6f } } },
+
+        { "Harbour Lights", {
+            { ID::heading, 7 }, { ID::chart, 0 }, { ID::shanty, 1 }, { ID::trim, 0.8f },
+            { ID::crew, 8 }, { ID::flotsam, 0.6f }, { ID::current, 48.0f }, { ID::doldrums, 0.8f },
+            { ID::gale, 0.4f }, { ID::shallows, 3 }, { ID::depths, 5 }, { ID::sargasso, 0.3f },
+            { ID::leeward, 8.0f }, { ID::berth, 0.5f }, { ID::maelstrom, 0.15f }, { ID::droneMode, 0 },
+            { ID::cargo, 0.8f }, { ID::wake, 0.4f } } },
+
+        { "Night Watch", {
+            { ID::heading, 9 }, { ID::chart, 1 }, { ID::shanty, 3 }, { ID::trim, 0.7f },
+            { ID::crew, 5 }, { ID::flotsam, 0.3f }, { ID::current, 30.0f }, { ID::doldrums, 0.9f },
+            { ID::gale, 0.3f }, { ID::shallows, 2 }, { ID::depths, 4 }, { ID::sargasso, 0.4f },
+            { ID::leeward, 18.0f }, { ID::berth, 0.6f }, { ID::maelstrom, 0.2f }, { ID::droneMode, 1 },
+            { ID::cargo, 0.7f }, { ID::wake, 0.5f } } },
+
+        { "Squall", {
+            { ID::heading, 4 }, { ID::chart, 2 }, { ID::shanty, 2 }, { ID::trim, 0.3f },
+            { ID::crew, 24 }, { ID::flotsam, 2.5f }, { ID::current, 96.0f }, { ID::doldrums, 0.4f },
+            { ID::gale, 0.8f }, { ID::shallows, 3 }, { ID::depths, 6 }, { ID::sargasso, 0.7f },
+            { ID::leeward, 25.0f }, { ID::berth, 0.8f }, { ID::maelstrom, 0.6f }, { ID::droneMode, 0 },
+            { ID::cargo, 0.8f }, { ID::wake, 0.3f } } },
+
+        { "Deep Sound", {
+            { ID::heading, 0 }, { ID::chart, 8 }, { ID::shanty, 0 }, { ID::trim, 0.5f },
+            { ID::crew, 12 }, { ID::flotsam, 0.2f }, { ID::current, 12.0f }, { ID::doldrums, 1.0f },
+            { ID::gale, 0.25f }, { ID::shallows, 2 }, { ID::depths, 3 }, { ID::sargasso, 0.6f },
+            { ID::leeward, 30.0f }, { ID::berth, 0.7f }, { ID::maelstrom, 0.3f }, { ID::droneMode, 1 },
+            { ID::cargo, 0.9f }, { ID::wake, 0.7f } } },
+
+        { "Landfall", {
+            { ID::heading, 5 }, { ID::chart, 3 }, { ID::shanty, 1 }, { ID::trim, 0.9f },
+            { ID::crew, 16 }, { ID::flotsam, 1.0f }, { ID::current, 60.0f }, { ID::doldrums, 0.7f },
+            { ID::gale, 0.5f }, { ID::shallows, 3 }, { ID::depths, 6 }, { ID::sargasso, 0.2f },
+            { ID::leeward, 5.0f }, { ID::berth, 0.4f }, { ID::maelstrom, 0.1f }, { ID::droneMode, 0 },
+            { ID::cargo, 0.8f }, { ID::wake, 0.45f } } }
+    };
+
+    constexpr int kCommitCheckHz = 10;
+}
+
+PresetMorph::PresetMorph (juce::AudioProcessorValueTreeState& apvts)
+    : state (apvts)
+{
+}
+
+PresetMorph::~PresetMorph()
+{
+    stopTimer();
+}
+
+//==============================================================================
+// Message thread
+
+PresetMorph::Preset PresetMorph::compile (const juce::ValueTree& tree, const juce::String& name) const
+{
+    Preset preset;
+    preset.name = name;
+
+    for (int i = 0; i < P::NumParameters; ++i)
+    {
+        auto index = static_cast<P::Index> (i);
+        if (! (kPresetFields & P::bit (index)))
+            continue;
+
+        auto param = tree.getChildWithProperty ("id", P::getParameterID (index));
+        if (! param.isValid() || ! param.hasProperty ("value"))
+            continue;
+
+        auto range = state.getParameterRange (P::getParameterID (index));
+        preset.values[static_cast<size_t> (i)] = range.snapToLegalValue (static_cast<float> (param.getProperty ("value")));
+        preset.fields |= P::bit (index);
+    }
+
+    return preset;
+}
+
+std::vector<PresetMorph::Preset> PresetMorph::createFactoryPresets() const
+{
+    std::vector<Preset> presets;
+
+    // The parameter defaults, so there is always a way back
+    juce::ValueTree defaults ("PARAMETERS");
+    for (int i = 0; i < P::NumParameters; ++i)
+    {
+        auto* id = P::getParameterID (static_cast<P::Index> (i));
+        if (auto* param = state.getParameter (id))
+        {
+            juce::ValueTree child ("PARAM");
+            child.setProperty ("id", id, nullptr);
+            child.setProperty ("value", param->convertFrom0to1 (param->getDefaultValue()), nullptr);
+            defaults.appendChild (child, nullptr);
+        }
+    }
+
+    presets.push_back (compile (defaults, "Open Water"));
+
+    for (const auto& factory : kFactoryPresets)
+    {
+        juce::ValueTree tree ("PARAMETERS");
+
+        for (const auto& v : factory.values)
+        {
+            juce::ValueTree child ("PARAM");
+            child.setProperty ("id", v.id, nullptr);
+            child.setProperty ("value", v.value, nullptr);
+            tree.appendChild (child, nullptr);
+        }
+
+        presets.push_back (compile (tree, factory.name));
+    }
+
+    return presets;
+}
+
+void PresetMorph::morphTo (const Preset& target, double seconds)
+{
+    publish (target, juce::jmax (0.0, seconds), false);
+    startTimerHz (kCommitCheckHz);
+}
+
+void PresetMorph::replay (const Preset& target, double seconds, bool release)
+{
+    publish (target, seconds, release);
+}
+
+void PresetMorph::publish (const Preset& target, double seconds, bool release)
+{
+    auto next = std::make_unique<Morph>();
+    next->target = target;
+    next->seconds = seconds;
+    next->generation = ++generation;
+    next->release = release;
+    morph.publish (std::move (next));
+}
+
+void PresetMorph::timerCallback()
+{
+    // Wait for the processor's snapshot to arrive at the preset
+    if (arrivedGeneration.load() != generation)
+        return;
+
+    const auto* live = morph.peek();
+    if (live != nullptr && ! live->release)
+    {
+        auto target = live->target;
+        commit (target);
+
+        // Hand the fields back: the host values now match the overrides
+        publish (target, 0.0, true);
+    }
+
+    committedGeneration.store (generation);
+    stopTimer();
+}
+
+void PresetMorph::commit (const Preset& target)
+{
+    for (int i = 0; i < P::NumParameters; ++i)
+    {
+        auto index = static_cast<P::Index> (i);
+        if (! (target.fields & P::bit (index)))
+            continue;
+
+        if (auto* param = state.getParameter (P::getParameterID (index)))
+        {
+            param->beginChangeGesture();
+            param->setValueNotifyingHost (param->convertTo0to1 (target.values[static_cast<size_t> (i)]));
+            param->endChangeGesture();
+        }
+    }
+}
+
+//==============================================================================
+// Audio threads
+
+void PresetMorph::prepare (double newSampleRate)
+{
+    sampleRate.store (newSampleRate);
+}
+
+PresetMorph::P::Mask PresetMorph::process (P& params, int numSamples, int readerIndex) noexcept
+{
+    auto& r = readers[static_cast<size_t> (readerIndex)];
+    P::Mask moved = 0;
+    r.started = {};
+
+    // A field the host moved has left the morph
+    auto overridden = params.getOverridden();
+    r.fields &= ~(r.applied & ~overridden);
+    r.applied &= overridden;
+
+    if (r.fields == 0)
+        arrive (r, readerIndex);
+
+    const auto* m = morph.acquire (readerIndex);
+    if (m == nullptr)
+        return 0;
+
+    if (m->generation != r.generation)
+    {
+        r.generation = m->generation;
+        r.started = { &m->target, m->seconds, m->release };
+
+        if (m->release)
+        {
+            for (int i = 0; i < P::NumParameters; ++i)
+                if (r.applied & P::bit (static_cast<P::Index> (i)))
+                    moved |= params.releaseOverride (static_cast<P::Index> (i));
+
+            r.fields = 0;
+            r.applied = 0;
+            return moved;
+        }
+
+        // Start from wherever this snapshot is, mid-morph included
+        for (int i = 0; i < P::NumParameters; ++i)
+            r.from[static_cast<size_t> (i)] = params.getBase (static_cast<P::Index> (i));
+
+        r.fields = m->target.fields;
+        r.elapsed = 0.0;
+        r.tickCountdown = 0;
+        r.arrived = false;
+    }
+
+    if (r.fields == 0)
+    {
+        arrive (r, readerIndex);
+        return moved;
+    }
+
+    r.elapsed += numSamples / sampleRate.load (std::memory_order_relaxed);
+
+    // Move once per control tick
+    r.tickCountdown -= numSamples;
+    if (r.tickCountdown > 0)
+        return 0;
+
+    while (r.tickCountdown <= 0)
+        r.tickCountdown += kControlInterval;
+
+    double x = m->seconds > 0.0 ? juce::jmin (1.0, r.elapsed / m->seconds) : 1.0;
+    float eased = static_cast<float> (x * x * (3.0 - 2.0 * x));
+
+    for (int i = 0; i < P::NumParameters; ++i)
+    {
+        auto index = static_cast<P::Index> (i);
+        if (! (r.fields & P::bit (index)))
+            continue;
+
+        float from = r.from[static_cast<size_t> (i)];
+        float to = m->target.values[static_cast<size_t> (i)];
+        float value;
+
+        if (kSteppedFields & P::bit (index) || x >= 1.0)
+        {
+            value = x < 0.5 ? from : to;
+        }
+        else
+        {
+            const auto& range = params.getRange (index);
+            float a = range.convertTo0to1 (from);
+            float b = range.convertTo0to1 (to);
+            value = range.convertFrom0to1 (a + (b - a) * eased);
+        }
+
+        moved |= params.setOverride (index, value);
+        r.applied |= P::bit (index);
+    }
+
+    // Arrived: hold the preset until the host takes it over
+    if (x >= 1.0)
+    {
+        r.fields = 0;
+        arrive (r, readerIndex);
+    }
+
+    return moved;
+}
+
+void PresetMorph::arrive (Reader& r, int readerIndex) noexcept
+{
+    if (r.arrived)
+        return;
+
+    r.arrived = true;
+
+    if (readerIndex == 0)
+        arrivedGeneration.store (r.generation);
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "AtomicSnapshot.h"
+#include "ParameterSnapshot.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+/**
+ * PresetMorph — Glides the musical parameters from wherever they are to a preset.
+ *
+ * A preset is compiled once, on the message thread, into an immutable
+ * array of legal plain values for the ParameterSnapshot fields it sets.
+ * Starting a morph publishes the target and its duration (seconds to hours)
+ * with one pointer swap. Each reader (the processor's snapshot and the
+ * lookahead's) takes the morph up on its next block, starting from its own
+ * base values, and moves its snapshot along it once per control tick with
+ * setOverride(): continuous fields ease through their normalised range,
+ * choices and switches change halfway. The audio side neither allocates nor
+ * locks.
+ *
+ * Nothing is written to the APVTS while the morph runs, so the host and
+ * the editor see no burst of parameter changes. When the processor's
+ * reader arrives, a message-thread timer writes the preset into the APVTS
+ * and releases the overrides, which by then match the host values. A field
+ * the host moves during a morph leaves it.
+ */
+class PresetMorph : private juce::Timer
+{
+public:
+    using P = ParameterSnapshot;
+
+    static constexpr int kNumReaders = 2;                 // The processor's and the lookahead's snapshot
+    static constexpr int kControlInterval = 64;           // Samples per morph step
+
+    /** A compiled preset: plain values for the fields in the mask. */
+    struct Preset
+    {
+        juce::String name;
+        std::array<float, P::NumParameters> values {};
+        P::Mask fields = 0;
+    };
+
+    /** Fields a preset carries: the sound and the generator's character,
+        not routing, output or timing. */
+    static constexpr P::Mask kPresetFields =
+        P::bit (P::Heading) | P::bit (P::Chart) | P::bit (P::Shanty) | P::bit (P::Trim)
+        | P::bit (P::Crew) | P::bit (P::Flotsam) | P::bit (P::Current) | P::bit (P::Doldrums)
+        | P::bit (P::Gale) | P::bit (P::Shallows) | P::bit (P::Depths) | P::bit (P::Sargasso)
+        | P::bit (P::Leeward) | P::bit (P::Berth) | P::bit (P::Maelstrom) | P::bit (P::DroneMode)
+        | P::bit (P::Cargo) | P::bit (P::Wake);
+
+    /** Fields that switch halfway through a morph instead of gliding. */
+    static constexpr P::Mask kSteppedFields =
+        P::bit (P::Heading) | P::bit (P::Chart) | P::bit (P::Shanty) | P::bit (P::DroneMode);
+
+    explicit PresetMorph (juce::AudioProcessorValueTreeState& apvts);
+    ~PresetMorph() override;
+
+    //==============================================================================
+    // Message thread
+
+    /** Compile a saved plugin state (or any tree of PARAM id/value children). */
+    Preset compile (const juce::ValueTree& state, const juce::String& name) const;
+
+    /** The built-in presets, compiled. */
+    std::vector<Preset> createFactoryPresets() const;
+
+    /** Start morphing to a preset over the given time (0 = at the next control tick). */
+    void morphTo (const Preset& target, double seconds);
+
+    bool isMorphing() const noexcept { return committedGeneration.load() != generation; }
+
+    /** Start a morph without committing it at the end (replaying a journal,
+        where the commit arrives as host values and the release follows). */
+    void replay (const Preset& target, double seconds, bool release);
+
+    //==============================================================================
+    // Audio threads
+
+    void prepare (double sampleRate);
+
+    /** Move a snapshot along the morph (after its update()). Returns the
+        fields whose effective values moved. */
+    P::Mask process (P& params, int numSamples, int reader) noexcept;
+
+    /** No morph under way and no field held (as of the reader's last block). */
+    bool isIdle (int reader) const noexcept
+    {
+        const auto& r = readers[static_cast<size_t> (reader)];
+        return r.fields == 0 && r.applied == 0;
+    }
+
+    /** The morph a reader took up in its last process() call, for the
+        journal. The target is null if it took none up; valid until its
+        next call. */
+    struct Started
+    {
+        const Preset* target = nullptr;
+        double seconds = 0.0;
+        bool release = false;
+    };
+
+    Started getStarted (int reader) const noexcept { return readers[static_cast<size_t> (reader)].started; }
+
+private:
+    struct Morph
+    {
+        Preset target;
+        double seconds = 0.0;
+        juce::uint32 generation = 0;
+        bool release = false;         // Hand the fields back to the host
+    };
+
+    struct Reader
+    {
+        juce::uint32 generation = 0;
+        std::array<float, P::NumParameters> from {};
+        P::Mask fields = 0;           // Still following the morph
+        P::Mask applied = 0;          // Overridden so far
+        double elapsed = 0.0;
+        int tickCountdown = 0;
+        bool arrived = true;
+        Started started;
+    };
+
+    juce::AudioProcessorValueTreeState& state;
+    AtomicSnapshot<Morph, kNumReaders> morph;
+    std::array<Reader, kNumReaders> readers;
+    std::atomic<double> sampleRate { 44100.0 };
+
+    // The processor's reader reports the morph it finished
+    std::atomic<juce::uint32> arrivedGeneration { 0 };
+
+    // Message thread
+    juce::uint32 generation = 0;
+    std::atomic<juce::uint32> committedGeneration { 0 };
+
+    void arrive (Reader& reader, int readerIndex) noexcept;
+
+    void timerCallback() override;
+    void commit (const Preset& target);
+    void publish (const Preset& target, double seconds, bool release);
+
+    JUCE_DECLARE_NON_COPYABLE (PresetMorph)
+};
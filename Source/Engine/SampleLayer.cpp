@@ -0,0 +1,527 @@
+#include "SampleLayer.h"
+#include <cmath>
+
+namespace
+{
+    constexpr int kStreamChunkFrames = 4096;
+    constexpr float kAttackSeconds = 0.005f;
+    constexpr float kReleaseSeconds = 2.5f;
+}
+
+SampleLayer::SampleLayer()
+{
+    sourcePitchBend.fill (1.0);
+    formatManager.registerBasicFormats();
+
+    ioThread.addTimeSliceClient (this);
+    ioThread.startThread (juce::Thread::Priority::high);
+}
+
+SampleLayer::~SampleLayer()
+{
+    ioThread.removeTimeSliceClient (this);
+    ioThread.stopThread (2000);
+}
+
+void SampleLayer::prepare (double newSampleRate, int /*blockSize*/)
+{
+    sampleRate = newSampleRate;
+    reset();
+}
+
+void SampleLayer::reset()
+{
+    stopAllVoices();
+    sourcePitchBend.fill (1.0);
+}
+
+void SampleLayer::loadInstrumentAsync (const juce::File& folder)
+{
+    const juce::ScopedLock sl (pendingLock);
+    pendingFolder = folder;
+    requestedFolder = folder;
+    loadPending = true;
+}
+
+juce::File SampleLayer::getInstrumentFolder() const
+{
+    const juce::ScopedLock sl (pendingLock);
+    return requestedFolder;
+}
+
+void SampleLayer::setLevel (float newLevel)
+{
+    level = juce::jlimit (0.0f, 1.0f, newLevel);
+}
+
+//==============================================================================
+// Audio thread
+
+void SampleLayer::processBlock (juce::AudioBuffer<float>& audioBuffer,
+                                 const DriftEventQueue& events)
+{
+    // Pick up a newly loaded instrument; voices of the old one cannot outlive it
+    auto* current = instrument.acquire (kAudioReader);
+    if (current != audioInstrument)
+    {
+        stopAllVoices();
+        audioInstrument = current;
+    }
+
+    if (audioInstrument == nullptr)
+        return;
+
+    for (const auto& e : events)
+    {
+        switch (e.type)
+        {
+            case DriftEvent::NoteOn:
+                noteOn (e.voice, e.note, static_cast<float> (e.velocity) / 127.0f);
+                break;
+
+            case DriftEvent::NoteOff:
+                noteOff (e.voice, e.note);
+                break;
+
+            case DriftEvent::Bend:
+                if (juce::isPositiveAndBelow (static_cast<int> (e.voice), kMaxSources))
+                    sourcePitchBend[static_cast<size_t> (e.voice)] = std::pow (2.0, static_cast<double> (e.cents) / 1200.0);
+                break;
+        }
+    }
+
+    auto numSamples = audioBuffer.getNumSamples();
+    auto numChannels = audioBuffer.getNumChannels();
+    if (numChannels == 0)
+        return;
+
+    float* outL = audioBuffer.getWritePointer (0);
+    float* outR = audioBuffer.getWritePointer (numChannels > 1 ? 1 : 0);
+    float panGain = numChannels > 1 ? 1.0f : 0.5f;
+
+    float attackStep  = 1.0f / (kAttackSeconds * static_cast<float> (sampleRate));
+    float releaseStep = 1.0f / (kReleaseSeconds * static_cast<float> (sampleRate));
+
+    for (auto& v : voices)
+    {
+        if (v.zone == nullptr)
+            continue;
+
+        // Only consume the ring once the streamer has acknowledged this note
+        bool streaming = v.readyGen.load (std::memory_order_acquire)
+                         == v.requestGen.load (std::memory_order_relaxed);
+
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0, available = 0, consumed = 0;
+        if (streaming)
+        {
+            available = v.fifo.getNumReady();
+            v.fifo.prepareToRead (available, start1, size1, start2, size2);
+        }
+
+        const float* ringData[2] = { v.ring.getReadPointer (0), v.ring.getReadPointer (1) };
+
+        double step = v.ratio;
+        if (juce::isPositiveAndBelow (v.source, kMaxSources))
+            step *= sourcePitchBend[static_cast<size_t> (v.source)];
+
+        float gain = v.gain * level * panGain;
+        bool finished = false;
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            if (! v.releasing)
+                v.envelope = juce::jmin (1.0f, v.envelope + attackStep);
+            else
+                v.envelope -= releaseStep;
+
+            if (v.envelope <= 0.0f)
+            {
+                finished = true;
+                break;
+            }
+
+            auto t = static_cast<float> (v.frac);
+            float l = v.frameA[0] + (v.frameB[0] - v.frameA[0]) * t;
+            float r = v.frameA[1] + (v.frameB[1] - v.frameA[1]) * t;
+
+            float g = gain * v.envelope;
+            outL[sample] += l * g;
+            outR[sample] += r * g;
+
+            v.frac += step;
+            while (v.frac >= 1.0)
+            {
+                v.frac -= 1.0;
+                v.frameA[0] = v.frameB[0];
+                v.frameA[1] = v.frameB[1];
+
+                if (! fetchFrame (v, v.frameB, ringData, start1, size1, start2, consumed, available))
+                {
+                    finished = true;
+                    break;
+                }
+            }
+
+            if (finished)
+                break;
+        }
+
+        if (consumed > 0)
+            v.fifo.finishedRead (consumed);
+
+        if (finished)
+        {
+            v.zone = nullptr;
+            v.note = -1;
+            requestStream (v, -1, 0);
+        }
+    }
+}
+
+bool SampleLayer::fetchFrame (StreamVoice& v, float* frame, const float* const* ringData,
+                               int ringStart1, int ringSize1, int ringStart2,
+                               int& ringConsumed, int ringAvailable)
+{
+    if (v.nextFrame >= v.zone->lengthFrames)
+        return false;
+
+    if (v.nextFrame < v.zone->headFrames)
+    {
+        auto idx = static_cast<int> (v.nextFrame);
+        frame[0] = v.zone->head.getSample (0, idx);
+        frame[1] = v.zone->head.getSample (1, idx);
+        ++v.nextFrame;
+        return true;
+    }
+
+    if (ringConsumed < ringAvailable)
+    {
+        int idx = (ringConsumed < ringSize1) ? ringStart1 + ringConsumed
+                                             : ringStart2 + (ringConsumed - ringSize1);
+        frame[0] = ringData[0][idx];
+        frame[1] = ringData[1][idx];
+        ++ringConsumed;
+        ++v.nextFrame;
+        return true;
+    }
+
+    // Underrun: hold the position until the streamer catches up
+    frame[0] = 0.0f;
+    frame[1] = 0.0f;
+    return true;
+}
+
+void SampleLayer::noteOn (int source, int note, float velocity)
+{
+    int band = juce::jlimit (0, kVelocityBands - 1, static_cast<int> (velocity * 127.0f) / (128 / kVelocityBands));
+    int zoneIndex = audioInstrument->keymap[static_cast<size_t> (note)][static_cast<size_t> (band)];
+    if (zoneIndex < 0)
+        return;
+
+    // Free voice first, then the oldest releasing one, then the oldest overall
+    StreamVoice* target = nullptr;
+    for (auto& v : voices)
+    {
+        if (v.zone == nullptr)
+        {
+            target = &v;
+            break;
+        }
+    }
+
+    for (int pass = 0; pass < 2 && target == nullptr; ++pass)
+    {
+        for (auto& v : voices)
+        {
+            if (pass == 0 && ! v.releasing)
+                continue;
+
+            if (target == nullptr || v.startedAt < target->startedAt)
+                target = &v;
+        }
+    }
+
+    auto& v = *target;
+    const auto& zone = audioInstrument->zones[static_cast<size_t> (zoneIndex)];
+
+    v.zone = &zone;
+    v.source = source;
+    v.note = note;
+    v.gain = velocity;
+    v.envelope = 0.0f;
+    v.releasing = false;
+    v.startedAt = ++noteCounter;
+    v.ratio = zone.fileSampleRate / sampleRate
+              * std::pow (2.0, static_cast<double> (note - zone.rootNote) / 12.0);
+
+    // Heads always hold at least two frames
+    v.frac = 0.0;
+    v.frameA[0] = zone.head.getSample (0, 0);
+    v.frameA[1] = zone.head.getSample (1, 0);
+    v.frameB[0] = zone.head.getSample (0, 1);
+    v.frameB[1] = zone.head.getSample (1, 1);
+    v.nextFrame = 2;
+
+    requestStream (v, zoneIndex, zone.headFrames);
+}
+
+void SampleLayer::noteOff (int source, int note)
+{
+    for (auto& v : voices)
+        if (v.zone != nullptr && v.note == note && v.source == source)
+            v.releasing = true;
+}
+
+void SampleLayer::stopAllVoices()
+{
+    for (auto& v : voices)
+    {
+        v.zone = nullptr;
+        v.note = -1;
+        requestStream (v, -1, 0);
+    }
+}
+
+void SampleLayer::requestStream (StreamVoice& v, int zoneIndex, juce::int64 startFrame)
+{
+    v.streamInstrument.store (zoneIndex >= 0 ? audioInstrument : nullptr, std::memory_order_relaxed);
+    v.streamZone.store (zoneIndex, std::memory_order_relaxed);
+    v.streamStart.store (startFrame, std::memory_order_relaxed);
+    v.requestGen.store (v.requestGen.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//==============================================================================
+// I/O thread
+
+int SampleLayer::useTimeSlice()
+{
+    juce::File folderToLoad;
+    bool shouldLoad = false;
+
+    {
+        const juce::ScopedLock sl (pendingLock);
+        std::swap (shouldLoad, loadPending);
+        folderToLoad = pendingFolder;
+    }
+
+    if (shouldLoad)
+        instrument.publish (loadInstrument (folderToLoad));
+
+    auto* current = instrument.acquire (kIoReader);
+
+    bool busy = false;
+    for (auto& v : voices)
+        busy = streamVoice (v, current) || busy;
+
+    instrument.collectGarbage();
+
+    return busy ? 1 : 5;
+}
+
+bool SampleLayer::streamVoice (StreamVoice& v, const Instrument* current)
+{
+    auto gen = v.requestGen.load (std::memory_order_acquire);
+
+    if (gen != v.ioGen)
+    {
+        auto* inst = v.streamInstrument.load (std::memory_order_relaxed);
+        int zoneIndex = v.streamZone.load (std::memory_order_relaxed);
+        auto start = v.streamStart.load (std::memory_order_relaxed);
+
+        // The audio thread re-triggered while we were reading: pick it up next slice
+        if (v.requestGen.load (std::memory_order_acquire) != gen)
+            return true;
+
+        v.ioGen = gen;
+        v.fifo.reset();
+        v.ioInstrument = inst;
+        v.ioZone = (inst != nullptr && inst == current
+                    && juce::isPositiveAndBelow (zoneIndex, static_cast<int> (inst->zones.size())))
+                     ? &inst->zones[static_cast<size_t> (zoneIndex)] : nullptr;
+        v.ioFrame = start;
+        v.readyGen.store (gen, std::memory_order_release);
+    }
+
+    if (v.ioZone == nullptr)
+        return false;
+
+    // Instrument replaced underneath this voice
+    if (v.ioInstrument != current)
+    {
+        v.ioZone = nullptr;
+        return false;
+    }
+
+    auto remaining = v.ioZone->lengthFrames - v.ioFrame;
+    int toRead = static_cast<int> (juce::jmin (static_cast<juce::int64> (juce::jmin (v.fifo.getFreeSpace(), kStreamChunkFrames)),
+                                               remaining));
+    if (toRead <= 0)
+        return false;
+
+    int start1, size1, start2, size2;
+    v.fifo.prepareToWrite (toRead, start1, size1, start2, size2);
+
+    if (size1 > 0)
+        v.ioZone->reader->read (&v.ring, start1, size1, v.ioFrame, true, true);
+    if (size2 > 0)
+        v.ioZone->reader->read (&v.ring, start2, size2, v.ioFrame + size1, true, true);
+
+    v.fifo.finishedWrite (size1 + size2);
+    v.ioFrame += size1 + size2;
+
+    return true;
+}
+
+std::unique_ptr<SampleLayer::Instrument> SampleLayer::loadInstrument (const juce::File& folder)
+{
+    if (! folder.isDirectory())
+        return nullptr;
+
+    auto inst = std::make_unique<Instrument>();
+    inst->folder = folder;
+
+    auto files = folder.findChildFiles (juce::File::findFiles, false, "*.wav;*.flac");
+    std::sort (files.begin(), files.end());
+
+    for (auto& file : files)
+    {
+        Zone zone;
+        zone.rootNote = parseRootNote (file.getFileNameWithoutExtension(), zone.velocityCeiling);
+        if (zone.rootNote < 0)
+            continue;
+
+        zone.reader = openReader (file);
+        if (zone.reader == nullptr || zone.reader->lengthInSamples < 2)
+            continue;
+
+        zone.lengthFrames = zone.reader->lengthInSamples;
+        zone.fileSampleRate = zone.reader->sampleRate;
+        inst->zones.push_back (std::move (zone));
+
+        // Even the shortest heads would overrun the budget
+        if (inst->zones.size() > static_cast<size_t> (kMaxZones))
+            return nullptr;
+    }
+
+    if (inst->zones.empty())
+        return nullptr;
+
+    // Heads share a fixed RAM budget, so memory stays bounded however large the library is
+    // (at most kMaxZones zones, each at least kMinHeadFrames)
+    auto zoneCount = static_cast<juce::int64> (inst->zones.size());
+    auto budgetFrames = kPreloadBudgetBytes / (zoneCount * 2 * static_cast<juce::int64> (sizeof (float)));
+    int headFrames = static_cast<int> (juce::jlimit (static_cast<juce::int64> (kMinHeadFrames),
+                                                     static_cast<juce::int64> (kMaxHeadFrames),
+                                                     budgetFrames));
+
+    for (auto& zone : inst->zones)
+    {
+        zone.headFrames = static_cast<int> (juce::jmin (static_cast<juce::int64> (headFrames), zone.lengthFrames));
+        zone.head.setSize (2, zone.headFrames);
+        zone.reader->read (&zone.head, 0, zone.headFrames, 0, true, true);
+    }
+
+    // Keymap: the lowest velocity layer that covers each band, nearest root within it
+    for (int band = 0; band < kVelocityBands; ++band)
+    {
+        int bandTop = (band + 1) * (128 / kVelocityBands) - 1;
+
+        int layerCeiling = -1;
+        for (auto& zone : inst->zones)
+            if (zone.velocityCeiling >= bandTop && (layerCeiling < 0 || zone.velocityCeiling < layerCeiling))
+                layerCeiling = zone.velocityCeiling;
+
+        if (layerCeiling < 0)
+            for (auto& zone : inst->zones)
+                layerCeiling = juce::jmax (layerCeiling, zone.velocityCeiling);
+
+        for (int note = 0; note < 128; ++note)
+        {
+            int best = -1;
+            int bestDistance = 1000;
+
+            for (int z = 0; z < static_cast<int> (inst->zones.size()); ++z)
+            {
+                auto& zone = inst->zones[static_cast<size_t> (z)];
+                if (zone.velocityCeiling != layerCeiling)
+                    continue;
+
+                int distance = std::abs (zone.rootNote - note);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = z;
+                }
+            }
+
+            inst->keymap[static_cast<size_t> (note)][static_cast<size_t> (band)] = static_cast<juce::int16> (best);
+        }
+    }
+
+    return inst;
+}
+
+std::unique_ptr<juce::AudioFormatReader> SampleLayer::openReader (const juce::File& file)
+{
+    // Memory-map wherever the format allows it (uncompressed WAV); FLAC streams through a normal reader
+    if (auto* format = formatManager.findFormatForFileExtension (file.getFileExtension()))
+    {
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (file));
+
+        if (mapped != nullptr && mapped->mapEntireFile())
+            return mapped;
+    }
+
+    return std::unique_ptr<juce::AudioFormatReader> (formatManager.createReaderFor (file));
+}
+
+int SampleLayer::parseRootNote (const juce::String& fileName, int& velocityCeiling)
+{
+    static const int pitchClasses[] = { 9, 11, 0, 2, 4, 5, 7 };   // A B C D E F G
+
+    auto tokens = juce::StringArray::fromTokens (fileName, " _-.", "");
+    int root = -1;
+
+    for (auto& token : tokens)
+    {
+        auto lower = token.toLowerCase();
+
+        // Velocity ceiling: v80, vel80
+        if (lower.startsWithChar ('v') && lower.retainCharacters ("0123456789").isNotEmpty()
+            && lower.removeCharacters ("0123456789").containsOnly ("vel"))
+        {
+            velocityCeiling = juce::jlimit (1, 127, lower.retainCharacters ("0123456789").getIntValue());
+            continue;
+        }
+
+        // Bare MIDI note number
+        if (token.containsOnly ("0123456789"))
+        {
+            int n = token.getIntValue();
+            if (n >= 0 && n <= 127)
+                root = n;
+            continue;
+        }
+
+        // Note name: letter, optional accidental, octave (may be negative)
+        auto letter = lower[0];
+        if (letter < 'a' || letter > 'g' || token.length() < 2)
+            continue;
+
+        int pc = pitchClasses[letter - 'a'];
+        int pos = 1;
+
+        if (token[pos] == '#')      { ++pc; ++pos; }
+        else if (token[pos] == 'b') { --pc; ++pos; }
+
+        auto octaveText = token.substring (pos);
+        if (octaveText.isEmpty() || ! octaveText.containsOnly ("-0123456789"))
+            continue;
+
+        int n = (octaveText.getIntValue() + 1) * 12 + pc;
+        if (n >= 0 && n <= 127)
+            root = n;
+    }
+
+    return root;
+}
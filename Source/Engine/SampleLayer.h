@@ -0,0 +1,146 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "AtomicSnapshot.h"
+#include "DriftEvent.h"
+#include <array>
+#include <vector>
+
+/**
+ * SampleLayer — Disk-streaming multisample playback for the generated notes.
+ *
+ * Loads a folder of WAV/FLAC files as one instrument. WAV files are
+ * memory-mapped, so even multi-gigabyte libraries open almost instantly.
+ * Only the head of each zone is copied into RAM; the rest is streamed by a
+ * background I/O thread into per-voice lock-free ring buffers. The audio
+ * thread reads RAM only and never touches the disk. The heads share a
+ * fixed RAM budget; a folder with more zones than fit is not loaded.
+ *
+ * Zones are laid out from file names: a note name (C3, F#2, Bb4 — C4 = 60)
+ * or a bare MIDI note number, optionally with a velocity ceiling ("_v80").
+ * Keys between two roots are split halfway.
+ */
+class SampleLayer : private juce::TimeSliceClient
+{
+public:
+    static constexpr int kMaxStreamVoices = 24;
+    static constexpr int kMaxSources = DriftEvent::kMaxVoices;   // Generative voices that can send events
+    static constexpr int kRingFrames = 1 << 15;          // ~0.7 s of streaming headroom at 48 kHz
+    static constexpr int kMaxHeadFrames = 1 << 14;       // Resident frames per zone
+    static constexpr int kMinHeadFrames = 1 << 12;
+    static constexpr juce::int64 kPreloadBudgetBytes = 256ll * 1024 * 1024;
+
+    // Zones whose minimum heads fit the budget; larger instruments are refused
+    static constexpr int kMaxZones = static_cast<int> (kPreloadBudgetBytes / (kMinHeadFrames * 2 * static_cast<juce::int64> (sizeof (float))));
+
+    SampleLayer();
+    ~SampleLayer() override;
+
+    void prepare (double sampleRate, int blockSize);
+    void reset();
+
+    /** Load a sample folder on the I/O thread (call from the message thread). */
+    void loadInstrumentAsync (const juce::File& folder);
+
+    /** The folder of the last requested instrument (message thread). */
+    juce::File getInstrumentFolder() const;
+
+    /** Output gain of the layer (0–1). */
+    void setLevel (float level);
+
+    /** Process note events and add the sampled voices into the buffer. */
+    void processBlock (juce::AudioBuffer<float>& audioBuffer,
+                       const DriftEventQueue& events);
+
+private:
+    static constexpr int kVelocityBands = 8;
+
+    struct Zone
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader;   // I/O thread only
+        juce::AudioBuffer<float> head;                     // Resident first frames
+        int headFrames = 0;
+        juce::int64 lengthFrames = 0;
+        double fileSampleRate = 44100.0;
+        int rootNote = 60;
+        int velocityCeiling = 127;
+    };
+
+    struct Instrument
+    {
+        juce::File folder;
+        std::vector<Zone> zones;
+
+        // Zone index per [note][velocity band], -1 if unmapped
+        std::array<std::array<juce::int16, kVelocityBands>, 128> keymap;
+    };
+
+    struct StreamVoice
+    {
+        // Audio thread
+        const Zone* zone = nullptr;
+        int source = 0;
+        int note = -1;
+        float gain = 0.0f;
+        float envelope = 0.0f;
+        bool releasing = false;
+        double ratio = 1.0;
+        double frac = 0.0;
+        juce::int64 nextFrame = 0;    // Next file frame to fetch
+        float frameA[2] = {};
+        float frameB[2] = {};
+        juce::uint32 startedAt = 0;
+
+        // Hand-off to the I/O thread: fields are written before requestGen
+        std::atomic<const Instrument*> streamInstrument { nullptr };
+        std::atomic<int> streamZone { -1 };
+        std::atomic<juce::int64> streamStart { 0 };
+        std::atomic<juce::uint32> requestGen { 0 };
+        std::atomic<juce::uint32> readyGen { 0 };
+
+        // Single-producer / single-consumer ring (I/O thread writes, audio thread reads)
+        juce::AudioBuffer<float> ring { 2, kRingFrames };
+        juce::AbstractFifo fifo { kRingFrames };
+
+        // I/O thread
+        juce::uint32 ioGen = 0;
+        const Instrument* ioInstrument = nullptr;
+        const Zone* ioZone = nullptr;
+        juce::int64 ioFrame = 0;
+    };
+
+    // Reader slots in the instrument snapshot
+    enum { kAudioReader = 0, kIoReader = 1 };
+
+    double sampleRate = 44100.0;
+    float level = 0.8f;
+    juce::uint32 noteCounter = 0;
+
+    std::array<StreamVoice, kMaxStreamVoices> voices;
+    std::array<double, kMaxSources> sourcePitchBend;
+    const Instrument* audioInstrument = nullptr;
+
+    AtomicSnapshot<Instrument, 2> instrument;
+    juce::TimeSliceThread ioThread { "CaptainDrift sample streamer" };
+    juce::AudioFormatManager formatManager;
+
+    juce::CriticalSection pendingLock;
+    juce::File pendingFolder, requestedFolder;
+    bool loadPending = false;
+
+    int useTimeSlice() override;
+    bool streamVoice (StreamVoice& voice, const Instrument* current);
+    std::unique_ptr<Instrument> loadInstrument (const juce::File& folder);
+    std::unique_ptr<juce::AudioFormatReader> openReader (const juce::File& file);
+
+    void noteOn (int source, int note, float velocity);
+    void noteOff (int source, int note);
+    void stopAllVoices();
+    void requestStream (StreamVoice& voice, int zoneIndex, juce::int64 startFrame);
+    bool fetchFrame (StreamVoice& voice, float* frame, const float* const* ringData,
+                     int ringStart1, int ringSize1, int ringStart2, int& ringConsumed, int ringAvailable);
+
+    static int parseRootNote (const juce::String& fileName, int& velocityCeiling);
+
+    JUCE_DECLARE_NON_COPYABLE (SampleLayer)
+};
@@ -0,0 +1,274 @@
+#include "ScalaTuning.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Lines that aren't comments ("!" in the first column)
+    juce::StringArray contentLines (const juce::String& text)
+    {
+        juce::StringArray lines;
+        lines.addLines (text);
+
+        juce::StringArray content;
+        for (auto& line : lines)
+            if (! line.startsWithChar ('!'))
+                content.add (line);
+
+        return content;
+    }
+
+    // First whitespace-separated token of a line
+    juce::String firstToken (const juce::String& line)
+    {
+        return line.trim().upToFirstOccurrenceOf (" ", false, false)
+                          .upToFirstOccurrenceOf ("\t", false, false);
+    }
+
+    bool parseInt (const juce::String& line, int& value)
+    {
+        auto token = firstToken (line);
+        if (token.isEmpty() || ! token.containsOnly ("-0123456789"))
+            return false;
+
+        value = token.getIntValue();
+        return true;
+    }
+
+    // A pitch line: cents if it has a decimal point, otherwise a ratio "a/b" or "a"
+    bool parsePitch (const juce::String& line, double& cents)
+    {
+        auto token = firstToken (line);
+        if (token.isEmpty())
+            return false;
+
+        if (token.containsChar ('.'))
+        {
+            if (! token.containsOnly ("-+0123456789."))
+                return false;
+
+            cents = token.getDoubleValue();
+            return true;
+        }
+
+        if (! token.containsOnly ("0123456789/"))
+            return false;
+
+        double numerator = token.upToFirstOccurrenceOf ("/", false, false).getLargeIntValue();
+        double denominator = token.containsChar ('/')
+                               ? static_cast<double> (token.fromFirstOccurrenceOf ("/", false, false).getLargeIntValue())
+                               : 1.0;
+
+        if (numerator <= 0.0 || denominator <= 0.0)
+            return false;
+
+        cents = 1200.0 * std::log2 (numerator / denominator);
+        return true;
+    }
+
+    int floorDiv (int a, int b)
+    {
+        int q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    constexpr double kMidiNoteZeroHz = 8.175798915643707;   // C-1, 12-EDO at A4 = 440 Hz
+}
+
+bool ScalaTuning::parseScale (const juce::String& text, Scale& scale)
+{
+    auto lines = contentLines (text);
+
+    // Description (may be blank), note count, then one pitch per line
+    int numNotes = 0;
+    if (lines.size() < 2 || ! parseInt (lines[1], numNotes) || numNotes < 1 || lines.size() < 2 + numNotes)
+        return false;
+
+    scale.description = lines[0].trim();
+    scale.cents.clear();
+
+    for (int i = 0; i < numNotes; ++i)
+    {
+        double cents = 0.0;
+        if (! parsePitch (lines[2 + i], cents))
+            return false;
+
+        scale.cents.push_back (cents);
+    }
+
+    // The period has to go up, or the degrees never leave the first octave
+    return scale.cents.back() > 0.0;
+}
+
+bool ScalaTuning::parseKeyboardMapping (const juce::String& text, KeyboardMapping& mapping)
+{
+    auto lines = contentLines (text);
+    lines.removeEmptyStrings();
+
+    if (lines.size() < 7)
+        return false;
+
+    KeyboardMapping m;
+    if (! parseInt (lines[0], m.size) || ! parseInt (lines[1], m.firstNote) || ! parseInt (lines[2], m.lastNote)
+        || ! parseInt (lines[3], m.middleNote) || ! parseInt (lines[4], m.referenceNote)
+        || ! parseInt (lines[6], m.octaveDegree))
+        return false;
+
+    m.referenceFrequency = firstToken (lines[5]).getDoubleValue();
+
+    if (m.size < 0 || m.referenceFrequency <= 0.0 || m.octaveDegree < 0)
+        return false;
+
+    // Entries missing at the end are unmapped
+    for (int i = 0; i < m.size; ++i)
+    {
+        int degree = -1;
+        if (7 + i < lines.size() && ! firstToken (lines[7 + i]).startsWithIgnoreCase ("x")
+            && ! parseInt (lines[7 + i], degree))
+            return false;
+
+        m.mapping.push_back (degree);
+    }
+
+    mapping = std::move (m);
+    return true;
+}
+
+std::unique_ptr<ScaleQuantizer::Tuning> ScalaTuning::compile (const Scale& scale, const KeyboardMapping& mapping)
+{
+    auto numNotes = static_cast<int> (scale.cents.size());
+    if (numNotes == 0)
+        return nullptr;
+
+    double period = scale.cents.back();
+    int octaveDegree = mapping.octaveDegree > 0 ? mapping.octaveDegree : numNotes;
+
+    auto degreeCents = [&] (int degree)
+    {
+        int octave = floorDiv (degree, numNotes);
+        int index = degree - octave * numNotes;
+        return octave * period + (index == 0 ? 0.0 : scale.cents[static_cast<size_t> (index - 1)]);
+    };
+
+    // Scale degree of a key, or false if the key is unmapped
+    auto keyDegree = [&] (int key, int& degree)
+    {
+        int offset = key - mapping.middleNote;
+
+        if (mapping.size == 0)
+        {
+            degree = offset;
+            return true;
+        }
+
+        int octave = floorDiv (offset, mapping.size);
+        int entry = mapping.mapping[static_cast<size_t> (offset - octave * mapping.size)];
+
+        degree = entry + octave * octaveDegree;
+        return entry >= 0;
+    };
+
+    int referenceDegree = 0;
+    if (! keyDegree (mapping.referenceNote, referenceDegree))
+        return nullptr;
+
+    // Pitch of every mapped key, in cents above MIDI note 0
+    double base = 1200.0 * std::log2 (mapping.referenceFrequency / kMidiNoteZeroHz) - degreeCents (referenceDegree);
+
+    struct Key { double cents; int degree; };
+    std::vector<Key> keys;
+
+    for (int key = juce::jmax (0, mapping.firstNote); key <= juce::jmin (127, mapping.lastNote); ++key)
+    {
+        int degree = 0;
+        if (! keyDegree (key, degree))
+            continue;
+
+        double cents = base + degreeCents (degree);
+        if (cents > -50.0 && cents < 12750.0)
+            keys.push_back ({ cents, degree });
+    }
+
+    if (keys.empty())
+        return nullptr;
+
+    std::stable_sort (keys.begin(), keys.end(), [] (const Key& a, const Key& b) { return a.cents < b.cents; });
+
+    auto tuning = std::make_unique<ScaleQuantizer::Tuning>();
+    auto& t = tuning->table;
+    t.numNotes = static_cast<int> (keys.size());
+
+    for (int i = 0; i < t.numNotes; ++i)
+    {
+        auto note = juce::jlimit (0, 127, juce::roundToInt (keys[static_cast<size_t> (i)].cents / 100.0));
+        t.notes[i] = static_cast<juce::uint8> (note);
+        tuning->cents[static_cast<size_t> (i)] = static_cast<float> (keys[static_cast<size_t> (i)].cents - 100.0 * note);
+    }
+
+    // Same maps as the built-in tables; the nearest degree is nearest in pitch
+    int degree = 0;
+    for (int n = 0; n <= 128; ++n)
+    {
+        while (degree < t.numNotes && t.notes[degree] < n)
+            ++degree;
+
+        t.countBelow[n] = static_cast<juce::uint8> (degree);
+    }
+
+    for (int n = 0; n < 128; ++n)
+    {
+        int above = juce::jmin (static_cast<int> (t.countBelow[n]), t.numNotes - 1);
+        int below = juce::jmax (0, above - 1);
+
+        double target = 100.0 * n;
+        bool belowIsCloser = std::abs (keys[static_cast<size_t> (below)].cents - target)
+                          <= std::abs (keys[static_cast<size_t> (above)].cents - target);
+
+        // Both neighbours of the boundary can sit on the same MIDI note
+        int nearest = belowIsCloser ? below : above;
+        if (above + 1 < t.numNotes
+            && std::abs (keys[static_cast<size_t> (above + 1)].cents - target) < std::abs (keys[static_cast<size_t> (nearest)].cents - target))
+            nearest = above + 1;
+
+        t.nearestDegree[n] = static_cast<juce::uint8> (nearest);
+    }
+
+    // Degree classes count the mapped keys of one period, from the lowest tonic
+    int mappedPerPeriod = numNotes;
+    if (mapping.size > 0)
+    {
+        int mapped = 0;
+        for (int entry : mapping.mapping)
+            mapped += entry >= 0 ? 1 : 0;
+
+        // Only a mapping that repeats every octaveDegree degrees has classes
+        mappedPerPeriod = (octaveDegree == numNotes) ? juce::jmax (1, mapped) : numNotes;
+    }
+
+    t.notesPerOctave = juce::jmax (1, mappedPerPeriod);
+    t.rootDegree = 0;
+
+    for (int i = 0; i < t.numNotes; ++i)
+    {
+        if (((keys[static_cast<size_t> (i)].degree % numNotes) + numNotes) % numNotes == 0)
+        {
+            t.rootDegree = i;
+            break;
+        }
+    }
+
+    return tuning;
+}
+
+std::unique_ptr<ScaleQuantizer::Tuning> ScalaTuning::load (const juce::File& scaleFile, const juce::File& mappingFile)
+{
+    Scale scale;
+    if (! scaleFile.existsAsFile() || ! parseScale (scaleFile.loadFileAsString(), scale))
+        return nullptr;
+
+    KeyboardMapping mapping;
+    if (mappingFile.existsAsFile() && ! parseKeyboardMapping (mappingFile.loadFileAsString(), mapping))
+        return nullptr;
+
+    return compile (scale, mapping);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include "ScaleQuantizer.h"
+#include <memory>
+#include <vector>
+
+/**
+ * ScalaTuning — Reads Scala scale (.scl) and keyboard mapping (.kbm) files
+ * and compiles them into a ScaleQuantizer::Tuning.
+ *
+ * The scale may have any number of notes per period. The mapping decides
+ * which MIDI keys play which scale degrees and pins one key to a
+ * frequency; without one, consecutive keys play consecutive degrees with
+ * degree 0 on middle C (261.63 Hz). Every mapped key becomes a degree of
+ * the tuning: the nearest MIDI note to its pitch plus the cents left
+ * over, so the quantizer stays a table lookup.
+ *
+ * Parsing and compiling allocate, so they belong on the message thread.
+ */
+class ScalaTuning
+{
+public:
+    struct Scale
+    {
+        juce::String description;
+        std::vector<double> cents;      // Degrees 1..N in cents; the last is the period
+    };
+
+    struct KeyboardMapping
+    {
+        int size = 0;                   // 0 = linear: every key is the next degree
+        int firstNote = 0;
+        int lastNote = 127;
+        int middleNote = 60;            // Key of mapping entry 0
+        int referenceNote = 60;
+        double referenceFrequency = 261.6255653;
+        int octaveDegree = 0;           // Degree of the formal octave (0 = scale size)
+        std::vector<int> mapping;       // Degree of each entry, -1 = unmapped ("x")
+    };
+
+    /** Parse a .scl file. Returns false if it is malformed. */
+    static bool parseScale (const juce::String& text, Scale& scale);
+
+    /** Parse a .kbm file. Returns false if it is malformed. */
+    static bool parseKeyboardMapping (const juce::String& text, KeyboardMapping& mapping);
+
+    /** Build the quantizer tables. Returns nullptr if no key gets a playable pitch. */
+    static std::unique_ptr<ScaleQuantizer::Tuning> compile (const Scale& scale, const KeyboardMapping& mapping);
+
+    /** Read and compile a scale, with an optional mapping (a non-existent
+        file means the default mapping). Returns nullptr on any error. */
+    static std::unique_ptr<ScaleQuantizer::Tuning> load (const juce::File& scaleFile,
+                                                         const juce::File& mappingFile = {});
+};
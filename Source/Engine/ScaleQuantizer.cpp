@@ -1,5 +1,85 @@
 #include "ScaleQuantizer.h"
-#include <cmath>
+#include <array>
+#include <initializer_list>
+
+namespace
+{
+    // Pitch-class mask from intervals (semitones from root)
+    constexpr int maskOf (std::initializer_list<int> intervals)
+    {
+        int mask = 0;
+        for (int interval : intervals)
+            mask |= 1 << interval;
+        return mask;
+    }
+
+    constexpr int kScaleMasks[ScaleQuantizer::NumScales] =
+    {
+        maskOf ({ 0, 2, 4, 5, 7, 9, 11 }),                    // Major
+        maskOf ({ 0, 2, 3, 5, 7, 8, 10 }),                    // Minor
+        maskOf ({ 0, 2, 3, 5, 7, 9, 10 }),                    // Dorian
+        maskOf ({ 0, 2, 4, 5, 7, 9, 10 }),                    // Mixolydian
+        maskOf ({ 0, 2, 4, 7, 9 }),                           // Pentatonic
+        maskOf ({ 0, 2, 4, 6, 8, 10 }),                       // Whole tone
+        maskOf ({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 }),    // Chromatic
+        maskOf ({ 0, 1, 5, 7, 8 }),                           // In (陰): C Db F G Ab
+        maskOf ({ 0, 2, 3, 7, 8 })                            // Hirajoshi: C D Eb G Ab
+    };
+
+    constexpr ScaleQuantizer::NoteTable makeNoteTable (int scaleMask, int root)
+    {
+        ScaleQuantizer::NoteTable t {};
+
+        for (int n = 0; n < 128; ++n)
+        {
+            t.countBelow[n] = static_cast<juce::uint8> (t.numNotes);
+
+            int interval = (n - root + 120) % 12;
+            if ((scaleMask >> interval) & 1)
+                t.notes[t.numNotes++] = static_cast<juce::uint8> (n);
+        }
+
+        t.countBelow[128] = static_cast<juce::uint8> (t.numNotes);
+        t.notesPerOctave = t.countBelow[12];
+        t.rootDegree = t.countBelow[root];
+
+        // Nearest degree: compare the degree just below (or at) the note with
+        // the one above; equal distances resolve downwards
+        for (int n = 0; n < 128; ++n)
+        {
+            int above = t.countBelow[n];      // First degree with note >= n
+            int below = above - 1;
+
+            int nearest = above;
+            if (above >= t.numNotes)
+                nearest = below;
+            else if (t.notes[above] != n && below >= 0
+                     && n - t.notes[below] <= t.notes[above] - n)
+                nearest = below;
+
+            t.nearestDegree[n] = static_cast<juce::uint8> (nearest < 0 ? 0 : nearest);
+        }
+
+        return t;
+    }
+
+    using TableSet = std::array<std::array<ScaleQuantizer::NoteTable, 12>, ScaleQuantizer::NumScales>;
+
+    TableSet makeAllTables()
+    {
+        TableSet set {};
+
+        for (int s = 0; s < ScaleQuantizer::NumScales; ++s)
+            for (int root = 0; root < 12; ++root)
+                set[static_cast<size_t> (s)][static_cast<size_t> (root)] = makeNoteTable (kScaleMasks[s], root);
+
+        return set;
+    }
+
+    // Built during static initialisation: as a constant expression the 108
+    // tables take more evaluation steps than compilers allow by default
+    const TableSet kNoteTables = makeAllTables();
+}
 
 ScaleQuantizer::ScaleQuantizer()
 {
@@ -23,106 +103,90 @@ void ScaleQuantizer::setScale (int scaleIndex)
     setScale (static_cast<Scale> (juce::jlimit (0, (int) NumScales - 1, scaleIndex)));
 }
 
-int ScaleQuantizer::quantize (int rawNote) const
+void ScaleQuantizer::setRootAndScale (int root, int scaleIndex)
 {
-    if (rawNote < 0)   rawNote = 0;
-    if (rawNote > 127) rawNote = 127;
-
-    int pc = rawNote % 12;
+    rootNote = juce::jlimit (0, 11, root);
+    currentScale = static_cast<Scale> (juce::jlimit (0, (int) NumScales - 1, scaleIndex));
+    rebuildNoteSet();
+}
 
-    // Already in scale?
-    if (inScale[pc])
-        return rawNote;
+void ScaleQuantizer::setPitchClasses (juce::uint32 pitchClasses, int root)
+{
+    root = juce::jlimit (0, 11, root);
+    pitchClasses &= 0xfffu;
 
-    // Search outward for closest in-scale note
-    for (int offset = 1; offset <= 6; ++offset)
+    if (pitchClasses != 0)
     {
-        int above = (pc + offset) % 12;
-        int below = (pc - offset + 12) % 12;
-
-        if (inScale[below])
-            return rawNote - offset;
-        if (inScale[above])
-            return rawNote + offset;
+        // makeNoteTable takes the intervals above the root, so rotate the
+        // set down to the root (which always belongs to it)
+        pitchClasses |= 1u << root;
+        auto intervals = ((pitchClasses >> root) | (pitchClasses << (12 - root))) & 0xfffu;
+        customTable = makeNoteTable (static_cast<int> (intervals), root);
     }
 
-    return rawNote;   // fallback (shouldn't happen with chromatic)
+    customPitchClasses = pitchClasses;
+    rebuildNoteSet();
 }
 
-int ScaleQuantizer::getScaleDegreeOffset (int fromNote, int degreeOffset) const
+void ScaleQuantizer::setTuning (const Tuning* newTuning)
 {
-    auto notes = getNotesInRange (0, 127);
-    if (notes.empty())
-        return fromNote;
+    tuning = newTuning;
+    rebuildNoteSet();
+}
 
-    // Find the closest index to fromNote
-    int closestIdx = 0;
-    int closestDist = std::abs (notes[0] - fromNote);
+int ScaleQuantizer::quantize (int rawNote) const
+{
+    rawNote = juce::jlimit (0, 127, rawNote);
+    return table->notes[table->nearestDegree[rawNote]];
+}
 
-    for (int i = 1; i < (int) notes.size(); ++i)
-    {
-        int d = std::abs (notes[i] - fromNote);
-        if (d < closestDist)
-        {
-            closestDist = d;
-            closestIdx = i;
-        }
-    }
+int ScaleQuantizer::getScaleDegreeOffset (int fromNote, int degreeOffset) const
+{
+    int degree = table->nearestDegree[juce::jlimit (0, 127, fromNote)];
+    return getNoteAtDegree (degree + degreeOffset);
+}
 
-    int targetIdx = closestIdx + degreeOffset;
-    targetIdx = juce::jlimit (0, (int) notes.size() - 1, targetIdx);
+ScaleQuantizer::DegreeRange ScaleQuantizer::getDegreeRange (int lowNote, int highNote) const
+{
+    lowNote = juce::jlimit (0, 128, lowNote);
+    highNote = juce::jlimit (-1, 127, highNote);
 
-    return notes[targetIdx];
+    DegreeRange range;
+    range.firstDegree = table->countBelow[lowNote];
+    range.numNotes = juce::jmax (0, (int) table->countBelow[highNote + 1] - range.firstDegree);
+    return range;
 }
 
-std::vector<int> ScaleQuantizer::getNotesInRange (int lowNote, int highNote) const
+int ScaleQuantizer::getNoteAtDegree (int degree) const
 {
-    std::vector<int> result;
-    result.reserve (64);
+    return table->notes[juce::jlimit (0, table->numNotes - 1, degree)];
+}
 
-    for (int n = juce::jmax (0, lowNote); n <= juce::jmin (127, highNote); ++n)
-    {
-        if (inScale[n % 12])
-            result.push_back (n);
-    }
+float ScaleQuantizer::getCentsAtDegree (int degree) const
+{
+    if (tuning == nullptr)
+        return 0.0f;
 
-    return result;
+    return tuning->cents[static_cast<size_t> (juce::jlimit (0, table->numNotes - 1, degree))];
 }
 
-void ScaleQuantizer::rebuildNoteSet()
+int ScaleQuantizer::getNearestDegree (int note) const
 {
-    for (int i = 0; i < 12; ++i)
-        inScale[i] = false;
-
-    auto& intervals = getScaleIntervals (currentScale);
-    for (int interval : intervals)
-        inScale[(rootNote + interval) % 12] = true;
+    return table->nearestDegree[juce::jlimit (0, 127, note)];
 }
 
-const std::vector<int>& ScaleQuantizer::getScaleIntervals (Scale scale)
+int ScaleQuantizer::getDegreeClass (int degree) const
 {
-    // Static interval sets (semitones from root)
-    static const std::vector<int> major      = { 0, 2, 4, 5, 7, 9, 11 };
-    static const std::vector<int> minor      = { 0, 2, 3, 5, 7, 8, 10 };
-    static const std::vector<int> dorian     = { 0, 2, 3, 5, 7, 9, 10 };
-    static const std::vector<int> mixolydian = { 0, 2, 4, 5, 7, 9, 10 };
-    static const std::vector<int> pentatonic = { 0, 2, 4, 7, 9 };
-    static const std::vector<int> wholeTone  = { 0, 2, 4, 6, 8, 10 };
-    static const std::vector<int> chromatic  = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
-    static const std::vector<int> inScale    = { 0, 1, 5, 7, 8 };       // In (陰): C Db F G Ab
-    static const std::vector<int> hirajoshi  = { 0, 2, 3, 7, 8 };       // Hirajoshi: C D Eb G Ab
+    int n = table->notesPerOctave;
+    return ((degree - table->rootDegree) % n + n) % n;
+}
 
-    switch (scale)
-    {
-        case Major:       return major;
-        case Minor:       return minor;
-        case Dorian:      return dorian;
-        case Mixolydian:  return mixolydian;
-        case Pentatonic:  return pentatonic;
-        case WholeTone:   return wholeTone;
-        case Chromatic:   return chromatic;
-        case InScale:     return inScale;
-        case Hirajoshi:   return hirajoshi;
-        default:          return major;
-    }
+void ScaleQuantizer::rebuildNoteSet()
+{
+    if (tuning != nullptr)
+        table = &tuning->table;
+    else if (customPitchClasses != 0)
+        table = &customTable;
+    else
+        table = &kNoteTables[static_cast<size_t> (currentScale)][static_cast<size_t> (rootNote)];
 }
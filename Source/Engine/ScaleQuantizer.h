@@ -1,7 +1,22 @@
 #pragma once
 #include <juce_core/juce_core.h>
-#include <vector>
+#include <array>
 
+/**
+ * ScaleQuantizer — Maps notes onto the current root/scale.
+ *
+ * Every root/scale combination has a note table built once at startup:
+ * the in-scale MIDI notes in ascending order ("degrees") and the
+ * note → degree maps. Changing root or scale only repoints the table,
+ * so all queries are O(1) lookups with no allocation.
+ *
+ * A set of pitch classes (e.g. a chord held on the MIDI input) can stand
+ * in for the root/scale; its table is built in place, with no allocation.
+ *
+ * A Tuning (compiled elsewhere, e.g. by ScalaTuning) replaces the root/
+ * scale tables while it is set. Its degrees are the nearest MIDI notes of
+ * the tuned pitches, and getCentsAtDegree() gives what is left over.
+ */
 class ScaleQuantizer
 {
 public:
@@ -19,12 +34,51 @@ public:
         NumScales
     };
 
+    /** Precomputed notes of one root/scale over the MIDI range. */
+    struct NoteTable
+    {
+        juce::uint8 notes[128] = {};          // In-scale notes, ascending (index = degree)
+        juce::uint8 countBelow[129] = {};     // Number of in-scale notes below each MIDI note
+        juce::uint8 nearestDegree[128] = {};  // Closest degree to each MIDI note (ties go down)
+        int numNotes = 0;
+        int notesPerOctave = 0;
+        int rootDegree = 0;                   // Degree of the lowest root note
+    };
+
+    /** A tuning with its own degrees: the note table and each degree's
+        offset from its MIDI note (within ±50 cents). */
+    struct Tuning
+    {
+        NoteTable table;
+        std::array<float, 128> cents {};
+    };
+
+    /** A contiguous run of degrees. */
+    struct DegreeRange
+    {
+        int firstDegree = 0;
+        int numNotes = 0;
+    };
+
     ScaleQuantizer();
 
     void setRootNote (int root);   // 0=C .. 11=B
     void setScale (Scale scale);
     void setScale (int scaleIndex);
 
+    /** Change both with a single table update. */
+    void setRootAndScale (int root, int scaleIndex);
+
+    /** Use any set of pitch classes (bit n = pitch class n, C = 0) with the
+        given root instead of the root/scale; 0 goes back to them. */
+    void setPitchClasses (juce::uint32 pitchClasses, int root);
+    juce::uint32 getPitchClasses() const { return customPitchClasses; }
+
+    /** Use a tuning instead of the root/scale (nullptr: back to them). The
+        tuning must outlive its use here. */
+    void setTuning (const Tuning* newTuning);
+    const Tuning* getTuning() const { return tuning; }
+
     /** Quantize a raw MIDI note to the nearest note in the current scale. */
     int quantize (int rawNote) const;
 
@@ -32,8 +86,23 @@ public:
         Returns the MIDI note number. */
     int getScaleDegreeOffset (int fromNote, int degreeOffset) const;
 
-    /** Get all scale notes within a MIDI note range. */
-    std::vector<int> getNotesInRange (int lowNote, int highNote) const;
+    /** The degrees whose notes lie within [lowNote, highNote]. */
+    DegreeRange getDegreeRange (int lowNote, int highNote) const;
+
+    /** MIDI note of a degree (clamped to the table). */
+    int getNoteAtDegree (int degree) const;
+
+    /** Degree closest to a MIDI note. */
+    int getNearestDegree (int note) const;
+
+    /** Position of a degree within its octave: 0 for the root, up to
+        getNotesPerOctave() - 1. */
+    int getDegreeClass (int degree) const;
+
+    int getNotesPerOctave() const { return table->notesPerOctave; }
+
+    /** Offset of a degree from its MIDI note, in cents (0 without a tuning). */
+    float getCentsAtDegree (int degree) const;
 
     int getRootNote() const { return rootNote; }
     Scale getScale() const { return currentScale; }
@@ -44,9 +113,13 @@ private:
     int rootNote = 0;
     Scale currentScale = Major;
 
-    // 12-element boolean array: which pitch classes are in-scale
-    bool inScale[12] = {};
+    juce::uint32 customPitchClasses = 0;
+    NoteTable customTable;
+    const Tuning* tuning = nullptr;
+
+    // Points into the static table set for the current root/scale, the
+    // custom table or the tuning
+    const NoteTable* table = nullptr;
 
-    // Scale interval definitions (semitones from root)
-    static const std::vector<int>& getScaleIntervals (Scale scale);
+    JUCE_DECLARE_NON_COPYABLE (ScaleQuantizer)
 };
@@ -17,6 +17,11 @@ CaptainDriftEditor::CaptainDriftEditor (CaptainDriftProcessor& p)
     droneToggle.setButtonText ("DRONE");
     addAndMakeVisible (droneToggle);
 
+    // --- Sample instrument loader ---
+    cargoButton.setButtonText ("CARGO");
+    cargoButton.onClick = [this] { chooseSampleFolder(); };
+    addAndMakeVisible (cargoButton);
+
     // --- MIDI Visualizer ---
     midiVisualizer.setVoiceNoteSource (processor.voiceNotes);
     addAndMakeVisible (midiVisualizer);
@@ -95,6 +100,7 @@ void CaptainDriftEditor::resized()
     // --- On/Off toggle (top-right, in title bar area) ---
     genToggle.setBounds (bounds.getWidth() - 90, 10, 75, 24);
     droneToggle.setBounds (bounds.getWidth() - 180, 10, 85, 24);
+    cargoButton.setBounds (bounds.getWidth() - 265, 10, 75, 24);
 
     // --- Top row: Navigation | Rhythm | Dynamics ---
     int topY = padY + 35;  // Space for plugin title area
@@ -192,3 +198,18 @@ void CaptainDriftEditor::setupSectionLabel (juce::Label& label, const juce::Stri
     label.setColour (juce::Label::textColourId, DriftLookAndFeel::accent);
     addAndMakeVisible (label);
 }
+
+void CaptainDriftEditor::chooseSampleFolder()
+{
+    cargoChooser = std::make_unique<juce::FileChooser> ("Load sample instrument",
+                                                        processor.getSampleInstrumentFolder());
+
+    cargoChooser->launchAsync (juce::FileBrowserComponent::openMode
+                                 | juce::FileBrowserComponent::canSelectDirectories,
+                               [this] (const juce::FileChooser& chooser)
+                               {
+                                   auto folder = chooser.getResult();
+                                   if (folder.isDirectory())
+                                       processor.loadSampleInstrument (folder);
+                               });
+}
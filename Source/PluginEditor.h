@@ -28,6 +28,10 @@ private:
     juce::ToggleButton droneToggle;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> droneToggleAtt;
 
+    // --- Sample instrument loader ---
+    juce::TextButton cargoButton;
+    std::unique_ptr<juce::FileChooser> cargoChooser;
+
     // --- MIDI Visualizer ---
     MidiVisualizer midiVisualizer;
 
@@ -63,6 +67,7 @@ private:
     // Helpers
     void setupKnob (juce::Slider& knob, juce::Label& label, const juce::String& text);
     void setupSectionLabel (juce::Label& label, const juce::String& text);
+    void chooseSampleFolder();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CaptainDriftEditor)
 };
@@ -1,12 +1,79 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 #include "Engine/ParameterLayout.h"
+#include "Engine/ScalaTuning.h"
+
+namespace
+{
+    // Merge two time-ordered buffers into a third; at equal times the input goes first
+    void mergeMidi (const juce::MidiBuffer& input, const juce::MidiBuffer& generated, juce::MidiBuffer& merged)
+    {
+        merged.clear();
+
+        auto in = input.cbegin(), inEnd = input.cend();
+        auto gen = generated.cbegin(), genEnd = generated.cend();
+
+        while (in != inEnd || gen != genEnd)
+        {
+            bool takeInput = gen == genEnd || (in != inEnd && (*in).samplePosition <= (*gen).samplePosition);
+            const auto m = takeInput ? *in : *gen;
+
+            MidiEventWriter::append (merged, m.data, m.numBytes, m.samplePosition);
+
+            if (takeInput)
+                ++in;
+            else
+                ++gen;
+        }
+    }
+
+    // Host timeline position in seconds, from its time or its beat position
+    juce::Optional<double> getTimelineSeconds (juce::AudioPlayHead* playHead)
+    {
+        if (playHead == nullptr)
+            return {};
+
+        auto position = playHead->getPosition();
+        if (! position.hasValue())
+            return {};
+
+        if (auto seconds = position->getTimeInSeconds())
+            return *seconds;
+
+        auto ppq = position->getPpqPosition();
+        auto bpm = position->getBpm();
+        if (ppq.hasValue() && bpm.hasValue() && *bpm > 0.0)
+            return *ppq * 60.0 / *bpm;
+
+        return {};
+    }
+
+    // The transitions of the melody in a MIDI file, or null if it has none
+    std::unique_ptr<MarkovMelody::LearnedTables> learnMelody (const juce::File& file)
+    {
+        juce::FileInputStream stream (file);
+        juce::MidiFile midiFile;
+
+        if (! stream.openedOk() || ! midiFile.readFrom (stream))
+            return {};
+
+        return MarkovMelody::learn (midiFile);
+    }
+}
 
 CaptainDriftProcessor::CaptainDriftProcessor()
     : AudioProcessor (BusesProperties()
+                       .withInput ("Input", juce::AudioChannelSet::stereo(), false)
+                       .withInput ("Sidechain", juce::AudioChannelSet::stereo(), false)
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)),
       apvts (*this, nullptr, "PARAMETERS", createParameterLayout())
 {
+    // One reader slot of the data series each
+    modMatrix.setDataSeries (&dataSeries, 0);
+    lookahead.setDataSeries (&dataSeries, 1);
+    lookahead.setPresetMorph (&presetMorph, 1);
+
+    factoryPresets = presetMorph.createFactoryPresets();
 }
 
 CaptainDriftProcessor::~CaptainDriftProcessor() {}
@@ -18,10 +85,25 @@ bool CaptainDriftProcessor::producesMidi() const { return true; }
 bool CaptainDriftProcessor::isMidiEffect() const { return false; }
 double CaptainDriftProcessor::getTailLengthSeconds() const { return 5.0; }
 
-int CaptainDriftProcessor::getNumPrograms()    { return 1; }
-int CaptainDriftProcessor::getCurrentProgram() { return 0; }
-void CaptainDriftProcessor::setCurrentProgram (int) {}
-const juce::String CaptainDriftProcessor::getProgramName (int) { return {}; }
+int CaptainDriftProcessor::getNumPrograms()    { return static_cast<int> (factoryPresets.size()); }
+int CaptainDriftProcessor::getCurrentProgram() { return currentProgram; }
+
+void CaptainDriftProcessor::setCurrentProgram (int index)
+{
+    // Hosts re-select the current program on load; that must not restart anything
+    if (index == currentProgram || ! juce::isPositiveAndBelow (index, getNumPrograms()))
+        return;
+
+    currentProgram = index;
+    presetMorph.morphTo (factoryPresets[static_cast<size_t> (index)],
+                         apvts.getRawParameterValue (ID::passage)->load());
+}
+
+const juce::String CaptainDriftProcessor::getProgramName (int index)
+{
+    return juce::isPositiveAndBelow (index, getNumPrograms()) ? factoryPresets[static_cast<size_t> (index)].name : juce::String();
+}
+
 void CaptainDriftProcessor::changeProgramName (int, const juce::String&) {}
 
 bool CaptainDriftProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -29,46 +111,240 @@ bool CaptainDriftProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
 
-    return true;
+    // Hosts route a sidechain to the second input bus; the main input is
+    // there for them to find it and is not used. Both are optional.
+    auto isOptionalInput = [] (const juce::AudioChannelSet& set)
+    {
+        return set.isDisabled()
+            || set == juce::AudioChannelSet::mono()
+            || set == juce::AudioChannelSet::stereo();
+    };
+
+    return isOptionalInput (layouts.getMainInputChannelSet())
+        && isOptionalInput (layouts.getChannelSet (true, 1));
 }
 
 void CaptainDriftProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     engine.prepare (sampleRate, samplesPerBlock);
+    driftEvents.prepare (engine.getEventCapacity());
+    modMatrix.prepare (sampleRate);
+    presetMorph.prepare (sampleRate);
     padSynth.prepare (sampleRate, samplesPerBlock);
+    ensemble.prepare (sampleRate, samplesPerBlock);
+    sampleLayer.prepare (sampleRate, samplesPerBlock);
+    midiWriter.prepare (sampleRate);
+    keyFollower.reset();
+    pitchTracker.prepare (sampleRate);
+
+    // Room to keep, write and merge a block's MIDI (see processBlock)
+    inputMidi.ensureSize (MidiEventWriter::kReserveBytes);
+    mergedMidi.ensureSize (MidiEventWriter::kReserveBytes);
+    generatedMidi.ensureSize (MidiEventWriter::kReserveBytes);
+    lookahead.prepare (sampleRate, samplesPerBlock);
+
+    // Push every parameter into the freshly prepared modules on the next block
+    parameters.invalidate();
+
+    // The journal starts a new segment from this state
+    journal.endSegment();
 }
 
 void CaptainDriftProcessor::releaseResources()
 {
     engine.reset();
     padSynth.reset();
+    ensemble.reset();
+    sampleLayer.reset();
+    midiWriter.reset();
 }
 
 void CaptainDriftProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                            juce::MidiBuffer& midiMessages)
 {
+    // Snapshot the parameters and apply the modulation routes; only the
+    // fields that moved are passed on
+    using P = ParameterSnapshot;
+
+    // Offline renders run from the host timeline alone, so every bounce of a
+    // passage comes out the same
+    if (isNonRealtime() != renderingOffline)
+        setRenderingOffline (isNonRealtime());
+
+    if (renderingOffline)
+        if (auto seconds = getTimelineSeconds (getPlayHead()))
+            modMatrix.setTimelinePosition (*seconds);
+
+    // A journal segment starts the generation over, between morphs, so a
+    // replay can start from the same place
+    bool segmentStarted = false;
+
+    if (! renderingOffline && journal.wantsSegment() && presetMorph.isIdle (0))
+    {
+        restartGeneration();
+        journal.startSegment (getSampleRate(), getBlockSize(), engine.getSeed(), modMatrix.getClock());
+        segmentStarted = true;
+    }
+
+    auto hostChanged = parameters.update();
+
+    if (segmentStarted)
+        journal.writeHeld (parameters);
+
+    auto changed = hostChanged | presetMorph.process (parameters, buffer.getNumSamples(), 0);
+    changed |= oscControl.process (parameters);
+    changed |= modMatrix.process (parameters, changed, buffer.getNumSamples());
+
+    // Helm can follow the key heard on the sidechain; listen before the
+    // buffer is cleared for output
+    if (parameters.getInt (P::Helm) == 2 && getChannelCountOfBus (true, 1) > 0)
+    {
+        pitchTracker.process (getBusBuffer (buffer, true, 1));
+        engine.setDetectedKey (pitchTracker.getKey());
+        lookahead.setDetectedKey (pitchTracker.getKey());
+    }
+
     // Clear audio output
     buffer.clear();
 
-    // Clear incoming MIDI (we generate our own)
+    // Incoming MIDI can steer the key (Helm) and be passed through (Convoy);
+    // either way the output starts out empty
+    if (parameters.getInt (P::Helm) == 1)
+    {
+        keyFollower.process (midiMessages);
+        engine.setFollowedKey (keyFollower.getKey());
+        lookahead.setFollowedKey (keyFollower.getKey());
+    }
+
+    inputMidi.clear();
+    if (parameters.getBool (P::Convoy))
+        for (const auto m : midiMessages)
+            MidiEventWriter::append (inputMidi, m.data, m.numBytes, m.samplePosition);
+
     midiMessages.clear();
+    generatedMidi.clear();
+
+    engine.updateParameters (parameters, changed, modMatrix);
+
+    // Lookout > 0 hands generation to the worker thread, that many blocks
+    // ahead. Offline renders generate here: the worker's pacing would show.
+    int lookoutBlocks = renderingOffline ? 0 : parameters.getInt (P::Lookout);
+    driftEvents.clear();
+
+    if (lookoutBlocks > 0 && ! lookahead.isRunning())
+    {
+        lookahead.start (engine);
+    }
+    else if (lookoutBlocks == 0 && lookahead.isRunning())
+    {
+        lookahead.stop (driftEvents);
+        engine.reset();
+    }
+
+    if (changed != 0)
+    {
+        padSynth.setDroneMode (parameters.getBool (P::DroneMode));
+        ensemble.setMix (parameters.get (P::Wake));
+        sampleLayer.setLevel (parameters.get (P::Cargo));
+        midiWriter.setMaxBendRate (parameters.get (P::Bunting));
+    }
+
+    // The restarted generation owns no channels; end what was sounding
+    if (segmentStarted)
+    {
+        midiWriter.reset();
+
+        if (parameters.getBool (P::Semaphore))
+            for (int channel = 1; channel <= 16; ++channel)
+                MidiEventWriter::append (generatedMidi, juce::MidiMessage::allNotesOff (channel), 0);
+    }
+
+    // Generate note events (after the lookahead's note-offs, if it just stopped)
+    if (lookahead.isRunning())
+    {
+        lookahead.setLookaheadBlocks (lookoutBlocks);
+        lookahead.processBlock (driftEvents, buffer.getNumSamples(), getPlayHead(), hostChanged);
+    }
+    else
+    {
+        engine.processBlock (driftEvents, buffer.getNumSamples(), getPlayHead());
+    }
+
+    // Update voice activity for visualizer (nobody is watching a bounce)
+    for (int i = 0; i < kNumDisplayedVoices && ! renderingOffline; ++i)
+        voiceNotes[i].store (lookahead.isRunning() ? lookahead.getVoiceNote (i) : engine.getVoiceNote (i),
+                             std::memory_order_relaxed);
+
+    // Render the generated notes through the built-in pad synth
+    padSynth.setModulation (modMatrix.getSynthTarget (ModMatrix::PadCutoff),
+                            modMatrix.getSynthTarget (ModMatrix::PadDetune));
+    padSynth.processBlock (buffer, driftEvents);
+
+    // String-machine ensemble on the pad voice sum
+    ensemble.process (buffer);
+
+    // Render through the streamed sample instrument, if one is loaded
+    sampleLayer.processBlock (buffer, driftEvents);
+
+    // Only encode MIDI bytes when the output is in use. Events arrive in
+    // time order, so each one is appended into the reserve.
+    if (parameters.getBool (P::Semaphore))
+        midiWriter.write (driftEvents, generatedMidi, buffer.getNumSamples());
+
+    // Merge the passed-through input in time order
+    auto* output = &generatedMidi;
+
+    if (! inputMidi.isEmpty())
+    {
+        mergeMidi (inputMidi, generatedMidi, mergedMidi);
+        output = &mergedMidi;
+    }
+
+    // Swapped rather than copied: copying would grow the host's buffer to
+    // fit. The host's buffer takes the reserved storage and its own comes
+    // back to be written next. Hosts keep their buffer across blocks, so
+    // once each storage has grown to a block's MIDI, nothing grows again.
+    midiMessages.swapWith (*output);
+
+    // Journal what this block was given (a no-op unless recording)
+    journal.writeBlock (buffer.getNumSamples(), parameters, presetMorph.getStarted (0), oscControl, modMatrix,
+                        engine.getFollowedKey(), engine.getDetectedKey(), getPlayHead());
 
-    // Update engine parameters from APVTS
-    engine.updateParameters (apvts);
+    // The follower tracks the output for the next block
+    auto level = buffer.getMagnitude (0, buffer.getNumSamples());
+    modMatrix.setFollowerInput (level);
+    lookahead.setFollowerInput (level);
+}
+
+void CaptainDriftProcessor::setRenderingOffline (bool offline)
+{
+    renderingOffline = offline;
+
+    engine.setNonRealtime (offline);
+    modMatrix.setNonRealtime (offline);
+    padSynth.setNonRealtime (offline);
 
-    // Pass drone mode to the synth
-    bool drone = apvts.getRawParameterValue (ID::droneMode)->load() >= 0.5f;
-    padSynth.setDroneMode (drone);
+    // Bounces are not journaled
+    if (offline)
+        journal.endSegment();
 
-    // Generate MIDI events
-    engine.processBlock (midiMessages, buffer.getNumSamples(), getPlayHead());
+    // Start from silence, with the voices rebuilt at the host position
+    restartGeneration();
+}
+
+void CaptainDriftProcessor::restartGeneration()
+{
+    // Every module as prepareToPlay leaves it. A running lookahead is
+    // stopped, and the engine reset, by the next block.
+    parameters.invalidate();
+    modMatrix.reset();
 
-    // Update voice activity for visualizer
-    for (int i = 0; i < GenerativeEngine::kMaxVoices; ++i)
-        voiceNotes[i].store (engine.getVoiceNote (i), std::memory_order_relaxed);
+    if (! lookahead.isRunning())
+        engine.reset();
 
-    // Render the generated MIDI through the built-in pad synth
-    padSynth.processBlock (buffer, midiMessages);
+    padSynth.reset();
+    ensemble.reset();
+    sampleLayer.reset();
 }
 
 bool CaptainDriftProcessor::hasEditor() const { return true; }
@@ -81,6 +357,15 @@ juce::AudioProcessorEditor* CaptainDriftProcessor::createEditor()
 void CaptainDriftProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     auto state = apvts.copyState();
+    state.setProperty ("sampleFolder", sampleLayer.getInstrumentFolder().getFullPathName(), nullptr);
+    state.setProperty ("melodyFile", melodyFile.getFullPathName(), nullptr);
+    state.setProperty ("tuningScale", tuningScaleFile.getFullPathName(), nullptr);
+    state.setProperty ("tuningMapping", tuningMappingFile.getFullPathName(), nullptr);
+    state.setProperty ("program", currentProgram, nullptr);
+    state.setProperty ("dataSeries", dataSeries.getFile().getFullPathName(), nullptr);
+    state.setProperty ("dataReplay", dataSeries.getTimeline() == DataSeries::Timeline::Replay, nullptr);
+    state.setProperty ("journalFile", journal.getFile().getFullPathName(), nullptr);
+    state.setProperty ("oscPort", oscControl.getPort(), nullptr);
     std::unique_ptr<juce::XmlElement> xml (state.createXml());
     copyXmlToBinary (*xml, destData);
 }
@@ -90,7 +375,123 @@ void CaptainDriftProcessor::setStateInformation (const void* data, int sizeInByt
     std::unique_ptr<juce::XmlElement> xml (getXmlFromBinary (data, sizeInBytes));
 
     if (xml != nullptr && xml->hasTagName (apvts.state.getType()))
+    {
         apvts.replaceState (juce::ValueTree::fromXml (*xml));
+        currentProgram = juce::jlimit (0, getNumPrograms() - 1, static_cast<int> (apvts.state.getProperty ("program", 0)));
+
+        auto routes = ModMatrix::readRoutes (apvts.state);
+        modMatrix.setRoutes (routes);
+        lookahead.setRoutes (routes);
+
+        juce::String folder = apvts.state.getProperty ("sampleFolder").toString();
+        if (folder.isNotEmpty())
+            loadSampleInstrument (juce::File (folder));
+
+        juce::String melody = apvts.state.getProperty ("melodyFile").toString();
+        if (melody.isNotEmpty())
+            loadMelodyFile (juce::File (melody));
+
+        juce::String scale = apvts.state.getProperty ("tuningScale").toString();
+        if (scale.isNotEmpty())
+        {
+            juce::String mapping = apvts.state.getProperty ("tuningMapping").toString();
+            loadTuning (juce::File (scale), mapping.isNotEmpty() ? juce::File (mapping) : juce::File());
+        }
+
+        juce::String series = apvts.state.getProperty ("dataSeries").toString();
+        if (series.isNotEmpty())
+            loadDataSeries (juce::File (series), static_cast<bool> (apvts.state.getProperty ("dataReplay"))
+                                                     ? DataSeries::Timeline::Replay : DataSeries::Timeline::Live);
+
+        juce::String journalPath = apvts.state.getProperty ("journalFile").toString();
+        if (journalPath.isNotEmpty())
+            setJournalFile (juce::File (journalPath));
+
+        if (apvts.state.hasProperty ("oscPort"))
+            setOscPort (apvts.state.getProperty ("oscPort"));
+    }
+}
+
+void CaptainDriftProcessor::setModulationRoutes (const juce::Array<ModMatrix::Route>& routes)
+{
+    ModMatrix::writeRoutes (apvts.state, routes);
+    modMatrix.setRoutes (routes);
+    lookahead.setRoutes (routes);
+}
+
+void CaptainDriftProcessor::loadSampleInstrument (const juce::File& folder)
+{
+    sampleLayer.loadInstrumentAsync (folder);
+}
+
+bool CaptainDriftProcessor::loadMelodyFile (const juce::File& file)
+{
+    auto tables = learnMelody (file);
+    if (tables == nullptr)
+        return false;
+
+    // The lookahead's engine gets its own copy
+    engine.setLearnedMelody (std::make_unique<MarkovMelody::LearnedTables> (*tables));
+    lookahead.setLearnedMelody (std::move (tables));
+    melodyFile = file;
+    return true;
+}
+
+bool CaptainDriftProcessor::loadTuning (const juce::File& scaleFile, const juce::File& mappingFile)
+{
+    auto tuning = ScalaTuning::load (scaleFile, mappingFile);
+    if (tuning == nullptr)
+        return false;
+
+    engine.setTuning (std::make_unique<ScaleQuantizer::Tuning> (*tuning));
+    lookahead.setTuning (std::move (tuning));
+    tuningScaleFile = scaleFile;
+    tuningMappingFile = mappingFile;
+    return true;
+}
+
+bool CaptainDriftProcessor::loadPreset (const juce::File& file)
+{
+    auto xml = juce::XmlDocument::parse (file);
+    if (xml == nullptr)
+        return false;
+
+    auto preset = presetMorph.compile (juce::ValueTree::fromXml (*xml), file.getFileNameWithoutExtension());
+    if (preset.fields == 0)
+        return false;
+
+    presetMorph.morphTo (preset, apvts.getRawParameterValue (ID::passage)->load());
+    return true;
+}
+
+void CaptainDriftProcessor::loadDataSeries (const juce::File& file, DataSeries::Timeline timeline)
+{
+    dataSeries.setTimeline (timeline);
+    dataSeries.loadAsync (file);
+}
+
+void CaptainDriftProcessor::setJournalFile (const juce::File& file)
+{
+    journal.setFile (file);
+}
+
+bool CaptainDriftProcessor::setOscPort (int port)
+{
+    return oscControl.setPort (port);
+}
+
+std::unique_ptr<JournalReplay> CaptainDriftProcessor::createJournalReplay()
+{
+    auto replay = std::make_unique<JournalReplay> (apvts);
+
+    // Loaded afresh: the engines' copies belong to the audio side
+    if (melodyFile != juce::File())
+        replay->setLearnedMelody (learnMelody (melodyFile));
+
+    if (tuningScaleFile != juce::File())
+        replay->setTuning (ScalaTuning::load (tuningScaleFile, tuningMappingFile));
+
+    return replay;
 }
 
 // This creates new instances of the plugin
@@ -2,6 +2,15 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include "Engine/GenerativeEngine.h"
 #include "Engine/PadSynth.h"
+#include "Engine/SampleLayer.h"
+#include "Engine/EnsembleChorus.h"
+#include "Engine/MidiEventWriter.h"
+#include "Engine/ModMatrix.h"
+#include "Engine/PresetMorph.h"
+#include "Engine/LookaheadGenerator.h"
+#include "Engine/DecisionJournal.h"
+#include "Engine/JournalReplay.h"
+#include "Engine/OscControl.h"
 
 class CaptainDriftProcessor : public juce::AudioProcessor
 {
@@ -35,14 +44,87 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    /** Load a multisample folder into the sample layer (message thread). */
+    void loadSampleInstrument (const juce::File& folder);
+    juce::File getSampleInstrumentFolder() const { return sampleLayer.getInstrumentFolder(); }
+
+    /** Learn the transitions of the Learned melody style from a MIDI file
+        (message thread). Returns false if the file has no usable melody. */
+    bool loadMelodyFile (const juce::File& file);
+    juce::File getMelodyFile() const { return melodyFile; }
+
+    /** Load a Scala scale, with an optional keyboard mapping, for the Compass
+        parameter to play (message thread). Returns false if either file is
+        unusable; the previous tuning then stays. */
+    bool loadTuning (const juce::File& scaleFile, const juce::File& mappingFile = {});
+    juce::File getTuningScaleFile() const { return tuningScaleFile; }
+    juce::File getTuningMappingFile() const { return tuningMappingFile; }
+
+    /** Morph to a preset saved as a plugin state, over the Passage time
+        (message thread). Returns false if the file holds no preset fields. */
+    bool loadPreset (const juce::File& file);
+
+    /** Follow a recorded time series as the Data modulation source (message
+        thread). It is mapped and indexed in the background; an empty File
+        closes it. Live reads it at the clock's date and time, Replay from its
+        first row. */
+    void loadDataSeries (const juce::File& file, DataSeries::Timeline timeline = DataSeries::Timeline::Live);
+    juce::File getDataSeriesFile() const { return dataSeries.getFile(); }
+    DataSeries::Timeline getDataSeriesTimeline() const { return dataSeries.getTimeline(); }
+
+    /** Replace the modulation routes (message thread). They are saved with the state. */
+    void setModulationRoutes (const juce::Array<ModMatrix::Route>& routes);
+    juce::Array<ModMatrix::Route> getModulationRoutes() const { return ModMatrix::readRoutes (apvts.state); }
+
+    /** Journal what the generator is given to a file, appending (message
+        thread), so any moment of it can be regenerated. Recording restarts
+        the generation; an empty File stops. Saved with the state. */
+    void setJournalFile (const juce::File& file);
+    juce::File getJournalFile() const { return journal.getFile(); }
+
+    /** A replay for journals, generating with the melody and tuning files
+        loaded now (message thread). Load a journal into it and render. */
+    std::unique_ptr<JournalReplay> createJournalReplay();
+
+    /** Listen for OSC control (/captaindrift/<parameter ID> <value>) on a
+        UDP port, or stop with 0 (message thread). Returns false if the port
+        cannot be opened. Saved with the state. */
+    bool setOscPort (int port);
+    int getOscPort() const { return oscControl.getPort(); }
+
     juce::AudioProcessorValueTreeState apvts;
 
-    // Voice activity data for GUI visualizer (written on audio thread, read on GUI thread)
-    std::atomic<int> voiceNotes[GenerativeEngine::kMaxVoices] = {};
+    // Voice activity data for GUI visualizer (written on audio thread, read on GUI thread).
+    // Only the first voices of the swarm are shown.
+    static constexpr int kNumDisplayedVoices = 8;
+    std::atomic<int> voiceNotes[kNumDisplayedVoices] = {};
 
 private:
+    ParameterSnapshot parameters { apvts };
+    DataSeries dataSeries;          // Outlives both matrices reading it
+    PresetMorph presetMorph { apvts };
+    OscControl oscControl { apvts };
+    std::vector<PresetMorph::Preset> factoryPresets;
+    int currentProgram = 0;
+    ModMatrix modMatrix;
     GenerativeEngine engine;
+    LookaheadGenerator lookahead { apvts };
+    DriftEventQueue driftEvents;
+    MidiEventWriter midiWriter;
+    KeyFollower keyFollower;
+    PitchTracker pitchTracker;
+    juce::MidiBuffer inputMidi, mergedMidi;   // Passed-through input, and the merge target
+    juce::MidiBuffer generatedMidi;           // The generated notes, swapped into the host's buffer
     PadSynth padSynth;
+    EnsembleChorus ensemble;
+    SampleLayer sampleLayer;
+    DecisionJournal journal;
+    juce::File melodyFile;
+    juce::File tuningScaleFile, tuningMappingFile;
+    bool renderingOffline = false;
+
+    void setRenderingOffline (bool offline);
+    void restartGeneration();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CaptainDriftProcessor)
 };